@@ -0,0 +1,296 @@
+#!/usr/bin/env python3
+import sys
+import os
+import re
+import json
+import time
+import argparse
+import tempfile
+import statistics
+import subprocess
+
+# Matches stage2's trace.h, QEMU exits with (value << 1) | 1.
+EXIT_PORT = 0xF4
+EXIT_CODE = (0x10 << 1) | 1
+
+# QEMU drive options for each disk controller. Stage2 only has a legacy ATA
+# driver, the others boot through the BIOS and show where stage2 gives up.
+CONTROLLERS = {
+    'ide': ['-machine', 'pc', '-drive', 'file={image},format=raw,if=ide'],
+    'ahci': ['-machine', 'q35', '-drive', 'file={image},format=raw,if=none,id=boot',
+             '-device', 'ide-hd,drive=boot,bus=ide.0'],
+    'virtio': ['-machine', 'pc', '-drive', 'file={image},format=raw,if=virtio'],
+}
+
+PERCENTILES = [5, 50, 90, 95, 99]
+
+# "  name                     us      KB/s" lines of trace_dump().
+TRACE_HEADER = 'TRACE: phase'
+TRACE_LINE = re.compile(r'^  (\S.*?)\s+(\d+)(?:\s+(\d+))?\s*$')
+
+
+def qemu_command(qemu, image, controller, debugcon, memory):
+    """Builds a headless QEMU command line that logs the debug console to a file."""
+    command = [qemu, '-display', 'none', '-no-reboot', '-monitor', 'none', '-serial', 'none',
+               '-m', str(memory), '-debugcon', f'file:{debugcon}',
+               '-device', f'isa-debug-exit,iobase={EXIT_PORT:#x},iosize=0x04']
+    command += [arg.format(image=image) for arg in CONTROLLERS[controller]]
+    return command
+
+
+def parse_trace(text):
+    """
+    Pulls the phase table out of the debug console output.
+    Returns {phase: {"us": int, "kbs": int or None}}, empty when stage2 never got to trace_dump().
+    """
+    phases = {}
+    in_table = False
+    for line in text.splitlines():
+        if line.startswith(TRACE_HEADER):
+            in_table = True
+            phases = {}
+            continue
+        if not in_table:
+            continue
+        match = TRACE_LINE.match(line)
+        if not match:
+            in_table = False
+            continue
+        name = match.group(1)
+        # a phase that runs more than once (e.g. per module) keeps its sum
+        entry = phases.setdefault(name, {'us': 0, 'kbs': None})
+        entry['us'] += int(match.group(2))
+        if match.group(3) is not None:
+            entry['kbs'] = int(match.group(3))
+    return phases
+
+
+def boot_once(qemu, image, controller, timeout, memory):
+    """
+    Boots the image once. Returns (phases, wall seconds, status), status is
+    "ok", "timeout" or "exit N". Images built without BENCH_EXIT are stopped
+    shortly after the trace table has been printed.
+    """
+    with tempfile.TemporaryDirectory() as tmp:
+        debugcon = os.path.join(tmp, 'debugcon.log')
+        open(debugcon, 'w').close()
+
+        start = time.monotonic()
+        process = subprocess.Popen(qemu_command(qemu, image, controller, debugcon, memory),
+                                   stdin=subprocess.DEVNULL, stdout=subprocess.DEVNULL,
+                                   stderr=subprocess.PIPE)
+        status = None
+        table_seen = None
+        while status is None:
+            code = process.poll()
+            now = time.monotonic()
+            if code is not None:
+                status = 'ok' if code == EXIT_CODE else f'exit {code}'
+                break
+            if now - start > timeout:
+                status = 'timeout'
+                break
+
+            with open(debugcon, errors='replace') as f:
+                text = f.read()
+            if table_seen is None and '\n  total' in text:
+                table_seen = now
+            if table_seen is not None and now - table_seen > 0.5:
+                status = 'ok'
+                break
+            time.sleep(0.02)
+
+        wall = time.monotonic() - start
+        if process.poll() is None:
+            process.kill()
+        _, stderr = process.communicate()
+
+        with open(debugcon, errors='replace') as f:
+            phases = parse_trace(f.read())
+
+    if status.startswith('exit') and stderr:
+        print(stderr.decode(errors='replace').strip(), file=sys.stderr)
+    if not phases and status == 'ok':
+        status = 'no trace'
+    return phases, wall, status
+
+
+def percentile(samples, p):
+    """Nearest-rank percentile of a sorted list."""
+    rank = max(1, -(-p * len(samples) // 100))
+    return samples[rank - 1]
+
+
+def summarize(samples):
+    """Median, spread and percentiles of one metric."""
+    ordered = sorted(samples)
+    summary = {
+        'median': statistics.median(ordered),
+        'mean': statistics.fmean(ordered),
+        'min': ordered[0],
+        'max': ordered[-1],
+        'stdev': statistics.stdev(ordered) if len(ordered) > 1 else 0.0,
+    }
+    for p in PERCENTILES:
+        summary[f'p{p}'] = percentile(ordered, p)
+    summary['samples'] = samples
+    return summary
+
+
+def bench_config(args, image, controller):
+    """Boots one image on one controller args.runs times and summarizes the phases."""
+    size = os.stat(image).st_size
+    print(f'> {os.path.basename(image)} ({size // (1000 * 1000)} MB) on {controller}, {args.runs} runs')
+
+    durations = {}
+    throughput = {}
+    order = []
+    walls = []
+    failures = {}
+
+    for run in range(args.runs + args.warmup):
+        phases, wall, status = boot_once(args.qemu, image, controller, args.timeout, args.memory)
+        if run < args.warmup:
+            continue
+        if status != 'ok':
+            failures[status] = failures.get(status, 0) + 1
+            continue
+
+        walls.append(wall * 1000000)
+        for name, entry in phases.items():
+            if name not in durations:
+                order.append(name)
+                durations[name] = []
+            durations[name].append(entry['us'])
+            if entry['kbs'] is not None:
+                throughput.setdefault(name, []).append(entry['kbs'])
+
+    result = {
+        'image': os.path.abspath(image),
+        'size': size,
+        'controller': controller,
+        'runs': args.runs,
+        'ok': len(walls),
+        'failures': failures,
+        'phases_us': {name: summarize(durations[name]) for name in order},
+        'throughput_kbs': {name: summarize(throughput[name]) for name in order if name in throughput},
+    }
+    if walls:
+        result['qemu_wall_us'] = summarize(walls)
+
+    print_config(result)
+    return result
+
+
+def print_config(result):
+    """Prints the medians and tail of one configuration."""
+    if result['failures']:
+        failed = ', '.join(f'{count}x {status}' for status, count in result['failures'].items())
+        print(f'  {result["ok"]}/{result["runs"]} runs finished ({failed})')
+    if not result['ok']:
+        return
+
+    print(f'  {"phase":<24}{"median us":>12}{"p90 us":>12}{"p99 us":>12}{"KB/s":>10}')
+    rows = list(result['phases_us'].items())
+    if 'qemu_wall_us' in result:
+        rows.append(('qemu wall time', result['qemu_wall_us']))
+    for name, summary in rows:
+        kbs = result['throughput_kbs'].get(name)
+        kbs = f'{kbs["median"]:>10.0f}' if kbs else ''
+        print(f'  {name:<24}{summary["median"]:>12.0f}{summary["p90"]:>12.0f}{summary["p99"]:>12.0f}{kbs}')
+
+
+def compare(results, baseline_path, threshold):
+    """
+    Compares phase medians against an earlier report. Only phases longer
+    than a millisecond are judged, shorter ones are mostly noise.
+    Returns the regressions found.
+    """
+    with open(baseline_path) as f:
+        baseline = json.load(f)
+    previous = {(c['image'], c['controller']): c for c in baseline['configs']}
+
+    regressions = []
+    print(f'> Comparing against {baseline_path} (threshold {threshold}%)')
+    for config in results:
+        old = previous.get((config['image'], config['controller']))
+        if old is None:
+            continue
+        for name, summary in config['phases_us'].items():
+            before = old['phases_us'].get(name)
+            if before is None or before['median'] < 1000:
+                continue
+            change = (summary['median'] - before['median']) * 100.0 / before['median']
+            marker = ''
+            if change > threshold:
+                marker = '  REGRESSION'
+                regressions.append({'image': config['image'], 'controller': config['controller'],
+                                    'phase': name, 'before_us': before['median'],
+                                    'after_us': summary['median'], 'change_percent': change})
+            print(f'  {config["controller"]:<8}{name:<24}{before["median"]:>12.0f}'
+                  f'{summary["median"]:>12.0f}{change:>+9.1f}%{marker}')
+    return regressions
+
+
+def qemu_version(qemu):
+    """First line of qemu --version, recorded with the results."""
+    try:
+        output = subprocess.run([qemu, '--version'], capture_output=True, text=True, check=True)
+        return output.stdout.splitlines()[0]
+    except (OSError, subprocess.CalledProcessError, IndexError):
+        return 'unknown'
+
+
+def main():
+    """
+    Usage: bench_boot.py [--runs N] [--controller ide|ahci|virtio]... [--output report.json]
+                         [--baseline old.json] [--threshold PERCENT] image...
+    Boots each image headless in QEMU, reads the stage2 trace table from the
+    debug console and writes per-phase medians and percentiles to JSON.
+    Exits with 1 when a baseline is given and a phase median regressed.
+    Example:
+        python3 bench_boot.py --runs 20 --controller ide --output boot.json aidos_0.0.3.raw
+    """
+    parser = argparse.ArgumentParser(description='Boot latency benchmark for stage2')
+    parser.add_argument('images', nargs='+')
+    parser.add_argument('--runs', type=int, default=10)
+    parser.add_argument('--warmup', type=int, default=1, help='runs discarded before measuring')
+    parser.add_argument('--controller', action='append', choices=sorted(CONTROLLERS),
+                        help='disk controller, may be repeated (default ide)')
+    parser.add_argument('--timeout', type=float, default=30.0, help='seconds before a run counts as hung')
+    parser.add_argument('--memory', type=int, default=256, help='guest memory in MB')
+    parser.add_argument('--qemu', default='qemu-system-x86_64')
+    parser.add_argument('--output', default='bench_boot.json')
+    parser.add_argument('--baseline', help='earlier report to compare medians against')
+    parser.add_argument('--threshold', type=float, default=10.0, help='allowed median increase in percent')
+    args = parser.parse_args()
+
+    controllers = args.controller or ['ide']
+    results = [bench_config(args, image, controller) for image in args.images for controller in controllers]
+
+    report = {
+        'qemu': qemu_version(args.qemu),
+        'date': time.strftime('%Y-%m-%dT%H:%M:%S'),
+        'runs': args.runs,
+        'percentiles': PERCENTILES,
+        'configs': results,
+    }
+
+    regressions = []
+    if args.baseline:
+        regressions = compare(results, args.baseline, args.threshold)
+        report['baseline'] = os.path.abspath(args.baseline)
+        report['regressions'] = regressions
+
+    os.makedirs(os.path.dirname(os.path.abspath(args.output)), exist_ok=True)
+    with open(args.output, 'w') as f:
+        json.dump(report, f, indent=2)
+    print(f'> Wrote {args.output}')
+
+    if regressions:
+        print(f'{len(regressions)} phase(s) regressed by more than {args.threshold}%')
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -4,6 +4,7 @@ import os
 import time
 import math
 import re
+import struct
 import parted
 import sh
 from pathlib import Path
@@ -113,10 +114,122 @@ def _addr_to_seg_offset(addr):
     offset = addr & 0xFFFF
     return (seg << 16) | offset
 
-def install_stage2(target, stage2_bin, boot_data_lba, offset=0, limit=0):
+def _find_symbol_in_elf(elf, symbol: str):
+    symtab = elf.get_section_by_name('.symtab')
+    if symtab is None:
+        return None
+    matches = symtab.get_symbol_by_name(symbol)
+    return matches[0]['st_value'] if matches else None
+
+def _patch_segment(data: bytes, segment, addr: int, value: int) -> bytes:
+    """Overwrites the 4 byte variable at addr when it lies in the file part of segment."""
+    start = addr - segment['p_vaddr']
+    if start < 0 or start + 4 > segment['p_filesz']:
+        return data
+    return data[:start] + value.to_bytes(4, 'little') + data[start + 4:]
+
+# The unpacker and the compressed stage2 are loaded here, stage2 only
+# starts using the memory (scratch and LZ4 buffers) after it has run.
+UNPACK_ADDR = 0x60000
+UNPACK_LIMIT = 0x90000
+# Independent LZ4 blocks, small enough that real mode offsets never wrap.
+# A record's size field has 15 bits, a stored block must fit in them.
+UNPACK_BLOCK_SIZE = 0x4000
+UNPACK_BLOCK_STORED = 0x8000
+UNPACK_BLOCK_SIZE_MASK = 0x7FFF
+assert UNPACK_BLOCK_SIZE <= UNPACK_BLOCK_SIZE_MASK
+
+def unpack_stage2(image: bytes, payload: int) -> dict:
+    """
+    Decodes the records of a packed stage2 the way unpack.asm does, so the
+    format can be checked on the host. Returns the blocks by destination.
+    """
+    def read_length(data, i, length):
+        if length == 15:
+            while True:
+                byte = data[i]
+                i += 1
+                length += byte
+                if byte != 255:
+                    break
+        return i, length
+
+    (blocks,) = struct.unpack_from('<H', image, 8)
+    unpacked = {}
+    source = payload
+    for _ in range(blocks):
+        destination, size = struct.unpack_from('<IH', image, source)
+        data = image[source + 6:source + 6 + (size & UNPACK_BLOCK_SIZE_MASK)]
+        source += 6 + (size & UNPACK_BLOCK_SIZE_MASK)
+
+        if size & UNPACK_BLOCK_STORED:
+            unpacked[destination] = data
+            continue
+
+        block = bytearray()
+        i = 0
+        while True:
+            token = data[i]
+            i, length = read_length(data, i + 1, token >> 4)
+            block += data[i:i + length]
+            i += length
+            # the last sequence of a block has no match
+            if i >= len(data):
+                break
+            offset = data[i] | data[i + 1] << 8
+            i, length = read_length(data, i + 2, token & 0x0F)
+            for _ in range(length + 4):
+                block.append(block[-offset])
+        unpacked[destination] = bytes(block)
+    return unpacked
+
+def pack_stage2(unpack_bin: str, entry_point: int, segments: list) -> bytes:
+    """
+    Prepend the unpacker (src/bootloader/unpack) to stage2's segments cut
+    into LZ4 blocks. Each record is the destination, the size on disk with
+    bit 15 set for blocks stored as is, and the data.
+    """
+    import lz4.block
+
+    with open(unpack_bin, 'rb') as funpack:
+        stub = bytearray(funpack.read())
+    if stub[0] != 0xEB:
+        raise ValueError(f"{unpack_bin} doesn't start with the unpacker's jump")
+
+    records = []
+    blocks = {}
+    original = 0
+    for addr, data in segments:
+        if addr + len(data) > UNPACK_ADDR:
+            raise Exception(f"Stage2 would overwrite the unpacker at {UNPACK_ADDR:#x}.")
+        original += len(data)
+        for start in range(0, len(data), UNPACK_BLOCK_SIZE):
+            block = data[start:start + UNPACK_BLOCK_SIZE]
+            blocks[addr + start] = block
+            packed = lz4.block.compress(block, mode='high_compression', compression=12, store_size=False)
+            if len(packed) >= len(block):
+                records.append(struct.pack('<IH', addr + start, len(block) | UNPACK_BLOCK_STORED) + block)
+            else:
+                records.append(struct.pack('<IH', addr + start, len(packed)) + packed)
+
+    # header after the 'jmp short main; nop; nop'
+    struct.pack_into('<IH', stub, 4, entry_point, len(records))
+    image = bytes(stub) + b''.join(records)
+    if UNPACK_ADDR + len(image) > UNPACK_LIMIT:
+        raise Exception("Compressed stage2 doesn't fit below the unpacker's limit.")
+    if unpack_stage2(image, len(stub)) != blocks:
+        raise Exception("Compressed stage2 doesn't unpack to the original segments.")
+
+    print(f"    LZ4: {original} -> {len(image)} bytes in {len(records)} blocks")
+    return image
+
+def install_stage2(target, stage2_bin, boot_data_lba, offset=0, limit=0, patches=None, unpack_bin=None):
     """
     Writes stage2 ELF segments into 'target' at the given offset.
     Then writes a 'boot table' at boot_data_lba describing the segments.
+    'patches' maps names of initialized uint32_t variables in stage2 to the values they get.
+    With 'unpack_bin' the segments are compressed behind the unpacker, which
+    the boot table then loads and enters instead.
     """
     with open(stage2_bin, 'rb') as fstage2:
         from elftools.elf.elffile import ELFFile
@@ -125,16 +238,36 @@ def install_stage2(target, stage2_bin, boot_data_lba, offset=0, limit=0):
             stage2_elf = ELFFile(fstage2)
             entry_point = _addr_to_seg_offset(stage2_elf.header['e_entry'])
 
+            patch_addrs = {}
+            for symbol, value in (patches or {}).items():
+                addr = _find_symbol_in_elf(stage2_elf, symbol)
+                if addr is None:
+                    raise ValueError(f"Can't find '{symbol}' in {stage2_bin}")
+                patch_addrs[addr] = value
+
             boot_table = []
+            packed_segments = []
             current_lba = offset
 
             # Read LOAD segments
             for segment in stage2_elf.iter_segments():
                 if describe_p_type(segment['p_type']) == 'LOAD':
                     data = segment.data()
+                    for addr, value in patch_addrs.items():
+                        data = _patch_segment(data, segment, addr, value)
                     sectors = math.ceil(len(data) / SECTOR_SIZE)
                     load_addr = _addr_to_seg_offset(segment['p_paddr'])
 
+                    # stage1 loads through real mode segments and takes a 16-bit count
+                    if segment['p_paddr'] + sectors * SECTOR_SIZE > 0x100000:
+                        raise Exception("Stage2 segments must load below 1MB.")
+                    if sectors > 0xFFFF:
+                        raise Exception("Stage2 segment is too big for one boot table entry.")
+
+                    if unpack_bin:
+                        packed_segments.append((segment['p_paddr'], data))
+                        continue
+
                     boot_table.append({
                         'lba': current_lba,
                         'load_addr': load_addr,
@@ -149,6 +282,21 @@ def install_stage2(target, stage2_bin, boot_data_lba, offset=0, limit=0):
                     if limit != 0 and current_lba >= limit:
                         raise Exception(f"Stage2 is too big for the image. Limit is {limit} sectors.")
 
+            if unpack_bin:
+                data = pack_stage2(unpack_bin, entry_point, packed_segments)
+                sectors = math.ceil(len(data) / SECTOR_SIZE)
+                if limit != 0 and current_lba + sectors >= limit:
+                    raise Exception(f"Stage2 is too big for the image. Limit is {limit} sectors.")
+
+                entry_point = _addr_to_seg_offset(UNPACK_ADDR)
+                boot_table.append({
+                    'lba': current_lba,
+                    'load_addr': entry_point,
+                    'count': sectors
+                })
+                ftarget.seek(current_lba * SECTOR_SIZE, os.SEEK_SET)
+                ftarget.write(data)
+
             # Null terminator in the boot table
             boot_table.append({'lba':0, 'load_addr':0, 'count':0})
 
@@ -162,84 +310,192 @@ def install_stage2(target, stage2_bin, boot_data_lba, offset=0, limit=0):
                 ftarget.write(entry['load_addr'].to_bytes(4, 'little'))
                 ftarget.write(entry['count'].to_bytes(2, 'little'))
 
-def update_fat_filesystem(image_path: str, partition_offset: int, kernel_path: str, extra_files: list):
+def compress_lz4(data: bytes) -> bytes:
     """
-    Update the FAT32 filesystem inside the disk image using PyFatFS in user space.
-    This avoids the need for mounting via root or libguestfs. (MANY ISSUES WITH THOSE 2 T-T)
-    It opens the disk image file at the partition offset, creates /boot (if missing),
-    and copies the kernel and any extra files into the filesystem.
+    Wrap data in an LZ4 frame stage2 can stream: independent 64KB blocks
+    (it keeps no history between blocks) and the content size recorded so
+    the loader knows how much memory the file needs.
     """
-    print(f"> Updating FAT32 filesystem in {image_path} at offset {partition_offset} sectors...")
-    pf = PyFatFS.PyFatFS(filename=image_path, offset=partition_offset * SECTOR_SIZE)
-    
-    # Ensure the /boot directory exists.
-    if not pf.exists("/boot"):
-        print("  - Creating /boot directory")
-        pf.makedir("/boot")
-    
-    # Copy the kernel file into /boot/kernel.elf.
-    print(f"  - Copying kernel: {kernel_path} to /boot/kernel.elf")
-    if not pf.exists("/boot/kernel.elf"):
-        pf.create("/boot/kernel.elf")
+    import lz4.frame
+    return lz4.frame.compress(
+        data,
+        block_size=lz4.frame.BLOCKSIZE_MAX64KB,
+        block_linked=False,
+        content_checksum=False,
+        store_size=True,
+        compression_level=lz4.frame.COMPRESSIONLEVEL_MINHC
+    )
+
+def _crc32c_table():
+    table = []
+    for i in range(256):
+        crc = i
+        for _ in range(8):
+            crc = (crc >> 1) ^ (0x82F63B78 if crc & 1 else 0)
+        table.append(crc)
+    return table
+
+_CRC32C_TABLE = _crc32c_table()
+
+def crc32c(data: bytes) -> int:
+    """CRC32C (Castagnoli), what stage2 checks images against."""
+    try:
+        import crc32c as fast
+        return fast.crc32c(data)
+    except ImportError:
+        pass
+    crc = 0xFFFFFFFF
+    for byte in data:
+        crc = (crc >> 8) ^ _CRC32C_TABLE[(crc ^ byte) & 0xFF]
+    return crc ^ 0xFFFFFFFF
+
+BUNDLE_MAGIC = 0x4C444E42  # "BNDL"
+BUNDLE_VERSION = 1
+BUNDLE_ALIGN = 0x1000
+BUNDLE_NAME_SIZE = 48
+BUNDLE_MAX_ENTRIES = 31
+BUNDLE_ENTRY = struct.Struct('<48sIIII')
+BUNDLE_HEADER = struct.Struct('<IHHIII44x')
+
+def _align(value: int, alignment: int) -> int:
+    return (value + alignment - 1) // alignment * alignment
+
+def build_bundle(files: list) -> bytes:
+    """
+    Lay out the boot files for stage2's loader/bundle.h: a header page with
+    one name/offset/size/crc32c entry per file, then each payload on a page
+    boundary. Files that don't fit the header are left to the FAT copies.
+    """
+    entries = []
+    payloads = bytearray()
+    for path, data in files:
+        name = path.lstrip('/')
+        if len(name) >= BUNDLE_NAME_SIZE or len(entries) == BUNDLE_MAX_ENTRIES:
+            print(f"  - Leaving {path} out of the bundle")
+            continue
+        offset = BUNDLE_ALIGN + len(payloads)
+        entries.append(BUNDLE_ENTRY.pack(name.encode('ascii'), offset, len(data), crc32c(data), 0))
+        payloads += data
+        payloads += bytes(_align(len(payloads), BUNDLE_ALIGN) - len(payloads))
+
+    table = b''.join(entries)
+    total = BUNDLE_ALIGN + len(payloads)
+    header = BUNDLE_HEADER.pack(BUNDLE_MAGIC, BUNDLE_VERSION, len(entries), BUNDLE_ALIGN,
+                                total // SECTOR_SIZE, crc32c(table))
+    page = header + table
+    return page + bytes(BUNDLE_ALIGN - len(page)) + bytes(payloads)
+
+def install_bundle(target: str, bundle: bytes, lba: int):
+    """Write the bundle at lba, in front of the partition."""
+    print(f"  - {len(bundle)} bytes at LBA {lba}")
+    with os.fdopen(os.open(target, os.O_RDWR), 'r+b') as ftarget:
+        ftarget.seek(lba * SECTOR_SIZE, os.SEEK_SET)
+        ftarget.write(bundle)
+
+def write_manifest(pf, checksums: list):
+    """Write /boot/crc32c.txt, one '<crc32c> <path>' line per installed file."""
+    lines = "".join(f"{crc:08x} {path.lstrip('/')}\n" for crc, path in checksums)
+    print(f"  - Writing /boot/crc32c.txt ({len(checksums)} files)")
+    if not pf.exists("/boot/crc32c.txt"):
+        pf.create("/boot/crc32c.txt")
+    with pf.open("/boot/crc32c.txt", "wb") as dest:
+        dest.write(lines.encode('ascii'))
+
+TRACE_FILE_PATH = "/boot/trace.bin"
+TRACE_FILE_MAGIC = 0x43525442  # "BTRC"
+TRACE_FILE_SIZE = 0x4000
+
+def write_trace_file(pf):
+    """
+    Preallocate /boot/trace.bin for stage2's tracefile.h. Stage2 only
+    overwrites files that start with the magic, and never resizes them, so
+    the size picked here is all the room the trace gets.
+    """
+    print(f"  - Preallocating {TRACE_FILE_PATH} ({TRACE_FILE_SIZE} bytes)")
+    if not pf.exists(TRACE_FILE_PATH):
+        pf.create(TRACE_FILE_PATH)
+    with pf.open(TRACE_FILE_PATH, "wb") as dest:
+        dest.write(struct.pack('<I', TRACE_FILE_MAGIC) + bytes(TRACE_FILE_SIZE - 4))
+
+def collect_boot_files(kernel_path: str, extra_files: list, compress=False) -> list:
+    """
+    List (target path, data) for everything that goes on the volume: the
+    kernel as /boot/kernel.elf, extra files in / and extra directories
+    copied recursively below /<name>.
+    """
+    files = []
+
     with open(kernel_path, 'rb') as kf:
         kernel_data = kf.read()
-    with pf.open("/boot/kernel.elf", "wb") as dest:
-        dest.write(kernel_data)
-    
-    # Process extra files (if any)
+    if compress:
+        compressed = compress_lz4(kernel_data)
+        print(f"    LZ4: {len(kernel_data)} -> {len(compressed)} bytes")
+        kernel_data = compressed
+    files.append(("/boot/kernel.elf", kernel_data))
+
     for extra in extra_files:
         base = os.path.basename(extra)
         if os.path.isfile(extra):
-            print(f"  - Copying extra file: {extra}")
-            if not pf.exists("/" + base):
-                pf.create("/" + base)
             with open(extra, 'rb') as ef:
-                data = ef.read()
-            with pf.open("/" + base, "wb") as dest:
-                dest.write(data)
+                files.append(("/" + base, ef.read()))
         elif os.path.isdir(extra):
-            target_dir = "/" + base
-            print(f"  - Creating directory for extra files: {target_dir}")
-            try:
-                pf.makedir(target_dir)
-            except Exception:
-                pass
-            # Recursively copy directory contents.
-            for root_dir, dirs, files in os.walk(extra):
+            for root_dir, dirs, names in os.walk(extra):
                 rel_path = os.path.relpath(root_dir, extra)
-                if rel_path == ".":
-                    current_target = target_dir
-                else:
-                    current_target = os.path.join(target_dir, rel_path).replace(os.sep, "/")
-                    try:
-                        pf.makedir(current_target)
-                    except Exception:
-                        pass
-                for file in files:
-                    local_file = os.path.join(root_dir, file)
-                    target_file = os.path.join(current_target, file).replace(os.sep, "/")
-                    print(f"    - Copying {local_file} to {target_file}")
-                    if not pf.exists(target_file):
-                        pf.create(target_file)
-                    with open(local_file, 'rb') as lf:
-                        data = lf.read()
-                    with pf.open(target_file, "wb") as dest:
-                        dest.write(data)
-    
+                current_target = "/" + base if rel_path == "." else os.path.join("/" + base, rel_path).replace(os.sep, "/")
+                for name in names:
+                    with open(os.path.join(root_dir, name), 'rb') as lf:
+                        files.append((current_target + "/" + name, lf.read()))
+
+    return files
+
+def update_fat_filesystem(image_path: str, partition_offset: int, files: list):
+    """
+    Update the FAT32 filesystem inside the disk image using PyFatFS in user space.
+    This avoids the need for mounting via root or libguestfs. (MANY ISSUES WITH THOSE 2 T-T)
+    It opens the disk image file at the partition offset, creates the
+    directories that are needed and copies every (target path, data) in files.
+    """
+    print(f"> Updating FAT32 filesystem in {image_path} at offset {partition_offset} sectors...")
+    pf = PyFatFS.PyFatFS(filename=image_path, offset=partition_offset * SECTOR_SIZE)
+    checksums = []
+
+    for target_file, data in files:
+        directory = os.path.dirname(target_file)
+        if directory != "/" and not pf.exists(directory):
+            print(f"  - Creating directory {directory}")
+            pf.makedirs(directory, recreate=True)
+
+        print(f"  - Copying {target_file} ({len(data)} bytes)")
+        if not pf.exists(target_file):
+            pf.create(target_file)
+        with pf.open(target_file, "wb") as dest:
+            dest.write(data)
+        checksums.append((crc32c(data), target_file))
+
+    write_manifest(pf, checksums)
+    write_trace_file(pf)
+
     pf.close()  # Ensure changes are written back.
     print("> FAT32 filesystem update complete.")
 
-def build_disk(image_path, stage1_bin, stage2_bin, kernel_path, size_bytes, fs_type, extra_files=None):
+def build_disk(image_path, stage1_bin, stage2_bin, kernel_path, size_bytes, fs_type, extra_files=None, compress=False, bundle=True, unpack_bin=None):
     """
     Main function to:
       1. Create a disk image file of size_bytes
       2. Create an MBR partition table
       3. Format partition with fs_type
-      4. Install Stage1/Stage2 bootloaders
-      5. Update the FAT32 filesystem with the kernel and extra files
+      4. Install Stage1/Stage2 bootloaders and the boot bundle
+      5. Update the FAT32 filesystem with the kernel and extra files, and
+         preallocate the boot trace file
     """
-    partition_offset = 2048  # commonly 1MB = 2048 sectors if SECTOR_SIZE=512
     stage2_sectors = math.ceil(os.stat(stage2_bin).st_size / SECTOR_SIZE)
+    files = collect_boot_files(kernel_path, extra_files if extra_files else [], compress)
+
+    # The bundle follows stage2 on a page boundary, the partition moves back
+    # (in steps of 1MB = 2048 sectors) when the two don't fit in front of it.
+    bundle_data = build_bundle(files) if bundle else b''
+    bundle_lba = _align(2 + stage2_sectors, BUNDLE_ALIGN // SECTOR_SIZE)
+    partition_offset = max(2048, _align(bundle_lba + len(bundle_data) // SECTOR_SIZE, 2048))
 
     # 1) Create the empty image.
     size_sectors = math.ceil(size_bytes / SECTOR_SIZE)
@@ -258,12 +514,17 @@ def build_disk(image_path, stage1_bin, stage2_bin, kernel_path, size_bytes, fs_t
     install_stage1(image_path, stage1_bin, boot_data_lba=1, offset=partition_offset)
 
     print("> Installing Stage2...")
-    install_stage2(image_path, stage2_bin, boot_data_lba=1, offset=2, limit=partition_offset-2)
+    install_stage2(image_path, stage2_bin, boot_data_lba=1, offset=2, limit=partition_offset-2,
+                   patches={'boot_bundle_lba': bundle_lba if bundle else 0xFFFFFFFF}, unpack_bin=unpack_bin)
+
+    if bundle:
+        print("> Installing the boot bundle...")
+        install_bundle(image_path, bundle_data, bundle_lba)
 
     # 5) Install kernel and extra files
     if fs_type.lower() in ['fat12', 'fat16', 'fat32']:
         print("> Updating FAT32 filesystem with kernel and extra files...")
-        update_fat_filesystem(image_path, partition_offset, kernel_path, extra_files if extra_files else [])
+        update_fat_filesystem(image_path, partition_offset, files)
     else:
         print("> Filesystem type is not FAT; skipping filesystem update.")
 
@@ -271,21 +532,27 @@ def build_disk(image_path, stage1_bin, stage2_bin, kernel_path, size_bytes, fs_t
 
 def main():
     """
-    Usage: build_disk.py <image_path> <stage1_bin> <stage2_bin> <kernel> <size_bytes> <fs_type> [extra_files...]
+    Usage: build_disk.py [--lz4] [--no-bundle] [--unpack=<unpack.bin>] <image_path> <stage1_bin> <stage2_bin> <kernel> <size_bytes> <fs_type> [extra_files...]
+    --lz4 stores /boot/kernel.elf as an LZ4 frame
+    --no-bundle leaves out the boot bundle, stage2 then reads everything from FAT
+    --unpack=<unpack.bin> stores stage2 LZ4 compressed behind this unpacker
     Example:
         python3 build_disk.py disk_image.raw stage1.bin stage2.elf kernel.elf 33554432 fat32 file1.txt dir2 ...
     """
-    if len(sys.argv) < 7:
-        print("Usage: build_disk.py <image_path> <stage1_bin> <stage2_bin> <kernel> <size_bytes> <fs_type> [extra_files...]")
+    options = [arg for arg in sys.argv[1:] if arg.startswith('--')]
+    args = [arg for arg in sys.argv[1:] if not arg.startswith('--')]
+
+    if len(args) < 6:
+        print("Usage: build_disk.py [--lz4] [--no-bundle] [--unpack=<unpack.bin>] <image_path> <stage1_bin> <stage2_bin> <kernel> <size_bytes> <fs_type> [extra_files...]")
         sys.exit(1)
 
-    image_path   = sys.argv[1]
-    stage1_bin   = sys.argv[2]
-    stage2_bin   = sys.argv[3]
-    kernel_path  = sys.argv[4]
-    size_bytes   = int(sys.argv[5])
-    fs_type      = sys.argv[6]
-    extra_files  = sys.argv[7:] if len(sys.argv) > 7 else []
+    image_path   = args[0]
+    stage1_bin   = args[1]
+    stage2_bin   = args[2]
+    kernel_path  = args[3]
+    size_bytes   = int(args[4])
+    fs_type      = args[5]
+    extra_files  = args[6:]
 
     build_disk(
         image_path=image_path,
@@ -294,7 +561,10 @@ def main():
         kernel_path=kernel_path,
         size_bytes=size_bytes,
         fs_type=fs_type,
-        extra_files=extra_files
+        extra_files=extra_files,
+        compress='--lz4' in options,
+        bundle='--no-bundle' not in options,
+        unpack_bin=next((arg.split('=', 1)[1] for arg in options if arg.startswith('--unpack=')), None)
     )
     print("Disk image creation complete!")
 
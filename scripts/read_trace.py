@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""
+Decodes the boot trace stage2 leaves in /boot/trace.bin (stage2's
+tracefile.h): the phase timings, the spans and the disk counters.
+
+Usage: read_trace.py [--json] <trace.bin | disk image>
+
+A disk image is recognized by its MBR, the file is then read out of the
+first partition with PyFatFS.
+"""
+import sys
+import json
+import struct
+
+SECTOR_SIZE = 512
+TRACE_FILE_PATH = "/boot/trace.bin"
+TRACE_FILE_MAGIC = 0x43525442  # "BTRC"
+TRACE_FILE_VERSION = 1
+
+HEADER = struct.Struct('<IHHIIQ4QIIHHHH')
+EVENT = struct.Struct('<QQII24s')
+IO_STATS = struct.Struct('<7Q32I')
+IO_FIELDS = ['commands', 'sectors', 'bytes', 'errors', 'seeks', 'cacheHits', 'cycles']
+IO_NAMES = ['disk', 'partition']
+TRACE_PHASE = 0
+
+
+def crc32c(data: bytes) -> int:
+    crc = 0xFFFFFFFF
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = (crc >> 1) ^ (0x82F63B78 if crc & 1 else 0)
+    return crc ^ 0xFFFFFFFF
+
+
+def read_from_image(path):
+    """Reads TRACE_FILE_PATH out of the first MBR partition of a disk image."""
+    from pyfatfs import PyFatFS
+    with open(path, 'rb') as image:
+        mbr = image.read(SECTOR_SIZE)
+    lba = struct.unpack_from('<I', mbr, 0x1BE + 8)[0]
+    pf = PyFatFS.PyFatFS(filename=path, offset=lba * SECTOR_SIZE)
+    try:
+        with pf.open(TRACE_FILE_PATH, 'rb') as trace:
+            return trace.read()
+    finally:
+        pf.close()
+
+
+def decode(data: bytes):
+    """Returns the trace as a dict, raises ValueError when it isn't a complete one."""
+    if len(data) < HEADER.size:
+        raise ValueError("too short for a trace header")
+    (magic, version, header_size, size, checksum, frequency, *rest) = HEADER.unpack_from(data)
+    boot_tsc = rest[:4]
+    event_count, dropped, event_size, io_count, io_size, _ = rest[4:]
+
+    if magic != TRACE_FILE_MAGIC:
+        raise ValueError("not a trace file")
+    if version == 0 or size == 0:
+        raise ValueError("no boot has written the trace yet")
+    if version != TRACE_FILE_VERSION or event_size != EVENT.size or io_size != IO_STATS.size:
+        raise ValueError(f"unknown trace version {version}")
+    if size > len(data) or crc32c(data[header_size:size]) != checksum:
+        raise ValueError("trace checksum mismatch")
+
+    def us(ticks):
+        return ticks * 1000000 // frequency if frequency else 0
+
+    events = []
+    offset = header_size
+    for _ in range(event_count):
+        start, end, nbytes, kind, name = EVENT.unpack_from(data, offset)
+        offset += EVENT.size
+        ticks = end - start
+        events.append({
+            'name': name.split(b'\0', 1)[0].decode('ascii', 'replace'),
+            'kind': 'phase' if kind == TRACE_PHASE else 'span',
+            'start_us': us(start - boot_tsc[0]),
+            'us': us(ticks),
+            'bytes': nbytes,
+            'kbs': nbytes * frequency // ticks // 1024 if nbytes and ticks and frequency else None,
+        })
+
+    io = {}
+    for i in range(io_count):
+        values = IO_STATS.unpack_from(data, offset)
+        offset += IO_STATS.size
+        stats = dict(zip(IO_FIELDS, values[:len(IO_FIELDS)]))
+        stats['us'] = us(stats.pop('cycles'))
+        stats['latency'] = list(values[len(IO_FIELDS):])
+        io[IO_NAMES[i] if i < len(IO_NAMES) else f'io{i}'] = stats
+
+    return {'tsc_frequency': frequency, 'events_dropped': dropped, 'events': events, 'io': io}
+
+
+def print_trace(trace):
+    print("phase                        us      KB/s")
+    for event in trace['events']:
+        if event['kind'] != 'phase':
+            continue
+        kbs = f"{event['kbs']:10}" if event['kbs'] is not None else ""
+        print(f"  {event['name']:<20}{event['us']:10}{kbs}")
+
+    spans = [event for event in trace['events'] if event['kind'] == 'span']
+    if spans:
+        print(f"  {len(spans)} spans, {sum(event['bytes'] for event in spans)} bytes in "
+              f"{sum(event['us'] for event in spans)} us")
+    if trace['events_dropped']:
+        print(f"  ({trace['events_dropped']} older events dropped)")
+
+    for name, stats in trace['io'].items():
+        print(f"{name}: commands {stats['commands']} sectors {stats['sectors']} errors {stats['errors']} "
+              f"seeks {stats['seeks']} cache hits {stats['cacheHits']}, {stats['us']} us busy")
+        for bucket, count in enumerate(stats['latency']):
+            if count:
+                print(f"  2^{bucket:<2}{count:8}")
+
+
+def main():
+    args = [arg for arg in sys.argv[1:] if not arg.startswith('--')]
+    if len(args) != 1:
+        print(__doc__.strip())
+        sys.exit(1)
+
+    with open(args[0], 'rb') as source:
+        head = source.read(SECTOR_SIZE)
+        data = head + source.read()
+    if struct.unpack_from('<I', head)[0] != TRACE_FILE_MAGIC and head[510:512] == b'\x55\xAA':
+        data = read_from_image(args[0])
+
+    try:
+        trace = decode(data)
+    except ValueError as error:
+        print(f"read_trace: {error}")
+        sys.exit(1)
+
+    if '--json' in sys.argv[1:]:
+        print(json.dumps(trace, indent=2))
+    else:
+        print_trace(trace)
+
+
+if __name__ == "__main__":
+    main()
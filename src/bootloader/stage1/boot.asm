@@ -2,6 +2,9 @@ bits 16
 
 %include "config.inc"
 
+; largest transfer an EDD read is guaranteed to take
+EDD_MAX_SECTORS equ 127
+
 global start
 
 ;-------------------------------------------------------------------------
@@ -87,7 +90,7 @@ start:
     ; --- Step 5: Read boot table from disk ---
     mov si, boot_table
     mov eax, [boot_data_lba]
-    mov cl, 1
+    mov cx, 1
     mov bx, boot_table
     call disk_read
 
@@ -106,7 +109,7 @@ start:
     mov bx, [si + boot_table_entry.load_seg]    ; load segment
     mov es, bx
     mov bx, [si + boot_table_entry.load_off]    ; load offset
-    mov cl, [si + boot_table_entry.count]       ; number of sectors to read
+    mov cx, [si + boot_table_entry.count]       ; number of sectors to read
     call disk_read
 
     add si, boot_table_entry_size    ; move to next boot table entry
@@ -115,6 +118,8 @@ start:
 .end_readloop:
     ; --- Step 6: Jump to stage 2 ---
     mov dl, [ebr_drive_number]       ; restore drive number
+    push ds                          ; ES:DI = partition entry, ES was left at
+    pop es                           ; the segment of the last table entry
     mov di, partition_entry
 
     mov ax, [entry_point.segment]
@@ -175,7 +180,8 @@ lba_to_chs:
     shl ah, 6
     or cl, ah                          ; Merge upper 2 bits of cylinder into CL
 
-    pop dx
+    pop ax
+    mov dl, al                         ; Restore the drive, keep the head in DH
     pop ax
     ret
 
@@ -217,95 +223,90 @@ check_disk_extended:
 ;-------------------------------------------------------------------------
 ; Function: disk_read
 ; Description: Reads sectors from the disk into memory.
-;              Uses extended disk functions if available; otherwise, it falls back
-;              to the standard BIOS disk read.
+;              With extended disk functions every call transfers as many
+;              sectors as EDD allows (127), otherwise it falls back to the
+;              standard BIOS disk read one sector at a time. The buffer is
+;              renormalized before each transfer so a read never wraps
+;              around inside its segment. The running LBA lives in the DAP,
+;              some BIOSes clobber the upper halves of 32-bit registers.
 ; Inputs:
 ;   EAX - LBA address of the sector(s) to read.
-;   CL  - Number of sectors to read (up to 128).
+;   CX  - Number of sectors to read.
 ;   DL  - Drive number.
 ;   ES:BX - Destination memory address for the data.
 ;-------------------------------------------------------------------------
 disk_read:
-    push eax
-    push bx
-    push cx
-    push dx
-    push si
-    push di
+    pushad
+    push es
 
+    mov [extension_dap.address], eax
+
+.next_transfer:
+    ; --- Move whole paragraphs of the offset into the segment ---
+    mov ax, bx
+    shr ax, 4
+    mov di, es
+    add di, ax
+    mov es, di
+    and bx, 0Fh
+
+    ; --- Sectors in this transfer ---
+    mov di, 1
     cmp byte [disk_extended_present], 1
-    jne .no_disk_extensions
+    jne .transfer
+    mov di, cx
+    cmp di, EDD_MAX_SECTORS
+    jbe .transfer
+    mov di, EDD_MAX_SECTORS
 
-    ; --- Extended Disk Read ---
-    mov [extension_dap.address], eax
-    mov [extension_dap.segment], es
+.transfer:
     mov [extension_dap.offset], bx
-    mov [extension_dap.count], cl
+    mov [extension_dap.segment], es
+    mov dh, 3            ; Set retry count
+
+.retry:
+    pusha                ; Save all registers (BIOS call may modify them)
+    cmp byte [disk_extended_present], 1
+    jne .chs
 
+    ; --- Extended Disk Read ---
+    ; A failed read leaves the count of blocks it did transfer in the DAP,
+    ; so every attempt asks for the whole transfer again.
+    mov [extension_dap.count], di
     mov ah, 0x42
     mov si, extension_dap
-    mov di, 3         ; Set retry count
+    jmp .read
 
-.ext_retry:
-    pusha           ; Save all registers (BIOS call may modify them)
-    stc             ; Set carry flag (some BIOSes require this)
-    int 13h         ; Extended disk read
-    jnc .ext_done   ; Jump if successful (carry flag clear)
-    popa
+.chs:
+    ; --- Standard Disk Read (Fallback) ---
+    mov ax, [extension_dap.address]
+    call lba_to_chs      ; Convert current LBA to CHS address
+    mov ax, 0201h        ; BIOS standard disk read, one sector
+
+.read:
+    stc                  ; Set carry flag (some BIOSes require this)
+    int 13h
+    popa                 ; leaves the carry flag alone
+    jnc .advance
     call disk_reset
-    dec di
-    cmp di, 0
-    jne .ext_retry
+    dec dh
+    jnz .retry
     jmp floppy_error
 
-.ext_done:
-    popa
-    jmp .function_end
-
-.no_disk_extensions:
-    ; --- Standard Disk Read (Fallback) ---
-    mov esi, eax         ; Save LBA address in ESI
-    mov di, cx           ; Outer loop count: number of sectors to read
-.outer_loop:
-    mov eax, esi
-    call lba_to_chs      ; Convert current LBA to CHS address
-    mov al, 1            ; Always read one sector at a time
-
-    push di             ; Save outer loop sector count
-    mov di, 3           ; Inner loop: set retry count for this sector
-    mov ah, 02h         ; BIOS standard disk read function
-.inner_loop:
-    pusha             ; Save registers (BIOS may modify them)
-    stc               ; Set carry flag
-    int 13h           ; Attempt to read one sector
-    jnc .inner_success; If read is successful, jump out of inner loop
-    popa
-    dec di            ; Decrement retry count
-    cmp di, 0
-    jne .inner_loop   ; Retry if count not exhausted
-    jmp floppy_error ; If all retries fail, jump to error handler
-
-.inner_success:
-    popa              ; Restore registers after successful read
-    pop di            ; Retrieve outer loop sector count into DI
-    cmp di, 0
-    je .function_end  ; All sectors read; exit function
-
-    inc esi           ; Move to the next LBA
-    dec di            ; Decrement outer loop sector count
-    ; Increment destination address by one sector (512 bytes / 16 = 32 words)
+.advance:
+    ; --- Step past the sectors just read (512 bytes = 32 paragraphs each) ---
+    movzx edi, di
+    add [extension_dap.address], edi
+    sub cx, di
+    shl di, 5
     mov ax, es
-    add ax, 32
+    add ax, di
     mov es, ax
-    jmp .outer_loop
+    test cx, cx
+    jnz .next_transfer
 
-.function_end:
-    pop di
-    pop si
-    pop dx
-    pop cx
-    pop bx
-    pop eax
+    pop es
+    popad
     ret
 
 ;-------------------------------------------------------------------------
@@ -2,17 +2,24 @@
 
 %define ENDL 0x0A, 0x0D
 
+; Top of stage2's stack (linker.ld keeps the image below it). Real mode
+; reaches it through SS = STACK_SEGMENT, protected mode reloads ESP.
+%define STACK_SEGMENT   0x1000
+%define STACK_OFFSET    0xFFF0
+
 global entry
 global drive_number
 global boot_partition_segment
 global boot_partition_offset
+global boot_tsc
 
 extern detect_memory
+extern set_vbe_mode
 extern to_32_prot
-extern __bss_start
-extern __end
 
-section .text
+; Real mode can only address the first 64 KB of the image, linker.ld
+; places the *16 sections there.
+section .text16 progbits alloc exec nowrite align=16
 
 ;----------------------------------------------------------------
 ; Main Entry Function (Stage 2 Entry Point)
@@ -21,7 +28,6 @@ section .text
 ; It:
 ;  - Disables interrupts and sets up the stack.
 ;  - Saves the drive number and boot partition address.
-;  - Clears the BSS section.
 ;  - Clears the screen and disables the cursor.
 ;  - Prints a 16-bit mode entry message.
 ;  - Calls external routines to detect memory and switch to 32-bit 
@@ -31,12 +37,10 @@ entry:
     ; Disable interrupts for safe initialization.
     cli
 
-    ; Set up the stack: use DS as SS.
-    mov ax, ds 
+    ; Set up the stack above the image, it grows down towards __end.
+    mov ax, STACK_SEGMENT
     mov ss, ax
-
-    ; Initialize the stack pointer near the top of memory.
-    mov sp, 0xFFF0
+    mov sp, STACK_OFFSET
     mov bp, sp
 
     ; Save drive number from DL.
@@ -46,13 +50,16 @@ entry:
     mov [boot_partition_segment], es
     mov [boot_partition_offset], di
 
-    ; Clear the BSS section (zero memory between __bss_start and __end).
-    mov edi, __bss_start
-    mov ecx, __end
-    sub ecx, edi
-    mov al, 0
-    cld
-    rep stosb
+    ; Time stamp of stage2 entry for the boot profiler (after DL is saved).
+    rdtsc
+    mov [boot_tsc], eax
+    mov [boot_tsc + 4], edx
+
+    ; ES still holds the partition table segment, E820 writes through ES.
+    push ds
+    pop es
+
+    ; The BSS lies past 64 KB, to_32_prot clears it once in protected mode.
 
     ; Clear the screen.
     call clr_scrn
@@ -68,6 +75,16 @@ entry:
 
     ; Call external functions.
     call detect_memory
+
+    rdtsc
+    mov [boot_tsc + 8], eax
+    mov [boot_tsc + 12], edx
+
+%ifdef FRAMEBUFFER
+    ; Leave text mode while the BIOS is still reachable.
+    call set_vbe_mode
+%endif
+
     call to_32_prot
 
 .halt:
@@ -144,10 +161,15 @@ clr_scrn:
     pop ax
     ret
 
-section .data
+section .data16 progbits alloc noexec write align=8
     drive_number:            db 0
     boot_partition_segment:  dw 0
     boot_partition_offset:   dw 0
 
-section .rodata
+    ; rdtsc at entry, after E820, in protected mode and in long mode
+    ; (BOOT_TSC_* in trace.h). Lives in .data so the BSS clear keeps it.
+    align 8
+    boot_tsc:                times 4 dq 0
+
+section .rodata16 progbits alloc noexec nowrite align=4
     bit16_msg: db "Stage2 16 bit mode entered!", ENDL, 0
@@ -6,7 +6,7 @@ global memory_size
 
 %define ENDL 0x0A, 0x0D
 
-section .text
+section .text16 progbits alloc exec nowrite align=16
 
 ;-------------------------------------------------------------------
 ; Main Function: detect_memory
@@ -128,9 +128,10 @@ puts:
     pop si
     ret
 
-section .rodata
+section .rodata16 progbits alloc noexec nowrite align=4
     memory_fail_msg: db "ERROR: memory detection has failed!", ENDL, 0
 
-section .bss
-    memory_map: resb 512
-    memory_size: resb 1
+; Filled in before the BSS is cleared, so kept with the real mode data.
+section .data16 progbits alloc noexec write align=8
+    memory_map: times 512 db 0
+    memory_size: dw 0
@@ -0,0 +1,205 @@
+[bits 16]
+
+global set_vbe_mode
+global vbe_framebuffer
+
+; Largest mode looked for, Kconfig passes FRAMEBUFFER_WIDTH/HEIGHT.
+%ifndef FRAMEBUFFER_WIDTH
+%define FRAMEBUFFER_WIDTH 1024
+%endif
+%ifndef FRAMEBUFFER_HEIGHT
+%define FRAMEBUFFER_HEIGHT 768
+%endif
+
+; BIOS buffers go to the scratch region (MEMORY_SCRATCH_START).
+%define VBE_SEGMENT         0x6000
+%define VBE_INFO            0x0000
+%define VBE_MODE            0x0200
+
+; The ROM font is kept at MEMORY_FONT_START (memory.h).
+%define FONT_SEGMENT        0x9C00
+%define FONT_ROM_SIZE       (256 * 16)
+
+; VbeInfoBlock
+%define INFO_MODE_LIST      14
+
+; ModeInfoBlock
+%define MODE_ATTRIBUTES     0
+%define MODE_PITCH          16
+%define MODE_WIDTH          18
+%define MODE_HEIGHT         20
+%define MODE_BPP            25
+%define MODE_MODEL          27
+%define MODE_RED_SIZE       31
+%define MODE_FRAMEBUFFER    40
+
+; supported, color, graphics and linear framebuffer
+%define MODE_ATTRIBUTES_NEEDED  0x99
+%define MODEL_DIRECT_COLOR      6
+%define MODE_SET_LINEAR         0x4000
+
+section .text16 progbits alloc exec nowrite align=16
+
+;-------------------------------------------------------------------
+; Function: set_vbe_mode
+;
+; Description:
+;   Walks the VBE mode list for the largest 32 bit direct color mode
+;   with a linear framebuffer that fits FRAMEBUFFER_WIDTH x
+;   FRAMEBUFFER_HEIGHT, sets it and fills in vbe_framebuffer. The
+;   8x16 ROM font is copied out first for the 64-bit console. Without
+;   VBE 2.0 or a fitting mode the screen stays in text mode and
+;   vbe_framebuffer.address stays 0.
+;-------------------------------------------------------------------
+set_vbe_mode:
+    pushad
+    push es
+    push fs
+
+    mov ax, VBE_SEGMENT
+    mov es, ax
+
+    ; Ask for the VBE 2.0 controller information.
+    mov di, VBE_INFO
+    mov dword [es:di], 'VBE2'
+    mov ax, 0x4F00
+    int 0x10
+    cmp ax, 0x004F
+    jne .done
+
+    ; FS:SI walks the mode list, which ends with 0xFFFF.
+    mov si, [es:VBE_INFO + INFO_MODE_LIST]
+    mov ax, [es:VBE_INFO + INFO_MODE_LIST + 2]
+    mov fs, ax
+
+.next_mode:
+    mov cx, [fs:si]
+    cmp cx, 0xFFFF
+    je .chosen
+    add si, 2
+
+    ; Some BIOSes don't preserve more than they have to.
+    push si
+    push cx
+    push fs
+    mov ax, 0x4F01
+    mov di, VBE_MODE
+    int 0x10
+    pop fs
+    pop cx
+    pop si
+    cmp ax, 0x004F
+    jne .next_mode
+
+    mov al, [es:VBE_MODE + MODE_ATTRIBUTES]
+    and al, MODE_ATTRIBUTES_NEEDED
+    cmp al, MODE_ATTRIBUTES_NEEDED
+    jne .next_mode
+    cmp byte [es:VBE_MODE + MODE_BPP], 32
+    jne .next_mode
+    cmp byte [es:VBE_MODE + MODE_MODEL], MODEL_DIRECT_COLOR
+    jne .next_mode
+
+    movzx eax, word [es:VBE_MODE + MODE_WIDTH]
+    cmp eax, FRAMEBUFFER_WIDTH
+    ja .next_mode
+    movzx ebx, word [es:VBE_MODE + MODE_HEIGHT]
+    cmp ebx, FRAMEBUFFER_HEIGHT
+    ja .next_mode
+
+    ; Keep the largest area seen so far.
+    imul eax, ebx
+    cmp eax, [best_area]
+    jbe .next_mode
+    mov [best_area], eax
+    mov [best_mode], cx
+    jmp .next_mode
+
+.chosen:
+    cmp dword [best_area], 0
+    je .done
+
+    ; Copy the 8x16 ROM font (INT 10h AX=1130h BH=06h returns it in ES:BP).
+    push es
+    push ds
+    mov ax, 0x1130
+    mov bh, 0x06
+    int 0x10
+    push es
+    pop ds
+    mov si, bp
+    mov ax, FONT_SEGMENT
+    mov es, ax
+    xor di, di
+    mov cx, FONT_ROM_SIZE
+    cld
+    rep movsb
+    pop ds
+    pop es
+
+    ; Fetch the chosen mode again, then set it with the linear framebuffer.
+    mov cx, [best_mode]
+    mov ax, 0x4F01
+    mov di, VBE_MODE
+    int 0x10
+    cmp ax, 0x004F
+    jne .done
+
+    mov bx, [best_mode]
+    or bx, MODE_SET_LINEAR
+    mov ax, 0x4F02
+    int 0x10
+    cmp ax, 0x004F
+    jne .done
+
+    ; Record the mode for the console and the kernel.
+    mov eax, [es:VBE_MODE + MODE_FRAMEBUFFER]
+    mov [vbe_framebuffer.address], eax
+    movzx eax, word [es:VBE_MODE + MODE_PITCH]
+    mov [vbe_framebuffer.pitch], eax
+    movzx eax, word [es:VBE_MODE + MODE_WIDTH]
+    mov [vbe_framebuffer.width], eax
+    movzx eax, word [es:VBE_MODE + MODE_HEIGHT]
+    mov [vbe_framebuffer.height], eax
+    mov al, [es:VBE_MODE + MODE_BPP]
+    mov [vbe_framebuffer.bpp], al
+
+    ; Mask sizes and positions come as size, position pairs: red, green, blue.
+    mov bx, 0
+.masks:
+    mov al, [es:VBE_MODE + MODE_RED_SIZE + bx]
+    mov [vbe_framebuffer.redSize + bx], al
+    mov al, [es:VBE_MODE + MODE_RED_SIZE + bx + 1]
+    mov [vbe_framebuffer.redPosition + bx], al
+    add bx, 2
+    cmp bx, 6
+    jb .masks
+
+    mov ax, [best_mode]
+    mov [vbe_framebuffer.mode], ax
+
+.done:
+    pop fs
+    pop es
+    popad
+    ret
+
+section .data16 progbits alloc noexec write align=8
+
+    best_mode:  dw 0
+    best_area:  dd 0
+
+    ; Layout matches vbe_framebuffer_info in framebuffer.h.
+    vbe_framebuffer:
+    .address:       dq 0
+    .pitch:         dd 0
+    .width:         dd 0
+    .height:        dd 0
+    .bpp:           db 0
+    .redPosition:   db 0
+    .redSize:       db 0
+    .greenPosition: db 0
+    .greenSize:     db 0
+    .bluePosition:  db 0
+    .blueSize:      db 0
+    .mode:          dw 0
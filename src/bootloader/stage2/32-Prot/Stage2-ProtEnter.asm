@@ -3,9 +3,18 @@
 global to_32_prot
 
 extern to_64_prot
+extern boot_tsc
+extern vbe_framebuffer
+extern __bss_start
+extern __end
 
 %define ENDL 0x0A, 0x0D
 
+; Flat data selector in g_GDT
+%define DATA_SELECTOR   0x10
+; Same stack top as Stage2-Entry.asm (STACK_SEGMENT:STACK_OFFSET)
+%define STACK_TOP       0x1FFF0
+
 ; Keyboard controller port definitions
 KbdControllerDataPort              equ 0x60
 KbdControllerCommandPort           equ 0x64
@@ -14,7 +23,7 @@ KbdControllerEnableKeyboard        equ 0xAE
 KbdControllerReadCtrlOutputPort    equ 0xD0
 KbdControllerWriteCtrlOutputPort   equ 0xD1
 
-section .text
+section .text16 progbits alloc exec nowrite align=16
 
 ;---------------------------------------------------------------
 ; Main Function: to_32_prot
@@ -29,14 +38,20 @@ section .text
 ;     5. Loads the Global Descriptor Table (GDT).
 ;     6. Sets the Protection Enable (PE) bit in CR0.
 ;     7. Jumps to the 32-bit code segment.
+;     8. Loads flat data segments and clears the BSS.
 ;---------------------------------------------------------------
 to_32_prot:
+    ; Text output would only draw over a graphics mode.
+    cmp dword [vbe_framebuffer], 0
+    jne .graphics
+
     call clr_scrn
 
     ; Print message: "Switching to 32bit protected mode!"
     mov si, to_prot_message
     call puts
 
+.graphics:
     cli             ; Disable interrupts
     call EnableA20  ; Enable the A20 line
     call LoadGDT    ; Load the Global Descriptor Table
@@ -54,6 +69,30 @@ to_32_prot:
 
 .PMODE32:
     [bits 32]
+    ; The real mode segments still limit data accesses to 64 KB.
+    mov ax, DATA_SELECTOR
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    mov ss, ax
+    mov esp, STACK_TOP
+
+    ; Clear the BSS section (zero memory between __bss_start and __end).
+    ; A dword at a time, rounding up only touches free memory below the stack.
+    mov edi, __bss_start
+    mov ecx, __end
+    sub ecx, edi
+    add ecx, 3
+    shr ecx, 2
+    xor eax, eax
+    cld
+    rep stosd
+
+    rdtsc
+    mov [boot_tsc + 16], eax
+    mov [boot_tsc + 20], edx
+
     call to_64_prot
     cli
     hlt
@@ -217,10 +256,10 @@ clr_scrn:
     pop ax
     ret
 
-section .data
+section .data16 progbits alloc noexec write align=8
     screen_pointer: dd 0xB8000
 
-section .rodata
+section .rodata16 progbits alloc noexec nowrite align=4
     to_prot_message: db "Switching to 32bit protected mode!", 0
 
     g_GDT: 
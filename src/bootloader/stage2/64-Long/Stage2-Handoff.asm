@@ -0,0 +1,34 @@
+bits 64
+
+global kernel_handoff
+
+section .text
+
+;---------------------------------------------------------------
+; Function: kernel_handoff
+;
+; Description:
+;   Leaves stage2 for good and enters the kernel. Interrupts stay
+;   disabled, the stack is switched to the one prepared for the
+;   kernel and the bootinfo pointer is left in RDI so the entry
+;   point can be an ordinary C function taking it as argument.
+;
+; Input:
+;   RDI - virtual entry point of the kernel
+;   RSI - pointer to the bootinfo structure
+;   RDX - top of the kernel stack
+;---------------------------------------------------------------
+kernel_handoff:
+    cli
+
+    mov rax, rdi            ; Entry point.
+    mov rdi, rsi            ; First argument: bootinfo.
+    mov rsp, rdx            ; Switch to the kernel stack.
+    xor rbp, rbp            ; Terminate stack traces here.
+
+    push 0                  ; Fake return address, keeps the ABI alignment.
+    jmp rax
+
+.halt:
+    hlt
+    jmp .halt
@@ -10,6 +10,7 @@ extern boot_partition_segment
 extern boot_partition_offset
 extern memory_map
 extern memory_size
+extern boot_tsc
 
 section .text
 
@@ -35,7 +36,7 @@ to_64_prot:
     call clr_scrn
 
     ; Print message: "Switching to 64 bit long mode!!"
-    mov si, to_long_msg
+    mov esi, to_long_msg
     call puts
 
     ; Check for CPUID support
@@ -61,6 +62,10 @@ to_64_prot:
 
     cli  ; Disable interrupts
 
+    rdtsc
+    mov [boot_tsc + 24], eax
+    mov [boot_tsc + 28], edx
+
     ; Call C++ global constructors (_init)
     call _init
 
@@ -123,7 +128,7 @@ check_cpuid:
     ret
 
 .no_cpuid:
-    mov si, no_cpuid_error_msg
+    mov esi, no_cpuid_error_msg
     call puts
     cli
     hlt
@@ -160,12 +165,12 @@ check_long_mode:
     ret
 
 .no_ext_pro_info:
-    mov si, no_ext_pro_info_msg
+    mov esi, no_ext_pro_info_msg
     call puts
     jmp .halt
 
 .no_long_mode:
-    mov si, no_long_mode_msg
+    mov esi, no_long_mode_msg
     call puts
     jmp .halt
 
@@ -266,11 +271,11 @@ LoadGDT:
 ;   each character to video memory at the address given by screen_pointer.
 ;
 ; Input:
-;   SI - Pointer to the null-terminated string.
+;   ESI - Pointer to the null-terminated string.
 ;---------------------------------------------------------------
 puts:
     [bits 32]
-    push si
+    push esi
     push ax
     push ebx
 
@@ -286,7 +291,7 @@ puts:
 .puts_done:
     pop ebx
     pop ax
-    pop si
+    pop esi
     ret
 
 ;---------------------------------------------------------------
@@ -343,6 +348,15 @@ section .data
         db 11001111b    ; Flags: long mode enabled
         db 0            ; Base high (ignored)
 
+        ; 32-bit code segment descriptor (selector 0x18), used to drop
+        ; back to protected mode for multiboot kernels
+        dw 0xFFFF       ; Limit low
+        dw 0            ; Base low
+        db 0            ; Base middle
+        db 10011010b    ; Access: present, ring 0, code, executable, readable
+        db 11001111b    ; Flags: 4KB granularity, 32-bit
+        db 0            ; Base high
+
     g_GDT64Desc:
         dw g_GDT64Desc - g_GDT64 - 1    ; Limit: size of GDT - 1
         dd g_GDT64                      ; Base address of the GDT
@@ -0,0 +1,72 @@
+bits 64
+
+global multiboot2_handoff
+
+; Selectors in g_GDT64 (Stage2-LongEnter.asm)
+GDT64_DATA_SELECTOR     equ 0x10
+GDT64_CODE32_SELECTOR   equ 0x18
+
+MULTIBOOT2_BOOTLOADER_MAGIC equ 0x36D76289
+
+section .text
+
+;---------------------------------------------------------------
+; Function: multiboot2_handoff
+;
+; Description:
+;   Enters a multiboot2 kernel. The spec wants 32-bit protected
+;   mode with paging off, so this:
+;     1. Far returns into a 32-bit compatibility mode segment.
+;     2. Turns paging off, which also deactivates long mode.
+;     3. Clears EFER.LME and CR4.PAE/PGE.
+;     4. Loads flat data segments.
+;     5. Jumps to the entry with the magic in EAX and the
+;        information structure in EBX.
+;
+;   Must run from identity mapped memory below 4GB, which stage2
+;   always is.
+;
+; Input:
+;   EDI - physical entry point of the kernel
+;   ESI - physical address of the multiboot2 information structure
+;---------------------------------------------------------------
+multiboot2_handoff:
+    cli
+
+    push GDT64_CODE32_SELECTOR
+    mov rax, .compat
+    push rax
+    retfq
+
+.compat:
+    bits 32
+    ; Disable paging (we are running identity mapped).
+    mov eax, cr0
+    and eax, ~(1 << 31)
+    mov cr0, eax
+
+    ; Clear the Long Mode Enable bit.
+    mov ecx, 0xC0000080         ; IA32_EFER MSR.
+    rdmsr
+    and eax, ~(1 << 8)
+    wrmsr
+
+    ; Clear PAE and PGE, the kernel sets up its own paging.
+    mov eax, cr4
+    and eax, ~(1 << 5 | 1 << 7)
+    mov cr4, eax
+
+    mov ax, GDT64_DATA_SELECTOR
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    mov ss, ax
+
+    mov eax, MULTIBOOT2_BOOTLOADER_MAGIC
+    mov ebx, esi
+    jmp edi
+
+.halt:
+    hlt
+    jmp .halt
@@ -15,15 +15,57 @@
 #include "stdio.h"
 #include "memory/memory.h"
 #include "memory/paging.h"
+#include "memory/frames.h"
 #include "arch/x86-64/idt.h"
 #include "arch/x86-64/ata.h"
 #include "fs/FAT/fat.h"
 #include "disk.h"
 #include "mbr.h"
+#include "loader/elf.h"
+#include "loader/bootinfo.h"
+#include "loader/multiboot2.h"
+#include "loader/modules.h"
+#include "loader/integrity.h"
+#include "loader/bundle.h"
+#include "arch/x86-64/cpu.h"
+#include "arch/x86-64/acpi.h"
+#include "arch/x86-64/pci.h"
+#include "arch/x86-64/wait.h"
+#include "arch/x86-64/smp.h"
+#include "trace.h"
+#include "tracefile.h"
+#include "log.h"
+#include "console.h"
+#include "framebuffer.h"
 
 /// @brief the full memory map
 memory_map memoryMap[32];
 
+/// @brief size of the stack the kernel is entered on
+#define KERNEL_STACK_SIZE 0x4000
+
+static_assert(BOOTINFO_IO_LATENCY_BUCKETS == DISK_LATENCY_BUCKETS, "latency buckets differ");
+// acpi_system is handed over as it is
+static_assert(sizeof(bootinfo_acpi) == sizeof(acpi_system), "ACPI summary layouts differ");
+static_assert(BOOTINFO_ACPI_MAX_CPUS == ACPI_MAX_CPUS && BOOTINFO_ACPI_MAX_TABLES == ACPI_MAX_TABLES,
+              "ACPI summary lengths differ");
+static_assert(BOOTINFO_CPU_X2APIC == ACPI_CPU_X2APIC, "ACPI cpu flags differ");
+
+/*
+ * Copy the counters of one disk layer into the handoff.
+ */
+static void copy_io_stats(bootinfo_io_stats* out, const disk_stats* stats)
+{
+    out->commands = stats->commands;
+    out->sectors = stats->sectors;
+    out->bytes = stats->bytes;
+    out->errors = stats->errors;
+    out->seeks = stats->seeks;
+    out->cacheHits = stats->cacheHits;
+    out->cycles = stats->cycles;
+    memcpy(out->latency, stats->latency, sizeof(out->latency));
+}
+
 /**
  * @brief Entry function
  * @details takes in bootdrive number and partition address as arguments
@@ -35,10 +77,18 @@ memory_map memoryMap[32];
  */
 extern "C" void Start(uint16_t bootDrive, uint64_t partitionAddress, uint64_t memoryMapAddress, uint8_t memoryMapSize)
 {
+    uint64_t stage2Start = rdtsc();
+
+    log_init();
+    trace_init();
+    wait_init();
 
     init_map();
 
-    disk Disk(&ATA_READ_PRIMARY);
+    // the 16-bit stage may have left a VBE mode, the console follows it
+    framebuffer_init();
+
+    disk Disk(&ATA_READ_PRIMARY, &ATA_WRITE_PRIMARY);
     Partition part(&Disk);
     fatFS FatFileSystem(&part);
 
@@ -52,10 +102,25 @@ extern "C" void Start(uint16_t bootDrive, uint64_t partitionAddress, uint64_t me
     }
 
     memcpy(&memoryMap, (void *)memoryMapAddress, memoryMapSize * 24);
+    trace_mark("init map");
 
     idt_init();
+    trace_mark("idt init");
+
+    // tables are indexed and summarized once, smp and the kernel use the summary
+    acpi_init();
+    trace_mark("acpi");
+
+    // one walk of the buses, drivers probe the cached list
+    pci_init();
+    trace_mark("pci scan");
+
+    // the other cores decode and clear memory while the BSP drives the disk
+    smp_init();
+    trace_mark("smp init");
 
     ATA_IDENTIFY_PRIMARY();
+    trace_mark("ata identify");
 
     Disk.Init(bootDrive);
     part.Init((void *)partitionAddress);
@@ -67,40 +132,145 @@ extern "C" void Start(uint16_t bootDrive, uint64_t partitionAddress, uint64_t me
             ;
     }
 
-    FAT_File *kernelFile = FatFileSystem.open("boot/kernel.elf");
+    if (framebuffer_load_font(&FatFileSystem))
+        console_redraw();
+
+    trace_mark("fat init");
 
-    if (kernelFile == NULL)
+    crc32c_init();
+    integrity_load(&FatFileSystem);
+    trace_mark("integrity manifest");
+
+    // files in the bundle skip the FAT, the volume keeps the fallback copies
+    bundle_init(&Disk);
+    trace_mark("bundle manifest");
+
+    imageFile kernelFile(&FatFileSystem);
+
+    if (!kernelFile.open("boot/kernel.elf"))
     {
         puts("Failed to open file\r\n");
         while (1)
             ;
     }
 
-    if (kernelFile->Size >= MEMORY_KERNEL_SIZE)
+    trace_mark("open kernel");
+
+    frames_init(memoryMap, memoryMapSize);
+
+    // the kernel is placed first, fixed load addresses must not find frames already taken
+    uint64_t loadStart = rdtsc();
+
+    multiboot2_kernel multibootKernel;
+    bool isMultiboot = multiboot2_detect(&kernelFile, &multibootKernel);
+
+    elf_image kernelImage;
+    bool loaded = isMultiboot ? multiboot2_load(&kernelFile, &multibootKernel, &kernelImage)
+                              : elf_load(&kernelFile, &kernelImage);
+    if (!loaded || !kernelFile.verify())
     {
-        puts("File is too large to fit in memory!\r\n");
+        puts("Failed to load kernel\r\n");
         while (1)
             ;
     }
+    kernelFile.close();
+    trace_mark("load kernel");
+
+    loaded_module modules[MODULES_MAX];
+    uint8_t moduleCount = modules_load(&FatFileSystem, modules);
+
+    uint64_t loadEnd = rdtsc();
+    trace_mark("load modules");
 
-    for (uint8_t i = 0; i < memoryMapSize; i++)
+    disk_stats_dump("DISK", &Disk.stats);
+    disk_stats_dump("PARTITION", &part.stats);
+
+    bootinfo *info = bootinfo_create();
+    uint64_t kernelStack = frames_alloc(KERNEL_STACK_SIZE / 0x1000);
+    if (info == NULL || kernelStack == 0)
     {
-        if (memoryMap[i].type == 1)
-        {
-            if (memoryMap[i].base > MEMORY_STAGE2_END)
-            {
-                if ((memoryMap[i].length + 0x1000) > MEMORY_KERNEL_SIZE)
-                {
-                    uint64_t base = (memoryMap[i].base + 0x1000) & 0xFFFFFFFFFFFFF000;
-                    page_range_large(base, MEMORY_KERNEL_START, MEMORY_KERNEL_SIZE);
-                    break;
-                }
-            }
-        }
+        puts("Out of memory for the kernel handoff\r\n");
+        while (1)
+            ;
     }
+    page_range(kernelStack, kernelStack, KERNEL_STACK_SIZE, MAP_WRITE);
+
+    info->timestamps[BOOTINFO_TIME_STAGE2_START] = stage2Start;
+    info->timestamps[BOOTINFO_TIME_LOAD_START] = loadStart;
+    info->timestamps[BOOTINFO_TIME_LOAD_END] = loadEnd;
+    info->tscFrequency = trace_tsc_frequency();
+
+    for (uint8_t i = 0; i < moduleCount; i++)
+        bootinfo_add_module(info, modules[i].name, modules[i].base, modules[i].size);
+
+    info->bootDrive = Disk.id;
+    info->partitionLba = part.Partition_Start();
+    info->partitionSectors = part.Partition_Size();
+    copy_io_stats(&info->diskIo, &Disk.stats);
+    copy_io_stats(&info->partitionIo, &part.stats);
+
+    info->acpiRsdp = (uint64_t)acpi_get_rsdp();
+    memcpy(&info->acpi, acpi_get_system(), sizeof(info->acpi));
+
+    const IDENTIFY_RETURN *identify = ATA_IDENTIFY_DATA();
+    memcpy(info->identify, identify, sizeof(info->identify));
+    info->diskSectors = (identify->lba48_support & (1 << 10)) ? identify->number_of_lba48_sectors
+                                                              : identify->number_of_lba28_sectors;
+
+    info->kernelEntry = kernelImage.entry;
+    info->kernelVirtStart = kernelImage.virtStart;
+    info->kernelVirtEnd = kernelImage.virtEnd;
+
+    if (framebuffer_active())
+    {
+        info->framebuffer.address = vbe_framebuffer.address;
+        info->framebuffer.width = vbe_framebuffer.width;
+        info->framebuffer.height = vbe_framebuffer.height;
+        info->framebuffer.pitch = vbe_framebuffer.pitch;
+        info->framebuffer.bpp = vbe_framebuffer.bpp;
+        info->framebuffer.type = BOOTINFO_FRAMEBUFFER_RGB;
+        info->framebuffer.redPosition = vbe_framebuffer.redPosition;
+        info->framebuffer.redSize = vbe_framebuffer.redSize;
+        info->framebuffer.greenPosition = vbe_framebuffer.greenPosition;
+        info->framebuffer.greenSize = vbe_framebuffer.greenSize;
+        info->framebuffer.bluePosition = vbe_framebuffer.bluePosition;
+        info->framebuffer.blueSize = vbe_framebuffer.blueSize;
+    }
+    else
+    {
+        info->framebuffer.address = VGA_TEXT_START;
+        info->framebuffer.width = 80;
+        info->framebuffer.height = 25;
+        info->framebuffer.pitch = 80 * 2;
+        info->framebuffer.bpp = 16;
+        info->framebuffer.type = BOOTINFO_FRAMEBUFFER_TEXT;
+    }
+
+    if (!bootinfo_finalize(info, memoryMap, memoryMapSize))
+    {
+        puts("Failed to build the memory map\r\n");
+        while (1)
+            ;
+    }
+
+    // the kernel gets the application processors back in wait-for-SIPI
+    smp_shutdown();
+    trace_mark("handoff setup");
+
+    // the copy on the volume outlives the screen, machines without a console are read from it
+    bootinfo_io_stats io[2] = {info->diskIo, info->partitionIo};
+    trace_save(&FatFileSystem, io, 2);
+    trace_dump();
+    log_flush();
+    console_flush();
+
+    // benchmark builds stop here, the timings are already on the debug console
+    trace_exit();
+
+    info->timestamps[BOOTINFO_TIME_HANDOFF] = rdtsc();
 
-    uint32_t read = FatFileSystem.read(kernelFile, kernelFile->Size, (void *)MEMORY_KERNEL_START);
+    if (isMultiboot)
+        multiboot2_boot(&kernelImage, info);
 
-    for (;;)
-        ;
+    kernel_handoff(kernelImage.entry, info, kernelStack + KERNEL_STACK_SIZE);
 }
\ No newline at end of file
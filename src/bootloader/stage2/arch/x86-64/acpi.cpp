@@ -0,0 +1,353 @@
+/**
+ * @file acpi.cpp
+ * @author Aidcraft
+ * @brief finds the ACPI tables and summarizes the ones stage2 and the kernel need
+ * @version 0.0.2
+ * @date 2025-03-14
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#include "acpi.h"
+#include "../../stddef.h"
+#include "../../memory/memory.h"
+#include "../../memory/paging.h"
+
+/// @brief BDA word holding the EBDA segment
+#define BDA_EBDA_SEGMENT    0x40E
+#define EBDA_SEARCH_SIZE    0x400
+#define BIOS_AREA_START     0xE0000
+#define BIOS_AREA_END       0x100000
+#define RSDP_ALIGN          16
+/// @brief Longer tables are taken as corrupt, even large DSDTs stay well below
+#define MAX_TABLE_LENGTH    0x100000
+
+#define PAGE_MASK 0xFFF
+
+/*
+ * The BDA sits in the first page, which GCC treats as null and warns about.
+ * Reading the pointer itself as volatile keeps it from seeing the address.
+ */
+static const volatile uint16_t* volatile bdaEbdaSegment = (const volatile uint16_t*)BDA_EBDA_SEGMENT;
+
+static const acpi_rsdp* rsdp;
+static acpi_system summary;
+
+static bool checksum(const void* data, uint32_t length)
+{
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < length; i++)
+        sum += ((const uint8_t*)data)[i];
+    return sum == 0;
+}
+
+/*
+ * Firmware tables usually sit just under the top of RAM, well past the
+ * identity map. Map them read-only where they are.
+ */
+static void map(uint64_t address, uint64_t length)
+{
+    if (address + length <= MEMORY_IDENTITY_END)
+        return;
+
+    uint64_t start = address & ~(uint64_t)PAGE_MASK;
+    page_range(start, start, address + length - start, 0);
+}
+
+static const acpi_header* map_table(uint64_t address)
+{
+    if (address == 0)
+        return NULL;
+
+    map(address, sizeof(acpi_header));
+    const acpi_header* header = (const acpi_header*)address;
+
+    // a corrupt length would use up the page table pool before the checksum fails
+    if (header->length < sizeof(acpi_header) || header->length > MAX_TABLE_LENGTH)
+        return NULL;
+
+    map(address, header->length);
+    if (!checksum(header, header->length))
+        return NULL;
+    return header;
+}
+
+static const acpi_rsdp* scan(uint64_t start, uint64_t end)
+{
+    for (uint64_t address = start; address + sizeof(acpi_rsdp) <= end; address += RSDP_ALIGN)
+    {
+        const acpi_rsdp* candidate = (const acpi_rsdp*)address;
+        if (!memcmp(candidate->signature, "RSD PTR ", 8) || !checksum(candidate, ACPI_RSDP_V1_SIZE))
+            continue;
+
+        if (candidate->revision >= 2 && !checksum(candidate, candidate->length))
+            continue;
+
+        return candidate;
+    }
+    return NULL;
+}
+
+/*
+ * Put a table that passed its checksum into the index.
+ */
+static void index_table(uint64_t address)
+{
+    const acpi_header* header = map_table(address);
+    if (header == NULL || summary.tableCount >= ACPI_MAX_TABLES)
+        return;
+
+    acpi_table* table = &summary.tables[summary.tableCount++];
+    memcpy(table->signature, header->signature, 4);
+    table->length = header->length;
+    table->address = address;
+}
+
+/*
+ * Check every table the root lists once, so lookups are a walk over the
+ * index instead of touching firmware memory again. The DSDT is only
+ * reachable through the FADT and is indexed behind it.
+ */
+static void index_root(const acpi_header* root, bool isXsdt)
+{
+    uint32_t entrySize = isXsdt ? 8 : 4;
+    uint32_t count = (root->length - sizeof(acpi_header)) / entrySize;
+    const uint8_t* entries = (const uint8_t*)root + sizeof(acpi_header);
+
+    for (uint32_t i = 0; i < count; i++)
+        index_table(isXsdt ? *(const uint64_t*)(entries + i * 8) : *(const uint32_t*)(entries + i * 4));
+
+    const acpi_header* fadt = acpi_find_table(ACPI_SIGNATURE_FADT);
+    if (fadt == NULL)
+        return;
+
+    uint64_t dsdt = 0;
+    if (fadt->length >= ACPI_FADT_X_DSDT + 8)
+        dsdt = *(const uint64_t*)((const uint8_t*)fadt + ACPI_FADT_X_DSDT);
+    if (dsdt == 0 && fadt->length >= ACPI_FADT_DSDT + 4)
+        dsdt = *(const uint32_t*)((const uint8_t*)fadt + ACPI_FADT_DSDT);
+    index_table(dsdt);
+}
+
+static acpi_cpu* find_cpu(uint32_t apicId)
+{
+    for (uint32_t i = 0; i < summary.cpuCount; i++)
+    {
+        if (summary.cpus[i].apicId == apicId)
+            return &summary.cpus[i];
+    }
+    return NULL;
+}
+
+static void add_cpu(uint32_t apicId, uint32_t processorUid, uint32_t flags)
+{
+    // firmware may list a cpu both as a local APIC and as an x2APIC
+    if (find_cpu(apicId) != NULL || summary.cpuCount >= ACPI_MAX_CPUS)
+        return;
+
+    acpi_cpu* cpu = &summary.cpus[summary.cpuCount++];
+    cpu->apicId = apicId;
+    cpu->processorUid = processorUid;
+    cpu->proximity = ACPI_PROXIMITY_NONE;
+    cpu->flags = flags;
+}
+
+static void parse_madt()
+{
+    const acpi_madt* madt = (const acpi_madt*)acpi_find_table(ACPI_SIGNATURE_MADT);
+    if (madt == NULL)
+        return;
+
+    summary.localApicAddress = madt->localApicAddress;
+    summary.madtFlags = madt->flags;
+
+    const uint8_t* entry = (const uint8_t*)madt + sizeof(acpi_madt);
+    const uint8_t* end = (const uint8_t*)madt + madt->header.length;
+    while (entry + sizeof(acpi_madt_entry) <= end)
+    {
+        const acpi_madt_entry* header = (const acpi_madt_entry*)entry;
+        if (header->length < sizeof(acpi_madt_entry) || entry + header->length > end)
+            break;
+
+        switch (header->type)
+        {
+        case ACPI_MADT_LOCAL_APIC:
+        {
+            const acpi_madt_local_apic* local = (const acpi_madt_local_apic*)entry;
+            add_cpu(local->apicId, local->processorId, local->flags);
+            break;
+        }
+        case ACPI_MADT_LOCAL_X2APIC:
+        {
+            const acpi_madt_local_x2apic* local = (const acpi_madt_local_x2apic*)entry;
+            add_cpu(local->x2apicId, local->processorUid, local->flags | ACPI_CPU_X2APIC);
+            break;
+        }
+        case ACPI_MADT_IO_APIC:
+        {
+            const acpi_madt_io_apic* ioApic = (const acpi_madt_io_apic*)entry;
+            if (summary.ioApicCount < ACPI_MAX_IO_APICS)
+            {
+                acpi_io_apic* out = &summary.ioApics[summary.ioApicCount++];
+                out->id = ioApic->ioApicId;
+                out->gsiBase = ioApic->gsiBase;
+                out->address = ioApic->address;
+            }
+            break;
+        }
+        case ACPI_MADT_INTERRUPT_OVERRIDE:
+        {
+            const acpi_madt_override* override = (const acpi_madt_override*)entry;
+            if (summary.overrideCount < ACPI_MAX_OVERRIDES)
+            {
+                acpi_override* out = &summary.overrides[summary.overrideCount++];
+                out->bus = override->bus;
+                out->source = override->source;
+                out->flags = override->flags;
+                out->gsi = override->gsi;
+            }
+            break;
+        }
+        case ACPI_MADT_LOCAL_APIC_OVERRIDE:
+            summary.localApicAddress = ((const acpi_madt_local_apic_override*)entry)->address;
+            break;
+        }
+        entry += header->length;
+    }
+}
+
+static void parse_mcfg()
+{
+    const acpi_mcfg* mcfg = (const acpi_mcfg*)acpi_find_table(ACPI_SIGNATURE_MCFG);
+    if (mcfg == NULL || mcfg->header.length < sizeof(acpi_mcfg))
+        return;
+
+    uint32_t count = (mcfg->header.length - sizeof(acpi_mcfg)) / sizeof(acpi_mcfg_entry);
+    const acpi_mcfg_entry* entries = (const acpi_mcfg_entry*)(mcfg + 1);
+    for (uint32_t i = 0; i < count && summary.ecamCount < ACPI_MAX_ECAM; i++)
+        summary.ecam[summary.ecamCount++] = entries[i];
+}
+
+static void parse_hpet()
+{
+    const acpi_hpet* hpet = (const acpi_hpet*)acpi_find_table(ACPI_SIGNATURE_HPET);
+    if (hpet == NULL || hpet->header.length < sizeof(acpi_hpet))
+        return;
+
+    summary.hpetAddress = hpet->address.address;
+    summary.hpetBlockId = hpet->eventTimerBlockId;
+    summary.hpetMinimumTick = hpet->minimumTick;
+    summary.hpetNumber = hpet->hpetNumber;
+}
+
+/*
+ * Proximity domains for the cpus found in the MADT, and the memory ranges
+ * of each domain. Disabled entries are padding and skipped.
+ */
+static void parse_srat()
+{
+    const acpi_srat* srat = (const acpi_srat*)acpi_find_table(ACPI_SIGNATURE_SRAT);
+    if (srat == NULL)
+        return;
+
+    const uint8_t* entry = (const uint8_t*)srat + sizeof(acpi_srat);
+    const uint8_t* end = (const uint8_t*)srat + srat->header.length;
+    while (entry + sizeof(acpi_madt_entry) <= end)
+    {
+        const acpi_madt_entry* header = (const acpi_madt_entry*)entry;
+        if (header->length < sizeof(acpi_madt_entry) || entry + header->length > end)
+            break;
+
+        if (header->type == ACPI_SRAT_PROCESSOR && header->length >= sizeof(acpi_srat_processor))
+        {
+            const acpi_srat_processor* processor = (const acpi_srat_processor*)entry;
+            acpi_cpu* cpu = find_cpu(processor->apicId);
+            if ((processor->flags & ACPI_SRAT_ENABLED) && cpu != NULL)
+            {
+                cpu->proximity = processor->proximityLow | (uint32_t)processor->proximityHigh[0] << 8 |
+                                 (uint32_t)processor->proximityHigh[1] << 16 |
+                                 (uint32_t)processor->proximityHigh[2] << 24;
+            }
+        }
+        else if (header->type == ACPI_SRAT_X2APIC && header->length >= sizeof(acpi_srat_x2apic))
+        {
+            const acpi_srat_x2apic* processor = (const acpi_srat_x2apic*)entry;
+            acpi_cpu* cpu = find_cpu(processor->x2apicId);
+            if ((processor->flags & ACPI_SRAT_ENABLED) && cpu != NULL)
+                cpu->proximity = processor->proximity;
+        }
+        else if (header->type == ACPI_SRAT_MEMORY && header->length >= sizeof(acpi_srat_memory))
+        {
+            const acpi_srat_memory* memory = (const acpi_srat_memory*)entry;
+            if ((memory->flags & ACPI_SRAT_ENABLED) && summary.memoryAffinityCount < ACPI_MAX_MEMORY_AFFINITY)
+            {
+                acpi_memory_affinity* out = &summary.memoryAffinity[summary.memoryAffinityCount++];
+                out->base = memory->base;
+                out->length = memory->length;
+                out->proximity = memory->proximity;
+                out->flags = memory->flags;
+            }
+        }
+        entry += header->length;
+    }
+}
+
+bool acpi_init()
+{
+    uint64_t ebda = (uint64_t)*bdaEbdaSegment << 4;
+
+    memset(&summary, 0, sizeof(summary));
+    rsdp = NULL;
+    if (ebda != 0)
+        rsdp = scan(ebda, ebda + EBDA_SEARCH_SIZE);
+    if (rsdp == NULL)
+        rsdp = scan(BIOS_AREA_START, BIOS_AREA_END);
+    if (rsdp == NULL)
+        return false;
+
+    bool isXsdt = rsdp->revision >= 2 && rsdp->xsdtAddress != 0;
+    const acpi_header* root = map_table(isXsdt ? rsdp->xsdtAddress : rsdp->rsdtAddress);
+    if (root == NULL && isXsdt)
+    {
+        // some firmware ships a broken XSDT next to a usable RSDT
+        isXsdt = false;
+        root = map_table(rsdp->rsdtAddress);
+    }
+    if (root == NULL)
+        return false;
+
+    index_root(root, isXsdt);
+    parse_madt();
+    parse_mcfg();
+    parse_hpet();
+    parse_srat();
+    return true;
+}
+
+const acpi_rsdp* acpi_get_rsdp()
+{
+    return rsdp;
+}
+
+const acpi_system* acpi_get_system()
+{
+    return &summary;
+}
+
+const acpi_header* acpi_find_table(const char* signature, uint32_t index)
+{
+    for (uint32_t i = 0; i < summary.tableCount; i++)
+    {
+        if (!memcmp(summary.tables[i].signature, signature, 4))
+            continue;
+
+        if (index-- != 0)
+            continue;
+
+        return (const acpi_header*)summary.tables[i].address;
+    }
+    return NULL;
+}
@@ -0,0 +1,358 @@
+/**
+ * @file acpi.h
+ * @author Aidcraft
+ * @brief finds the ACPI tables
+ * @version 0.0.2
+ * @date 2025-03-14
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#pragma once
+
+#include "../../stdint.h"
+
+#define ACPI_SIGNATURE_MADT "APIC"
+#define ACPI_SIGNATURE_FADT "FACP"
+#define ACPI_SIGNATURE_DSDT "DSDT"
+#define ACPI_SIGNATURE_MCFG "MCFG"
+#define ACPI_SIGNATURE_HPET "HPET"
+#define ACPI_SIGNATURE_SRAT "SRAT"
+
+/// @brief Most tables kept in the index
+#define ACPI_MAX_TABLES             48
+/// @brief Most entries kept of each kind in acpi_system
+#define ACPI_MAX_CPUS               64
+#define ACPI_MAX_IO_APICS           8
+#define ACPI_MAX_OVERRIDES          16
+#define ACPI_MAX_ECAM               4
+#define ACPI_MAX_MEMORY_AFFINITY    16
+
+/// @brief Root System Description Pointer
+typedef struct
+{
+    char signature[8];
+    uint8_t checksum;
+    char oemId[6];
+    uint8_t revision;
+    uint32_t rsdtAddress;
+    // ACPI 2.0+
+    uint32_t length;
+    uint64_t xsdtAddress;
+    uint8_t extendedChecksum;
+    uint8_t _reserved[3];
+} __attribute__((packed)) acpi_rsdp;
+
+/// @brief bytes of an ACPI 1.0 RSDP, the part covered by checksum
+#define ACPI_RSDP_V1_SIZE 20
+
+/// @brief Header shared by every system description table
+typedef struct
+{
+    char signature[4];
+    uint32_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    char oemId[6];
+    char oemTableId[8];
+    uint32_t oemRevision;
+    uint32_t creatorId;
+    uint32_t creatorRevision;
+} __attribute__((packed)) acpi_header;
+
+/// @brief Multiple APIC Description Table
+typedef struct
+{
+    acpi_header header;
+    uint32_t localApicAddress;
+    uint32_t flags;
+    // followed by variable length entries
+} __attribute__((packed)) acpi_madt;
+
+/// @brief Common start of MADT entries
+typedef struct
+{
+    uint8_t type;
+    uint8_t length;
+} __attribute__((packed)) acpi_madt_entry;
+
+enum acpi_madt_type
+{
+    ACPI_MADT_LOCAL_APIC            = 0,
+    ACPI_MADT_IO_APIC               = 1,
+    ACPI_MADT_INTERRUPT_OVERRIDE    = 2,
+    ACPI_MADT_LOCAL_APIC_OVERRIDE   = 5,
+    ACPI_MADT_LOCAL_X2APIC          = 9,
+};
+
+/// @brief ACPI_MADT_IO_APIC entry
+typedef struct
+{
+    acpi_madt_entry entry;
+    uint8_t ioApicId;
+    uint8_t _reserved;
+    uint32_t address;
+    uint32_t gsiBase;
+} __attribute__((packed)) acpi_madt_io_apic;
+
+/// @brief ACPI_MADT_INTERRUPT_OVERRIDE entry
+typedef struct
+{
+    acpi_madt_entry entry;
+    uint8_t bus;
+    uint8_t source;
+    uint32_t gsi;
+    uint16_t flags;
+} __attribute__((packed)) acpi_madt_override;
+
+/// @brief ACPI_MADT_LOCAL_APIC_OVERRIDE entry
+typedef struct
+{
+    acpi_madt_entry entry;
+    uint16_t _reserved;
+    uint64_t address;
+} __attribute__((packed)) acpi_madt_local_apic_override;
+
+/// @brief ACPI_MADT_LOCAL_X2APIC entry
+typedef struct
+{
+    acpi_madt_entry entry;
+    uint16_t _reserved;
+    uint32_t x2apicId;
+    uint32_t flags;
+    uint32_t processorUid;
+} __attribute__((packed)) acpi_madt_local_x2apic;
+
+/// @brief ACPI_MADT_LOCAL_APIC entry
+typedef struct
+{
+    acpi_madt_entry entry;
+    uint8_t processorId;
+    uint8_t apicId;
+    uint32_t flags;
+} __attribute__((packed)) acpi_madt_local_apic;
+
+#define ACPI_MADT_APIC_ENABLED          (1 << 0)
+#define ACPI_MADT_APIC_ONLINE_CAPABLE   (1 << 1)
+
+/// @brief One PCI segment group in the MCFG
+typedef struct
+{
+    uint64_t base;
+    uint16_t segment;
+    uint8_t startBus;
+    uint8_t endBus;
+    uint32_t _reserved;
+} __attribute__((packed)) acpi_mcfg_entry;
+
+/// @brief PCI Express memory mapped configuration table
+typedef struct
+{
+    acpi_header header;
+    uint64_t _reserved;
+    // followed by acpi_mcfg_entry
+} __attribute__((packed)) acpi_mcfg;
+
+/// @brief Generic address structure
+typedef struct
+{
+    uint8_t addressSpace;
+    uint8_t bitWidth;
+    uint8_t bitOffset;
+    uint8_t accessSize;
+    uint64_t address;
+} __attribute__((packed)) acpi_address;
+
+/// @brief High Precision Event Timer table
+typedef struct
+{
+    acpi_header header;
+    uint32_t eventTimerBlockId;
+    acpi_address address;
+    uint8_t hpetNumber;
+    uint16_t minimumTick;
+    uint8_t pageProtection;
+} __attribute__((packed)) acpi_hpet;
+
+/// @brief System Resource Affinity Table
+typedef struct
+{
+    acpi_header header;
+    uint32_t _reserved;
+    uint64_t _reserved2;
+    // followed by variable length entries shaped like acpi_madt_entry
+} __attribute__((packed)) acpi_srat;
+
+enum acpi_srat_type
+{
+    ACPI_SRAT_PROCESSOR         = 0,
+    ACPI_SRAT_MEMORY            = 1,
+    ACPI_SRAT_X2APIC            = 2,
+};
+
+/// @brief ACPI_SRAT_PROCESSOR entry
+typedef struct
+{
+    acpi_madt_entry entry;
+    uint8_t proximityLow;
+    uint8_t apicId;
+    uint32_t flags;
+    uint8_t sapicEid;
+    uint8_t proximityHigh[3];
+    uint32_t clockDomain;
+} __attribute__((packed)) acpi_srat_processor;
+
+/// @brief ACPI_SRAT_MEMORY entry
+typedef struct
+{
+    acpi_madt_entry entry;
+    uint32_t proximity;
+    uint16_t _reserved;
+    uint64_t base;
+    uint64_t length;
+    uint32_t _reserved2;
+    uint32_t flags;
+    uint64_t _reserved3;
+} __attribute__((packed)) acpi_srat_memory;
+
+/// @brief ACPI_SRAT_X2APIC entry
+typedef struct
+{
+    acpi_madt_entry entry;
+    uint16_t _reserved;
+    uint32_t proximity;
+    uint32_t x2apicId;
+    uint32_t flags;
+    uint32_t clockDomain;
+    uint32_t _reserved2;
+} __attribute__((packed)) acpi_srat_x2apic;
+
+/// @brief SRAT entries only count with this flag
+#define ACPI_SRAT_ENABLED           (1 << 0)
+
+/// @brief FADT offsets of the DSDT pointers
+#define ACPI_FADT_DSDT              36
+#define ACPI_FADT_X_DSDT            140
+
+/// @brief A validated table in the index
+typedef struct
+{
+    char signature[4];
+    uint32_t length;
+    uint64_t address;
+} __attribute__((packed)) acpi_table;
+
+/// @brief A processor from the MADT
+typedef struct
+{
+    uint32_t apicId;
+    uint32_t processorUid;
+    /// @brief SRAT proximity domain, ACPI_PROXIMITY_NONE without one
+    uint32_t proximity;
+    /// @brief ACPI_MADT_APIC_* and ACPI_CPU_X2APIC
+    uint32_t flags;
+} __attribute__((packed)) acpi_cpu;
+
+/// @brief The cpu came from an x2APIC entry, its id may not fit an xAPIC
+#define ACPI_CPU_X2APIC             (1u << 31)
+#define ACPI_PROXIMITY_NONE         0xFFFFFFFF
+
+/// @brief An I/O APIC from the MADT
+typedef struct
+{
+    uint32_t id;
+    uint32_t gsiBase;
+    uint64_t address;
+} __attribute__((packed)) acpi_io_apic;
+
+/// @brief An ISA interrupt routed elsewhere, from the MADT
+typedef struct
+{
+    uint8_t bus;
+    uint8_t source;
+    /// @brief MPS polarity and trigger mode
+    uint16_t flags;
+    uint32_t gsi;
+} __attribute__((packed)) acpi_override;
+
+/// @brief A memory range and its proximity domain, from the SRAT
+typedef struct
+{
+    uint64_t base;
+    uint64_t length;
+    uint32_t proximity;
+    uint32_t flags;
+} __attribute__((packed)) acpi_memory_affinity;
+
+/**
+ * @brief Everything stage2 pulls out of the tables
+ * @details Filled once by acpi_init. Lists longer than their arrays are
+ * cut off at ACPI_MAX_*.
+ */
+typedef struct
+{
+    /// @brief from the MADT, replaced by a 64-bit override entry
+    uint64_t localApicAddress;
+    uint32_t madtFlags;
+    uint32_t cpuCount;
+    uint32_t ioApicCount;
+    uint32_t overrideCount;
+    uint32_t ecamCount;
+    uint32_t memoryAffinityCount;
+    uint32_t tableCount;
+    uint32_t _reserved;
+
+    /// @brief HPET registers, 0 without an HPET table
+    uint64_t hpetAddress;
+    uint32_t hpetBlockId;
+    uint16_t hpetMinimumTick;
+    uint8_t hpetNumber;
+    uint8_t _reserved2;
+
+    acpi_cpu cpus[ACPI_MAX_CPUS];
+    acpi_io_apic ioApics[ACPI_MAX_IO_APICS];
+    acpi_override overrides[ACPI_MAX_OVERRIDES];
+    acpi_mcfg_entry ecam[ACPI_MAX_ECAM];
+    acpi_memory_affinity memoryAffinity[ACPI_MAX_MEMORY_AFFINITY];
+    /// @brief the XSDT/RSDT entries that passed their checksum, and the DSDT
+    acpi_table tables[ACPI_MAX_TABLES];
+} __attribute__((packed)) acpi_system;
+
+/**
+ * @brief Finds the RSDP in the EBDA or the BIOS area and the root table it
+ * points to
+ * @details Every table the root lists is checked once and indexed by
+ * signature, then the MADT, MCFG, HPET and SRAT are summarized into
+ * acpi_get_system().
+ *
+ * @return true ACPI is available
+ * @return false no valid RSDP was found
+ */
+bool acpi_init();
+
+/**
+ * @brief The RSDP found by acpi_init
+ *
+ * @return const acpi_rsdp* the RSDP, NULL without ACPI
+ */
+const acpi_rsdp* acpi_get_rsdp();
+
+/**
+ * @brief The tables summarized by acpi_init
+ *
+ * @return const acpi_system* the summary, all counts 0 without ACPI
+ */
+const acpi_system* acpi_get_system();
+
+/**
+ * @brief Finds a table in the index
+ * @details Tables above the identity map were mapped by acpi_init.
+ *
+ * @param[in] signature four character table signature
+ * @param[in] index which match to return when a signature appears more than once
+ * @return const acpi_header* the table, NULL if missing or its checksum is bad
+ */
+const acpi_header* acpi_find_table(const char* signature, uint32_t index = 0);
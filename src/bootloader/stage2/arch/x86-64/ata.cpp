@@ -11,8 +11,12 @@
 
 #include "ata.h"
 #include "io.h"
+#include "wait.h"
 #include "../../memory/memory.h"
 
+/// @brief longest a sector may take to become ready, the drive is already spun up by the BIOS
+#define ATA_SECTOR_TIMEOUT_US 2000000
+
 static IDENTIFY_RETURN identifyReturn;
 
 void ATA_IDENTIFY_PRIMARY()
@@ -73,7 +77,16 @@ void ATA_IDENTIFY_PRIMARY()
     memcpy(&identifyReturn, (void *)buffer, 512);
 }
 
-bool ATA_READ_PRIMARY(void *buffer, uint8_t sectorCount, uint32_t LBA)
+const IDENTIFY_RETURN* ATA_IDENTIFY_DATA()
+{
+    return &identifyReturn;
+}
+
+/*
+ * Selects the master drive in LBA mode and issues command for sectorCount
+ * sectors from LBA on.
+ */
+static void ata_command(uint8_t command, uint8_t sectorCount, uint32_t LBA)
 {
     // set drive
     DriveHeadRegister drive;
@@ -92,46 +105,93 @@ bool ATA_READ_PRIMARY(void *buffer, uint8_t sectorCount, uint32_t LBA)
     outb(ATA_PRIMARY_RW_LBA1, LBA >> 8);
     outb(ATA_PRIMARY_RW_LBA2, LBA >> 16);
 
-    outb(ATA_PRIMARY_W_COMMAND, ATA_CMD_READ_PIO);
-
-    // make sure that err and df are properly cleared
-    inb(ATA_PRIMARY_R_STATUS);
-    inb(ATA_PRIMARY_R_STATUS);
-    inb(ATA_PRIMARY_R_STATUS);
-    inb(ATA_PRIMARY_R_STATUS);
+    outb(ATA_PRIMARY_W_COMMAND, command);
+}
 
-    uint8_t status = inb(ATA_PRIMARY_R_STATUS);
+/*
+ * Waits for BSY to drop, and for DRQ too when data is to be moved.
+ * False on ERR, DF or when the drive takes too long.
+ */
+static bool ata_wait(bool dataRequest)
+{
+    // 400ns for the status register to catch up with the last command or sector
+    inb(ATA_PRIMARY_R_ALT_STATUS);
+    inb(ATA_PRIMARY_R_ALT_STATUS);
+    inb(ATA_PRIMARY_R_ALT_STATUS);
+    inb(ATA_PRIMARY_R_ALT_STATUS);
 
-read_loop:
+    uint64_t deadline = wait_deadline(ATA_SECTOR_TIMEOUT_US);
+    wait_backoff backoff = {0};
 
-    while (true) {
-        if ((status & 0x80) == 0){
-            if ((status & 0x8) == 8){
-                break;
-            }
-        }
-        if (status & 0x1 != 0){
+    uint8_t status = inb(ATA_PRIMARY_R_STATUS);
+    while ((status & ATA_STATUS_BSY) || (dataRequest && !(status & ATA_STATUS_DRQ)))
+    {
+        // ERR and DF are only meaningful once BSY has dropped
+        if (!(status & ATA_STATUS_BSY) && (status & (ATA_STATUS_ERR | ATA_STATUS_DF)))
+        {
             return false;
         }
-        if (status & 0x20 != 0){
+
+        if (wait_expired(deadline))
+        {
             return false;
         }
 
+        // a port can't be monitored, and each read may be a VM exit
+        wait_pause(&backoff);
         status = inb(ATA_PRIMARY_R_STATUS);
     }
 
-    for(int i = 0; i < 256; i++){
-        uint16_t word = inw(ATA_PRIMARY_RW_DATA);
-        memcpy(buffer, &word, 2);
-        buffer = static_cast<uint8_t*>(buffer) + 2;
-    }
+    return !(status & (ATA_STATUS_ERR | ATA_STATUS_DF));
+}
 
-    sectorCount -= 1;
+bool ATA_READ_PRIMARY(void *buffer, uint8_t sectorCount, uint32_t LBA)
+{
+    ata_command(ATA_CMD_READ_PIO, sectorCount, LBA);
 
-    if (sectorCount != 0) {
-        goto read_loop;
-    }
+    uint16_t *words = static_cast<uint16_t *>(buffer);
+
+    do
+    {
+        if (!ata_wait(true))
+        {
+            return false;
+        }
+
+        for (int i = 0; i < 256; i++)
+        {
+            *words++ = inw(ATA_PRIMARY_RW_DATA);
+        }
+    } while (--sectorCount != 0);
 
     return true;
+}
+
+bool ATA_WRITE_PRIMARY(const void *buffer, uint8_t sectorCount, uint32_t LBA)
+{
+    ata_command(ATA_CMD_WRITE_PIO, sectorCount, LBA);
+
+    const uint16_t *words = static_cast<const uint16_t *>(buffer);
+
+    do
+    {
+        if (!ata_wait(true))
+        {
+            return false;
+        }
+
+        for (int i = 0; i < 256; i++)
+        {
+            outw(ATA_PRIMARY_RW_DATA, *words++);
+        }
+    } while (--sectorCount != 0);
+
+    // the last sector is only taken once BSY drops, then the write cache goes to the media
+    if (!ata_wait(false))
+    {
+        return false;
+    }
 
+    outb(ATA_PRIMARY_W_COMMAND, ATA_CMD_CACHE_FLUSH);
+    return ata_wait(false);
 }
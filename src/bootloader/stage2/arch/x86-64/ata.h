@@ -44,6 +44,11 @@ typedef struct {
 #define ATA_ERROR_UNC               1 << 6
 #define ATA_ERROR_BBK               1 << 7
 
+#define ATA_STATUS_ERR              (1 << 0)
+#define ATA_STATUS_DRQ              (1 << 3)
+#define ATA_STATUS_DF               (1 << 5)
+#define ATA_STATUS_BSY              (1 << 7)
+
 #define ATA_CMD_READ_PIO            0x20
 #define ATA_CMD_READ_PIO_EXT        0x24
 #define ATA_CMD_READ_DMA            0xC8
@@ -86,6 +91,13 @@ typedef struct {
  */
 void ATA_IDENTIFY_PRIMARY();
 
+/**
+ * @brief Data returned by the last ATA_IDENTIFY_PRIMARY
+ *
+ * @return const IDENTIFY_RETURN* identify block (zeroed if identify failed)
+ */
+const IDENTIFY_RETURN* ATA_IDENTIFY_DATA();
+
 /**
  * @brief Reads from the primary disk into buffer
  * 
@@ -95,4 +107,15 @@ void ATA_IDENTIFY_PRIMARY();
  * @return true Sucsses 
  * @return false Failed
  */
-bool ATA_READ_PRIMARY(void *buffer, uint8_t sectorCount, uint32_t LBA);
\ No newline at end of file
+bool ATA_READ_PRIMARY(void *buffer, uint8_t sectorCount, uint32_t LBA);
+
+/**
+ * @brief Writes buffer to the primary disk and flushes the drive's write cache
+ * 
+ * @param[in] buffer Buffer to write from. must be 512 bytes per sector
+ * @param[in] sectorCount number of sectors to write
+ * @param[in] LBA LBA to write to starting with 0
+ * @return true Sucsses 
+ * @return false Failed
+ */
+bool ATA_WRITE_PRIMARY(const void *buffer, uint8_t sectorCount, uint32_t LBA);
\ No newline at end of file
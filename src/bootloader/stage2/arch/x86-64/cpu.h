@@ -0,0 +1,187 @@
+/**
+ * @file cpu.h
+ * @author Aidcraft
+ * @brief small wrappers around privileged x86-64 instructions
+ * @version 0.0.2
+ * @date 2025-03-08
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#pragma once
+
+#include "../../stdint.h"
+
+#define MSR_IA32_APIC_BASE      0x1B
+#define MSR_IA32_PAT            0x277
+#define MSR_IA32_EFER           0xC0000080
+
+#define EFER_LMA                (1 << 10)
+#define EFER_NXE                (1 << 11)
+
+/// @brief CR0 - not write-through (cleared together with CD)
+#define CR0_NW                  (1 << 29)
+/// @brief CR0 - cache disable
+#define CR0_CD                  (1 << 30)
+/// @brief CR4 - global pages
+#define CR4_PGE                 (1 << 7)
+
+/// @brief IA32_APIC_BASE - x2APIC mode enabled
+#define APIC_BASE_X2APIC        (1 << 10)
+/// @brief IA32_APIC_BASE - APIC globally enabled
+#define APIC_BASE_ENABLE        (1 << 11)
+
+/// @brief CPUID.01h:EDX - Page Attribute Table
+#define CPUID_01_EDX_PAT        (1 << 16)
+/// @brief CPUID.01h:EDX - on-chip local APIC
+#define CPUID_01_EDX_APIC       (1 << 9)
+/// @brief CPUID.01h:ECX - SSE4.2 (crc32 instruction)
+#define CPUID_01_ECX_SSE42      (1 << 20)
+/// @brief CPUID.01h:ECX - MONITOR/MWAIT
+#define CPUID_01_ECX_MONITOR    (1 << 3)
+/// @brief CPUID.07h:ECX - UMONITOR/UMWAIT/TPAUSE
+#define CPUID_07_ECX_WAITPKG    (1 << 5)
+/// @brief CPUID.80000001h:EDX - Execute Disable
+#define CPUID_80000001_EDX_NX   (1 << 20)
+
+/// @brief Registers returned by cpuid
+typedef struct {
+    uint32_t eax;
+    uint32_t ebx;
+    uint32_t ecx;
+    uint32_t edx;
+} cpuid_regs;
+
+/**
+ * @brief Executes cpuid for a leaf/subleaf pair
+ *
+ * @param[in] leaf value loaded into eax
+ * @param[in] subleaf value loaded into ecx
+ * @return cpuid_regs the registers returned by the cpu
+ */
+static inline cpuid_regs cpuid(uint32_t leaf, uint32_t subleaf = 0)
+{
+    cpuid_regs regs;
+    asm volatile("cpuid"
+                 : "=a"(regs.eax), "=b"(regs.ebx), "=c"(regs.ecx), "=d"(regs.edx)
+                 : "a"(leaf), "c"(subleaf));
+    return regs;
+}
+
+/// @brief Highest extended cpuid leaf supported
+static inline uint32_t cpuid_max_extended()
+{
+    return cpuid(0x80000000).eax;
+}
+
+static inline uint64_t rdmsr(uint32_t msr)
+{
+    uint32_t low, high;
+    asm volatile("rdmsr" : "=a"(low), "=d"(high) : "c"(msr));
+    return ((uint64_t)high << 32) | low;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value)
+{
+    asm volatile("wrmsr" :: "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+/// @brief Invalidates the TLB entry for a single virtual address
+static inline void invlpg(uint64_t virt)
+{
+    asm volatile("invlpg (%0)" :: "r"(virt) : "memory");
+}
+
+/// @brief Writes back and invalidates all caches
+static inline void wbinvd()
+{
+    asm volatile("wbinvd" ::: "memory");
+}
+
+/// @brief Reads the time stamp counter
+static inline uint64_t rdtsc()
+{
+    uint32_t low, high;
+    asm volatile("rdtsc" : "=a"(low), "=d"(high));
+    return ((uint64_t)high << 32) | low;
+}
+
+/// @brief Spin loop hint
+static inline void pause()
+{
+    asm volatile("pause" ::: "memory");
+}
+
+/// @brief Arms address monitoring on the cache line holding address
+static inline void monitor(const volatile void* address)
+{
+    asm volatile("monitor" :: "a"(address), "c"(0), "d"(0));
+}
+
+/// @brief Sleeps until the monitored line is written or an interrupt arrives
+static inline void mwait()
+{
+    asm volatile("mwait" :: "a"(0), "c"(0) : "memory");
+}
+
+/// @brief UMONITOR counterpart of monitor()
+static inline void umonitor(const volatile void* address)
+{
+    asm volatile("umonitor %0" :: "r"(address));
+}
+
+/**
+ * @brief Light sleep until the monitored line is written or the TSC passes deadline
+ * @details Uses C0.1, the state with the faster wakeup.
+ */
+static inline void umwait(uint64_t deadline)
+{
+    asm volatile("umwait %0" :: "r"(1), "a"((uint32_t)deadline), "d"((uint32_t)(deadline >> 32)) : "memory", "cc");
+}
+
+static inline uint64_t read_cr0()
+{
+    uint64_t value;
+    asm volatile("mov %%cr0, %0" : "=r"(value));
+    return value;
+}
+
+static inline void write_cr0(uint64_t value)
+{
+    asm volatile("mov %0, %%cr0" :: "r"(value) : "memory");
+}
+
+static inline uint64_t read_cr3()
+{
+    uint64_t value;
+    asm volatile("mov %%cr3, %0" : "=r"(value));
+    return value;
+}
+
+static inline uint64_t read_cr4()
+{
+    uint64_t value;
+    asm volatile("mov %%cr4, %0" : "=r"(value));
+    return value;
+}
+
+static inline void write_cr4(uint64_t value)
+{
+    asm volatile("mov %0, %%cr4" :: "r"(value) : "memory");
+}
+
+/// @brief Flushes the whole TLB, global pages included
+static inline void flush_tlb()
+{
+    uint64_t cr4 = read_cr4();
+    if (cr4 & CR4_PGE)
+    {
+        write_cr4(cr4 & ~(uint64_t)CR4_PGE);
+        write_cr4(cr4);
+    }
+    else
+        asm volatile("mov %%cr3, %%rax; mov %%rax, %%cr3" ::: "rax", "memory");
+}
@@ -57,4 +57,8 @@ void idt_init() {
 
     __asm__ volatile ("lidt %0" : : "m"(idtr)); // load the new IDT
     __asm__ volatile ("sti"); // set the interrupt flag
+}
+
+void idt_load() {
+    __asm__ volatile ("lidt %0" : : "m"(idtr));
 }
\ No newline at end of file
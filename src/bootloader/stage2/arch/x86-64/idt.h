@@ -45,4 +45,7 @@ extern "C" void __attribute__((noreturn)) exception_handler();
 void idt_set_descriptor(uint8_t vector, void* isr, uint8_t flags);
 
 /// @brief loads the idt stub table and the idt itself
-void idt_init();
\ No newline at end of file
+void idt_init();
+
+/// @brief loads the already built idt on the calling cpu, interrupts stay off
+void idt_load();
\ No newline at end of file
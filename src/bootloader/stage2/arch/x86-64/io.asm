@@ -6,6 +6,11 @@ global outb
 global inw
 global outw
 
+global inl
+global outl
+
+global outsb
+
 section .text
 
     inb:
@@ -31,3 +36,22 @@ section .text
         mov rax, rsi
         out dx, ax
         ret
+
+    inl:
+        xor rax, rax
+        mov rdx, rdi
+        in eax, dx
+        ret
+
+    outl:
+        mov rdx, rdi
+        mov rax, rsi
+        out dx, eax
+        ret
+
+    outsb:
+        mov rcx, rdx
+        mov rdx, rdi
+        cld
+        rep outsb
+        ret
@@ -4,4 +4,10 @@ extern "C" uint8_t inb(uint16_t port);
 extern "C" void outb(uint16_t port, uint8_t data);
 
 extern "C" uint16_t inw(uint16_t port);
-extern "C" void outw(uint16_t port, uint16_t data);
\ No newline at end of file
+extern "C" void outw(uint16_t port, uint16_t data);
+
+extern "C" uint32_t inl(uint16_t port);
+extern "C" void outl(uint16_t port, uint32_t data);
+
+/// @brief Writes count bytes from data to port with a single rep outsb
+extern "C" void outsb(uint16_t port, const void* data, uint64_t count);
\ No newline at end of file
@@ -0,0 +1,376 @@
+/**
+ * @file pci.cpp
+ * @author Aidcraft
+ * @brief PCI bus enumeration and configuration space access
+ * @version 0.0.2
+ * @date 2025-03-22
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#include "pci.h"
+#include "acpi.h"
+#include "io.h"
+#include "../../stddef.h"
+#include "../../memory/memory.h"
+#include "../../memory/paging.h"
+
+#define PCI_SLOTS           32
+#define PCI_FUNCTIONS       8
+#define PCI_VENDOR_NONE     0xFFFF
+#define PCI_PORT_ENABLE     0x80000000
+/// @brief Port I/O only reaches the legacy 256 bytes of each function
+#define PCI_PORT_LIMIT      0x100
+/// @brief Capabilities live past the standard header
+#define PCI_CAPABILITY_MIN  0x40
+/// @brief Bound on the capability walk, a looping list would hang otherwise
+#define PCI_CAPABILITY_LOOP 48
+
+/// @brief Bytes of ECAM space per bus, function and so on
+#define ECAM_BUS_SHIFT      20
+#define ECAM_SLOT_SHIFT     15
+#define ECAM_FUNCTION_SHIFT 12
+
+static pci_device devices[PCI_MAX_DEVICES];
+static uint16_t deviceCount;
+static const acpi_system* acpi;
+
+/*
+ * Address of a register in the ECAM window covering its bus, NULL when no
+ * window does. The MCFG base is where bus 0 would be even when the window
+ * starts at a later bus.
+ */
+static volatile uint32_t* ecam_address(uint16_t segment, uint8_t bus, uint8_t slot, uint8_t function, uint16_t offset)
+{
+    for (uint32_t i = 0; i < acpi->ecamCount; i++)
+    {
+        const acpi_mcfg_entry* window = &acpi->ecam[i];
+        if (window->segment != segment || bus < window->startBus || bus > window->endBus)
+            continue;
+
+        return (volatile uint32_t*)(window->base + ((uint64_t)bus << ECAM_BUS_SHIFT) +
+                                    ((uint64_t)slot << ECAM_SLOT_SHIFT) +
+                                    ((uint64_t)function << ECAM_FUNCTION_SHIFT) + offset);
+    }
+    return NULL;
+}
+
+static uint32_t port_address(uint8_t bus, uint8_t slot, uint8_t function, uint16_t offset)
+{
+    return PCI_PORT_ENABLE | (uint32_t)bus << 16 | (uint32_t)slot << 11 | (uint32_t)function << 8 | (offset & 0xFC);
+}
+
+static uint32_t config_read(uint16_t segment, uint8_t bus, uint8_t slot, uint8_t function, uint16_t offset)
+{
+    volatile uint32_t* ecam = ecam_address(segment, bus, slot, function, offset);
+    if (ecam != NULL)
+        return *ecam;
+
+    if (segment != 0 || offset >= PCI_PORT_LIMIT)
+        return 0xFFFFFFFF;
+    outl(PCI_CONFIG_ADDRESS, port_address(bus, slot, function, offset));
+    return inl(PCI_CONFIG_DATA);
+}
+
+static void config_write(uint16_t segment, uint8_t bus, uint8_t slot, uint8_t function, uint16_t offset, uint32_t value)
+{
+    volatile uint32_t* ecam = ecam_address(segment, bus, slot, function, offset);
+    if (ecam != NULL)
+    {
+        *ecam = value;
+        return;
+    }
+
+    if (segment != 0 || offset >= PCI_PORT_LIMIT)
+        return;
+    outl(PCI_CONFIG_ADDRESS, port_address(bus, slot, function, offset));
+    outl(PCI_CONFIG_DATA, value);
+}
+
+uint32_t pci_read(const pci_device* device, uint16_t offset)
+{
+    return config_read(device->segment, device->bus, device->slot, device->function, offset);
+}
+
+void pci_write(const pci_device* device, uint16_t offset, uint32_t value)
+{
+    config_write(device->segment, device->bus, device->slot, device->function, offset, value);
+}
+
+static uint8_t size_shift(uint64_t size)
+{
+    uint8_t shift = 0;
+    while (shift < 63 && ((uint64_t)1 << shift) < size)
+        shift++;
+    return shift;
+}
+
+/*
+ * Size the BARs by writing all ones and reading back which bits stick.
+ * Decoding is switched off meanwhile so the device doesn't claim the
+ * addresses the probe passes through. Only the command half is written
+ * back, writing the status half would clear its error bits.
+ */
+static void read_bars(pci_device* device, uint8_t count)
+{
+    uint32_t command = pci_read(device, PCI_REG_COMMAND) & 0xFFFF;
+    pci_write(device, PCI_REG_COMMAND, command & ~(PCI_COMMAND_IO | PCI_COMMAND_MEMORY));
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        uint16_t reg = PCI_REG_BAR0 + i * 4;
+        uint32_t low = pci_read(device, reg);
+        pci_write(device, reg, 0xFFFFFFFF);
+        uint32_t mask = pci_read(device, reg);
+        pci_write(device, reg, low);
+
+        pci_bar* bar = &device->bars[i];
+        uint64_t size;
+        if (low & 1)
+        {
+            // some I/O BARs only implement the low 16 bits
+            mask = (mask & ~3u) | 0xFFFF0000;
+            bar->base = low & ~3u;
+            bar->flags = PCI_BAR_IO;
+            size = (uint32_t)~mask + 1;
+        }
+        else
+        {
+            bar->base = low & ~0xFu;
+            bar->flags = (low & 0x8) ? PCI_BAR_PREFETCH : 0;
+            uint64_t fullMask = 0xFFFFFFFF00000000 | (mask & ~0xFu);
+
+            if (((low >> 1) & 3) == 2 && i + 1 < count)
+            {
+                uint32_t high = pci_read(device, reg + 4);
+                pci_write(device, reg + 4, 0xFFFFFFFF);
+                uint32_t highMask = pci_read(device, reg + 4);
+                pci_write(device, reg + 4, high);
+
+                bar->base |= (uint64_t)high << 32;
+                bar->flags |= PCI_BAR_64;
+                fullMask = (uint64_t)highMask << 32 | (mask & ~0xFu);
+                i++;
+            }
+            size = ~fullMask + 1;
+        }
+
+        if ((mask & ~0xFu) == 0 || size == 0)
+        {
+            // not implemented
+            bar->base = 0;
+            bar->flags = 0;
+            continue;
+        }
+        bar->sizeShift = size_shift(size);
+    }
+
+    pci_write(device, PCI_REG_COMMAND, command);
+}
+
+static void read_capabilities(pci_device* device)
+{
+    if (!(pci_read(device, PCI_REG_COMMAND) & PCI_STATUS_CAPABILITIES))
+        return;
+
+    uint8_t offset = pci_read(device, PCI_REG_CAPABILITIES) & 0xFC;
+    for (uint8_t walked = 0; offset >= PCI_CAPABILITY_MIN && walked < PCI_CAPABILITY_LOOP; walked++)
+    {
+        uint32_t value = pci_read(device, offset);
+        if (device->capabilityCount < PCI_MAX_CAPABILITIES)
+        {
+            pci_capability* capability = &device->capabilities[device->capabilityCount++];
+            capability->id = value & 0xFF;
+            capability->offset = offset;
+        }
+        offset = (value >> 8) & 0xFC;
+    }
+}
+
+/*
+ * Register BARs are mapped uncached for the drivers. Prefetchable ones are
+ * apertures such as the framebuffer, which has its own write-combining
+ * mapping and can be far too large for the page table pool.
+ */
+static void map_bars(const pci_device* device)
+{
+    for (uint8_t i = 0; i < PCI_MAX_BARS; i++)
+    {
+        const pci_bar* bar = &device->bars[i];
+        if (bar->base == 0 || (bar->flags & (PCI_BAR_IO | PCI_BAR_PREFETCH)))
+            continue;
+        page_mmio(bar->base, (uint64_t)1 << bar->sizeShift);
+    }
+}
+
+static void add_device(uint16_t segment, uint8_t bus, uint8_t slot, uint8_t function, uint32_t id, uint8_t headerType)
+{
+    if (deviceCount >= PCI_MAX_DEVICES)
+        return;
+
+    pci_device* device = &devices[deviceCount++];
+    memset(device, 0, sizeof(pci_device));
+    device->segment = segment;
+    device->bus = bus;
+    device->slot = slot;
+    device->function = function;
+    device->headerType = headerType;
+    device->vendorId = id & 0xFFFF;
+    device->deviceId = id >> 16;
+
+    uint32_t classes = pci_read(device, PCI_REG_CLASS);
+    device->revision = classes & 0xFF;
+    device->progIf = (classes >> 8) & 0xFF;
+    device->subclass = (classes >> 16) & 0xFF;
+    device->classCode = classes >> 24;
+
+    uint32_t interrupt = pci_read(device, PCI_REG_INTERRUPT);
+    device->interruptLine = interrupt & 0xFF;
+    device->interruptPin = (interrupt >> 8) & 0xFF;
+
+    // bridges only have two BARs, CardBus bridges none
+    if (headerType == PCI_HEADER_DEVICE)
+        read_bars(device, PCI_MAX_BARS);
+    else if (headerType == PCI_HEADER_BRIDGE)
+        read_bars(device, 2);
+    else
+        return;
+
+    read_capabilities(device);
+    map_bars(device);
+}
+
+static void scan_bus(uint16_t segment, uint8_t bus);
+
+static void scan_function(uint16_t segment, uint8_t bus, uint8_t slot, uint8_t function)
+{
+    uint32_t id = config_read(segment, bus, slot, function, PCI_REG_VENDOR);
+    if ((id & 0xFFFF) == PCI_VENDOR_NONE)
+        return;
+
+    uint8_t headerType = (config_read(segment, bus, slot, function, PCI_REG_HEADER) >> 16) & PCI_HEADER_TYPE_MASK;
+    add_device(segment, bus, slot, function, id, headerType);
+
+    if (headerType != PCI_HEADER_BRIDGE)
+        return;
+
+    // bus numbers grow away from the root, anything else is misconfigured and could loop
+    uint8_t secondary = (config_read(segment, bus, slot, function, PCI_REG_BUSES) >> 8) & 0xFF;
+    if (secondary > bus)
+        scan_bus(segment, secondary);
+}
+
+static void scan_slot(uint16_t segment, uint8_t bus, uint8_t slot)
+{
+    if ((config_read(segment, bus, slot, 0, PCI_REG_VENDOR) & 0xFFFF) == PCI_VENDOR_NONE)
+        return;
+
+    uint8_t header = config_read(segment, bus, slot, 0, PCI_REG_HEADER) >> 16;
+    uint8_t functions = (header & PCI_HEADER_MULTIFUNCTION) ? PCI_FUNCTIONS : 1;
+    for (uint8_t function = 0; function < functions; function++)
+        scan_function(segment, bus, slot, function);
+}
+
+static void scan_bus(uint16_t segment, uint8_t bus)
+{
+    for (uint8_t slot = 0; slot < PCI_SLOTS; slot++)
+        scan_slot(segment, bus, slot);
+}
+
+/*
+ * A multi-function host bridge at slot 0 means several host controllers,
+ * function n owning bus n past the root.
+ */
+static void scan_root(uint16_t segment, uint8_t bus)
+{
+    uint8_t header = config_read(segment, bus, 0, 0, PCI_REG_HEADER) >> 16;
+    if (!(header & PCI_HEADER_MULTIFUNCTION))
+    {
+        scan_bus(segment, bus);
+        return;
+    }
+
+    for (uint8_t function = 0; function < PCI_FUNCTIONS; function++)
+    {
+        if ((config_read(segment, bus, 0, function, PCI_REG_VENDOR) & 0xFFFF) != PCI_VENDOR_NONE)
+            scan_bus(segment, bus + function);
+    }
+}
+
+uint16_t pci_init()
+{
+    acpi = acpi_get_system();
+    deviceCount = 0;
+
+    for (uint32_t i = 0; i < acpi->ecamCount; i++)
+    {
+        const acpi_mcfg_entry* window = &acpi->ecam[i];
+        uint64_t start = window->base + ((uint64_t)window->startBus << ECAM_BUS_SHIFT);
+        page_mmio(start, (uint64_t)(window->endBus - window->startBus + 1) << ECAM_BUS_SHIFT);
+    }
+
+    if (acpi->ecamCount == 0)
+    {
+        scan_root(0, 0);
+        return deviceCount;
+    }
+
+    for (uint32_t i = 0; i < acpi->ecamCount; i++)
+    {
+        // a segment split over several windows is walked from its first one
+        bool seen = false;
+        for (uint32_t j = 0; j < i; j++)
+            seen |= acpi->ecam[j].segment == acpi->ecam[i].segment;
+        if (!seen)
+            scan_root(acpi->ecam[i].segment, acpi->ecam[i].startBus);
+    }
+    return deviceCount;
+}
+
+bool pci_ecam()
+{
+    return acpi != NULL && acpi->ecamCount != 0;
+}
+
+uint16_t pci_device_count()
+{
+    return deviceCount;
+}
+
+const pci_device* pci_get_device(uint16_t index)
+{
+    return index < deviceCount ? &devices[index] : NULL;
+}
+
+const pci_device* pci_find_class(uint8_t classCode, uint8_t subclass, uint16_t index)
+{
+    for (uint16_t i = 0; i < deviceCount; i++)
+    {
+        if (devices[i].classCode == classCode && devices[i].subclass == subclass && index-- == 0)
+            return &devices[i];
+    }
+    return NULL;
+}
+
+const pci_device* pci_find_device(uint16_t vendorId, uint16_t deviceId, uint16_t index)
+{
+    for (uint16_t i = 0; i < deviceCount; i++)
+    {
+        if (devices[i].vendorId == vendorId && devices[i].deviceId == deviceId && index-- == 0)
+            return &devices[i];
+    }
+    return NULL;
+}
+
+uint8_t pci_find_capability(const pci_device* device, uint8_t id)
+{
+    for (uint8_t i = 0; i < device->capabilityCount; i++)
+    {
+        if (device->capabilities[i].id == id)
+            return device->capabilities[i].offset;
+    }
+    return 0;
+}
@@ -0,0 +1,180 @@
+/**
+ * @file pci.h
+ * @author Aidcraft
+ * @brief PCI bus enumeration and configuration space access
+ * @version 0.0.2
+ * @date 2025-03-22
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ * @details Configuration space is read through the ECAM windows the MCFG
+ * lists, which are plain memory accesses, and through ports 0xCF8/0xCFC
+ * when there is no MCFG. The buses are walked once by pci_init, drivers
+ * look their controllers up in the cached list instead of scanning again.
+ */
+
+#pragma once
+
+#include "../../stdint.h"
+
+#define PCI_CONFIG_ADDRESS  0xCF8
+#define PCI_CONFIG_DATA     0xCFC
+
+/// @brief Most functions kept by pci_init
+#define PCI_MAX_DEVICES     32
+#define PCI_MAX_BARS        6
+/// @brief Most capabilities kept per function
+#define PCI_MAX_CAPABILITIES 8
+
+/// @brief Configuration space registers
+#define PCI_REG_VENDOR      0x00
+#define PCI_REG_COMMAND     0x04
+#define PCI_REG_CLASS       0x08
+#define PCI_REG_HEADER      0x0C
+#define PCI_REG_BAR0        0x10
+#define PCI_REG_BUSES       0x18
+#define PCI_REG_CAPABILITIES 0x34
+#define PCI_REG_INTERRUPT   0x3C
+
+#define PCI_COMMAND_IO      (1 << 0)
+#define PCI_COMMAND_MEMORY  (1 << 1)
+#define PCI_COMMAND_MASTER  (1 << 2)
+/// @brief Status bit (upper half of PCI_REG_COMMAND) set when there is a capability list
+#define PCI_STATUS_CAPABILITIES (1 << 20)
+
+#define PCI_HEADER_TYPE_MASK    0x7F
+#define PCI_HEADER_MULTIFUNCTION 0x80
+#define PCI_HEADER_DEVICE       0
+#define PCI_HEADER_BRIDGE       1
+
+#define PCI_CLASS_STORAGE   0x01
+#define PCI_CLASS_BRIDGE    0x06
+#define PCI_SUBCLASS_PCI_BRIDGE 0x04
+
+/// @brief pci_bar::flags
+#define PCI_BAR_IO          (1 << 0)
+#define PCI_BAR_64          (1 << 1)
+#define PCI_BAR_PREFETCH    (1 << 2)
+
+/// @brief A decoded base address register
+typedef struct
+{
+    /// @brief I/O port or physical address, 0 when unused
+    uint64_t base;
+    /// @brief the size is 1 << sizeShift bytes
+    uint8_t sizeShift;
+    uint8_t flags;
+} __attribute__((packed)) pci_bar;
+
+/// @brief A capability in the function's list
+typedef struct
+{
+    uint8_t id;
+    uint8_t offset;
+} __attribute__((packed)) pci_capability;
+
+/// @brief One function found on the bus
+typedef struct
+{
+    uint16_t segment;
+    uint8_t bus;
+    uint8_t slot;
+    uint8_t function;
+    uint8_t headerType;
+
+    uint16_t vendorId;
+    uint16_t deviceId;
+    uint8_t classCode;
+    uint8_t subclass;
+    uint8_t progIf;
+    uint8_t revision;
+
+    uint8_t interruptLine;
+    uint8_t interruptPin;
+    uint8_t capabilityCount;
+    uint8_t _reserved;
+
+    pci_bar bars[PCI_MAX_BARS];
+    pci_capability capabilities[PCI_MAX_CAPABILITIES];
+} __attribute__((packed)) pci_device;
+
+/**
+ * @brief Walks every bus reachable from the host bridges and caches the functions found
+ * @details Needs acpi_init for the ECAM windows. Memory BARs are mapped
+ * uncached as they are found.
+ *
+ * @return uint16_t number of functions cached
+ */
+uint16_t pci_init();
+
+/**
+ * @brief Whether configuration space goes through ECAM
+ *
+ * @return true the MCFG was used
+ * @return false ports 0xCF8/0xCFC are used, registers past 0xFF can't be reached
+ */
+bool pci_ecam();
+
+/**
+ * @brief Number of functions cached by pci_init
+ *
+ * @return uint16_t count
+ */
+uint16_t pci_device_count();
+
+/**
+ * @brief A cached function
+ *
+ * @param[in] index 0 to pci_device_count() - 1
+ * @return const pci_device* the function, NULL past the end
+ */
+const pci_device* pci_get_device(uint16_t index);
+
+/**
+ * @brief Finds a function by class
+ *
+ * @param[in] classCode base class
+ * @param[in] subclass sub class
+ * @param[in] index which match to return
+ * @return const pci_device* the function, NULL if there are fewer matches
+ */
+const pci_device* pci_find_class(uint8_t classCode, uint8_t subclass, uint16_t index = 0);
+
+/**
+ * @brief Finds a function by vendor and device id
+ *
+ * @param[in] vendorId vendor id
+ * @param[in] deviceId device id
+ * @param[in] index which match to return
+ * @return const pci_device* the function, NULL if there are fewer matches
+ */
+const pci_device* pci_find_device(uint16_t vendorId, uint16_t deviceId, uint16_t index = 0);
+
+/**
+ * @brief Offset of a capability in a function's configuration space
+ *
+ * @param[in] device the function
+ * @param[in] id capability id
+ * @return uint8_t offset, 0 if the function doesn't list it
+ */
+uint8_t pci_find_capability(const pci_device* device, uint8_t id);
+
+/**
+ * @brief Reads a configuration register
+ *
+ * @param[in] device the function
+ * @param[in] offset register offset, 4 byte aligned
+ * @return uint32_t register value, all ones when it can't be reached
+ */
+uint32_t pci_read(const pci_device* device, uint16_t offset);
+
+/**
+ * @brief Writes a configuration register
+ *
+ * @param[in] device the function
+ * @param[in] offset register offset, 4 byte aligned
+ * @param[in] value value to write
+ */
+void pci_write(const pci_device* device, uint16_t offset, uint32_t value);
@@ -0,0 +1,46 @@
+/**
+ * @file pit.cpp
+ * @author Aidcraft
+ * @brief busy waits on the programmable interval timer
+ * @version 0.0.2
+ * @date 2025-03-14
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#include "pit.h"
+#include "io.h"
+
+/// @brief longest single countdown, comfortably under 65535 ticks
+#define MAX_CHUNK_US 50000
+
+void pit_wait(uint32_t microseconds)
+{
+    uint8_t portB = inb(PIT_PORT_B);
+
+    while (microseconds != 0)
+    {
+        uint32_t chunk = microseconds > MAX_CHUNK_US ? MAX_CHUNK_US : microseconds;
+        uint32_t ticks = (uint64_t)chunk * PIT_FREQUENCY / 1000000;
+        if (ticks == 0)
+            ticks = 1;
+
+        // gate low while loading the count so it starts cleanly, speaker stays off
+        outb(PIT_PORT_B, portB & ~(PIT_PORT_B_GATE2 | PIT_PORT_B_SPEAKER));
+        outb(PIT_COMMAND, PIT_CHANNEL2_ONESHOT);
+        outb(PIT_CHANNEL2_DATA, ticks & 0xFF);
+        outb(PIT_CHANNEL2_DATA, ticks >> 8);
+        outb(PIT_PORT_B, (portB & ~PIT_PORT_B_SPEAKER) | PIT_PORT_B_GATE2);
+
+        // OUT2 goes high when the count reaches zero
+        while (!(inb(PIT_PORT_B) & PIT_PORT_B_OUT2))
+            ;
+
+        microseconds -= chunk;
+    }
+
+    outb(PIT_PORT_B, portB);
+}
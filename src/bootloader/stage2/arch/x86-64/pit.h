@@ -0,0 +1,38 @@
+/**
+ * @file pit.h
+ * @author Aidcraft
+ * @brief busy waits on the programmable interval timer
+ * @version 0.0.2
+ * @date 2025-03-14
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#pragma once
+
+#include "../../stdint.h"
+
+#define PIT_FREQUENCY       1193182
+
+#define PIT_CHANNEL2_DATA   0x42
+#define PIT_COMMAND         0x43
+/// @brief Keyboard controller port B, gates channel 2 and reads its output
+#define PIT_PORT_B          0x61
+
+#define PIT_PORT_B_GATE2    (1 << 0)
+#define PIT_PORT_B_SPEAKER  (1 << 1)
+#define PIT_PORT_B_OUT2     (1 << 5)
+
+/// @brief Channel 2, low then high byte, mode 0 (interrupt on terminal count)
+#define PIT_CHANNEL2_ONESHOT 0xB0
+
+/**
+ * @brief Waits using PIT channel 2, interrupts are not needed
+ * @details Longer waits are split into counts the 16 bit counter can hold.
+ *
+ * @param[in] microseconds how long to wait
+ */
+void pit_wait(uint32_t microseconds);
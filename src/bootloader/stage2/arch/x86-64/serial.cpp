@@ -0,0 +1,51 @@
+/**
+ * @file serial.cpp
+ * @author Aidcraft
+ * @brief polled 16550 UART output
+ * @version 0.0.2
+ * @date 2025-03-17
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#include "serial.h"
+#include "io.h"
+
+/// @brief Written to the scratch register to see if a UART answers
+#define SERIAL_PROBE 0xA5
+#define SERIAL_SCRATCH 7
+
+bool serial_init(uint16_t port)
+{
+    outb(port + SERIAL_SCRATCH, SERIAL_PROBE);
+    if (inb(port + SERIAL_SCRATCH) != SERIAL_PROBE)
+        return false;
+
+    outb(port + SERIAL_IER, 0);
+    outb(port + SERIAL_LCR, SERIAL_LCR_DLAB);
+    outb(port + SERIAL_DLL, SERIAL_DIVISOR & 0xFF);
+    outb(port + SERIAL_DLH, SERIAL_DIVISOR >> 8);
+    outb(port + SERIAL_LCR, SERIAL_LCR_8N1);
+    outb(port + SERIAL_FCR, SERIAL_FCR_ENABLE);
+    outb(port + SERIAL_MCR, SERIAL_MCR_READY);
+    return true;
+}
+
+void serial_write(uint16_t port, const char* data, uint32_t length)
+{
+    while (length != 0)
+    {
+        while (!(inb(port + SERIAL_LSR) & SERIAL_LSR_THRE))
+            ;
+
+        uint32_t burst = length < SERIAL_FIFO_SIZE ? length : SERIAL_FIFO_SIZE;
+        for (uint32_t i = 0; i < burst; i++)
+            outb(port + SERIAL_DATA, data[i]);
+
+        data += burst;
+        length -= burst;
+    }
+}
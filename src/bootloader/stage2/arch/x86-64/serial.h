@@ -0,0 +1,63 @@
+/**
+ * @file serial.h
+ * @author Aidcraft
+ * @brief polled 16550 UART output
+ * @version 0.0.2
+ * @date 2025-03-17
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#pragma once
+
+#include "../../stdint.h"
+
+#define SERIAL_COM1         0x3F8
+
+/// @brief Register offsets from the base port
+#define SERIAL_DATA         0
+#define SERIAL_IER          1
+/// @brief divisor latch, low and high byte while LCR.DLAB is set
+#define SERIAL_DLL          0
+#define SERIAL_DLH          1
+#define SERIAL_FCR          2
+#define SERIAL_LCR          3
+#define SERIAL_MCR          4
+#define SERIAL_LSR          5
+
+#define SERIAL_LCR_8N1      0x03
+#define SERIAL_LCR_DLAB     0x80
+/// @brief enable and clear both FIFOs, receive trigger at 14 bytes
+#define SERIAL_FCR_ENABLE   0xC7
+/// @brief DTR, RTS and OUT2
+#define SERIAL_MCR_READY    0x0B
+/// @brief transmit holding register (the whole FIFO when enabled) is empty
+#define SERIAL_LSR_THRE     (1 << 5)
+
+/// @brief Bytes a 16550A FIFO takes once THRE is set
+#define SERIAL_FIFO_SIZE    16
+
+/// @brief 115200 baud
+#define SERIAL_DIVISOR      1
+
+/**
+ * @brief Sets up the UART for 8N1 output with the FIFO enabled
+ *
+ * @param[in] port base I/O port
+ * @return bool false when there is no UART at port
+ */
+bool serial_init(uint16_t port);
+
+/**
+ * @brief Writes data, a FIFO load at a time
+ * @details Waits for the FIFO to drain once per 16 bytes instead of
+ * polling the line status for every byte.
+ *
+ * @param[in] port base I/O port
+ * @param[in] data bytes to send
+ * @param[in] length number of bytes
+ */
+void serial_write(uint16_t port, const char* data, uint32_t length);
@@ -0,0 +1,143 @@
+bits 16
+
+global smp_trampoline_start
+global smp_trampoline_end
+global smp_trampoline_params
+
+; Where smp_init copies this code (MEMORY_SMP_TRAMPOLINE_START in memory/memory.h)
+SMP_TRAMPOLINE_BASE     equ 0x92000
+
+; Selectors in the trampoline's own GDT
+SMP_CODE32_SELECTOR     equ 0x08
+SMP_DATA_SELECTOR       equ 0x10
+SMP_CODE64_SELECTOR     equ 0x18
+
+; Address of a trampoline label once copied into place
+%define TRAMPOLINE(label) (SMP_TRAMPOLINE_BASE + (label) - smp_trampoline_start)
+
+section .text
+
+;---------------------------------------------------------------
+; Function: smp_trampoline_start
+;
+; Description:
+;   First code an application processor runs after the startup
+;   IPI, in real mode at CS = SMP_TRAMPOLINE_BASE >> 4. It:
+;     1. Turns the caches back on (INIT leaves CD/NW set).
+;     2. Enters protected mode with the trampoline's GDT.
+;     3. Loads the BSP's CR4, CR3 and EFER from the parameters.
+;     4. Enables paging, which activates long mode.
+;     5. Takes the next free index and the stack that goes with
+;        it, then calls the entry point with the index in EDI.
+;
+;   Only position independent references or TRAMPOLINE() may be
+;   used, the code runs from a copy.
+;---------------------------------------------------------------
+    align 16
+smp_trampoline_start:
+    cli
+    cld
+
+    mov ax, cs
+    mov ds, ax
+
+    o32 lgdt [smp_gdt_desc - smp_trampoline_start]
+
+    mov eax, cr0
+    and eax, ~(1 << 30 | 1 << 29)   ; Clear CD and NW.
+    or eax, 1 << 0                  ; Protection enable.
+    mov cr0, eax
+
+    jmp dword SMP_CODE32_SELECTOR:TRAMPOLINE(.protected)
+
+.protected:
+    bits 32
+    mov ax, SMP_DATA_SELECTOR
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    mov ss, ax
+
+    ; Same paging setup as the BSP.
+    mov eax, [TRAMPOLINE(smp_trampoline_params.cr4)]
+    mov cr4, eax
+    mov eax, [TRAMPOLINE(smp_trampoline_params.cr3)]
+    mov cr3, eax
+
+    ; EFER.LME (and NXE when the BSP uses it).
+    mov ecx, 0xC0000080
+    mov eax, [TRAMPOLINE(smp_trampoline_params.efer)]
+    mov edx, [TRAMPOLINE(smp_trampoline_params.efer) + 4]
+    wrmsr
+
+    mov eax, cr0
+    or eax, 1 << 31                 ; Paging.
+    mov cr0, eax
+
+    jmp SMP_CODE64_SELECTOR:TRAMPOLINE(.long_mode)
+
+.long_mode:
+    bits 64
+    ; Index in arrival order, each index owns one stack.
+    mov eax, 1
+    lock xadd [TRAMPOLINE(smp_trampoline_params.next)], eax
+    mov edi, eax
+
+    inc rax
+    imul rax, [TRAMPOLINE(smp_trampoline_params.stack_size)]
+    add rax, [TRAMPOLINE(smp_trampoline_params.stack_base)]
+    mov rsp, rax
+    xor ebp, ebp
+
+    call [TRAMPOLINE(smp_trampoline_params.entry)]
+
+.halt:
+    cli
+    hlt
+    jmp .halt
+
+    align 8
+smp_gdt:
+    dq 0            ; Null descriptor
+
+    ; 32-bit code segment descriptor (selector 0x8)
+    dw 0xFFFF       ; Limit low
+    dw 0            ; Base low
+    db 0            ; Base middle
+    db 10011010b    ; Access: present, ring 0, code, executable, readable
+    db 11001111b    ; Flags: 4KB granularity, 32-bit
+    db 0            ; Base high
+
+    ; Data segment descriptor (selector 0x10)
+    dw 0xFFFF       ; Limit low
+    dw 0            ; Base low
+    db 0            ; Base middle
+    db 10010010b    ; Access: present, ring 0, data, writable
+    db 11001111b    ; Flags: 4KB granularity, 32-bit
+    db 0            ; Base high
+
+    ; 64-bit code segment descriptor (selector 0x18)
+    dw 0xFFFF       ; Limit low (ignored in 64-bit mode)
+    dw 0            ; Base low (ignored in 64-bit mode)
+    db 0            ; Base middle (ignored in 64-bit mode)
+    db 10011010b    ; Access: present, ring 0, code, executable, readable
+    db 10101111b    ; Flags: long mode enabled
+    db 0            ; Base high (ignored)
+
+smp_gdt_desc:
+    dw smp_gdt_desc - smp_gdt - 1   ; Limit: size of GDT - 1
+    dd TRAMPOLINE(smp_gdt)          ; Base address of the copied GDT
+
+; Filled in by smp_init, layout matches smp_startup_params in smp.h
+    align 8
+smp_trampoline_params:
+    .cr3:           dd 0
+    .cr4:           dd 0
+    .efer:          dq 0
+    .entry:         dq 0
+    .stack_base:    dq 0
+    .stack_size:    dq 0
+    .next:          dd 0
+
+smp_trampoline_end:
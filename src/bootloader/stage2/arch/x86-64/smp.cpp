@@ -0,0 +1,264 @@
+/**
+ * @file smp.cpp
+ * @author Aidcraft
+ * @brief starts the application processors and hands them work
+ * @version 0.0.2
+ * @date 2025-03-14
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#include "smp.h"
+#include "acpi.h"
+#include "cpu.h"
+#include "idt.h"
+#include "pit.h"
+#include "wait.h"
+#include "../../stdio.h"
+#include "../../stddef.h"
+#include "../../memory/paging.h"
+
+#define INIT_DELAY_US       10000
+#define STARTUP_DELAY_US    200
+/// @brief how long to give the APs to check in after the second SIPI
+#define ARRIVAL_TIMEOUT_MS  100
+
+extern "C" uint8_t smp_trampoline_start[];
+extern "C" uint8_t smp_trampoline_end[];
+extern "C" uint8_t smp_trampoline_params[];
+
+static volatile uint8_t* lapic;
+
+/// @brief APIC ids of the processors that were sent a startup IPI
+static uint8_t apIds[SMP_MAX_CPUS - 1];
+static uint32_t apCount;
+
+static volatile uint32_t online;
+static volatile bool stopping;
+/// @brief bumped on every submit and on shutdown, idle cpus sleep on it
+static volatile uint32_t doorbell;
+
+static smp_job* volatile queue[SMP_QUEUE_SIZE];
+static volatile uint32_t queueHead;
+static volatile uint32_t queueTail;
+
+/// @brief job each cpu is currently looking at, smp_wait waits for these to clear
+static smp_job* volatile working[SMP_MAX_CPUS];
+
+static uint32_t lapic_read(uint32_t reg)
+{
+    return *(volatile uint32_t*)(lapic + reg);
+}
+
+static void lapic_write(uint32_t reg, uint32_t value)
+{
+    *(volatile uint32_t*)(lapic + reg) = value;
+}
+
+static void send_ipi(uint8_t apicId, uint32_t command)
+{
+    lapic_write(LAPIC_REG_ESR, 0);
+    lapic_write(LAPIC_REG_ICR_HIGH, (uint32_t)apicId << 24);
+    lapic_write(LAPIC_REG_ICR_LOW, command);
+    while (lapic_read(LAPIC_REG_ICR_LOW) & LAPIC_ICR_PENDING)
+        pause();
+}
+
+/*
+ * Run one part of the oldest job that still has parts left. The job is
+ * published in working[] and then checked to still be queued, so smp_wait
+ * can tell when no cpu can touch it anymore. Returns false when there was
+ * nothing to do.
+ */
+static bool work_once(uint32_t cpu)
+{
+    uint32_t head = __atomic_load_n(&queueHead, __ATOMIC_ACQUIRE);
+    if (head == __atomic_load_n(&queueTail, __ATOMIC_ACQUIRE))
+        return false;
+
+    smp_job* job = queue[head % SMP_QUEUE_SIZE];
+    __atomic_store_n(&working[cpu], job, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&queueHead, __ATOMIC_SEQ_CST) != head)
+    {
+        __atomic_store_n(&working[cpu], (smp_job*)NULL, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    uint32_t part = __atomic_fetch_add(&job->next, 1, __ATOMIC_ACQ_REL);
+    if (part < job->parts)
+    {
+        job->task(job->arg, part);
+        __atomic_fetch_add(&job->finished, 1, __ATOMIC_RELEASE);
+    }
+    else
+    {
+        // everything is handed out, move on to the next job
+        __atomic_compare_exchange_n(&queueHead, &head, head + 1, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+    }
+
+    __atomic_store_n(&working[cpu], (smp_job*)NULL, __ATOMIC_RELEASE);
+    return true;
+}
+
+extern "C" void __attribute__((noreturn)) smp_ap_entry(uint32_t index)
+{
+    paging_init_cpu();
+    idt_load();
+
+    uint32_t cpu = index + 1;
+    __atomic_fetch_add(&online, 1, __ATOMIC_RELEASE);
+
+    while (cpu < SMP_MAX_CPUS)
+    {
+        // the doorbell is read first, a ring after it wakes the wait below at once
+        uint32_t seen = __atomic_load_n(&doorbell, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&stopping, __ATOMIC_SEQ_CST))
+            break;
+        if (!work_once(cpu))
+            wait_change(&doorbell, seen, WAIT_FOREVER);
+    }
+
+    while (1)
+        asm volatile("cli; hlt");
+}
+
+uint32_t smp_init()
+{
+    online = 1;
+    apCount = 0;
+
+    const acpi_system* system = acpi_get_system();
+    if (!(cpuid(1).edx & CPUID_01_EDX_APIC) || acpi_get_rsdp() == NULL)
+        return online;
+
+    uint64_t apicBase = rdmsr(MSR_IA32_APIC_BASE);
+    if (system->cpuCount == 0 || (apicBase & APIC_BASE_X2APIC))
+    {
+        puts("SMP: no MADT or x2APIC mode, staying on one cpu\n");
+        return online;
+    }
+
+    lapic = (volatile uint8_t*)(apicBase & 0xFFFFF000);
+    page((uint64_t)lapic, (uint64_t)lapic, MAP_WRITE | MAP_CACHE_UC);
+    wrmsr(MSR_IA32_APIC_BASE, apicBase | APIC_BASE_ENABLE);
+    lapic_write(LAPIC_REG_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS);
+
+    uint8_t bspId = lapic_read(LAPIC_REG_ID) >> 24;
+
+    // x2APIC entries are for ids the xAPIC ICR can't address, so only local APIC ones are used
+    for (uint32_t i = 0; i < system->cpuCount && apCount < SMP_MAX_CPUS - 1; i++)
+    {
+        const acpi_cpu* cpu = &system->cpus[i];
+        if ((cpu->flags & ACPI_MADT_APIC_ENABLED) && !(cpu->flags & ACPI_CPU_X2APIC) && cpu->apicId != bspId)
+            apIds[apCount++] = cpu->apicId;
+    }
+
+    if (apCount == 0)
+        return online;
+
+    memcpy((void*)MEMORY_SMP_TRAMPOLINE_START, smp_trampoline_start, smp_trampoline_end - smp_trampoline_start);
+
+    smp_startup_params* params = (smp_startup_params*)(MEMORY_SMP_TRAMPOLINE_START +
+                                                       (smp_trampoline_params - smp_trampoline_start));
+    params->cr3 = read_cr3();
+    params->cr4 = read_cr4();
+    params->efer = rdmsr(MSR_IA32_EFER) & ~(uint64_t)EFER_LMA;
+    params->entry = (uint64_t)&smp_ap_entry;
+    params->stackBase = MEMORY_SMP_STACKS_START;
+    params->stackSize = SMP_STACK_SIZE;
+    params->next = 0;
+
+    // INIT, then two startup IPIs; the second is ignored by cpus already running
+    uint32_t vector = MEMORY_SMP_TRAMPOLINE_START >> 12;
+    for (uint32_t i = 0; i < apCount; i++)
+        send_ipi(apIds[i], LAPIC_ICR_INIT | LAPIC_ICR_ASSERT);
+    pit_wait(INIT_DELAY_US);
+
+    for (uint8_t round = 0; round < 2; round++)
+    {
+        for (uint32_t i = 0; i < apCount; i++)
+            send_ipi(apIds[i], LAPIC_ICR_STARTUP | LAPIC_ICR_ASSERT | vector);
+        pit_wait(STARTUP_DELAY_US);
+    }
+
+    for (uint32_t waited = 0; waited < ARRIVAL_TIMEOUT_MS; waited++)
+    {
+        if (__atomic_load_n(&online, __ATOMIC_ACQUIRE) == apCount + 1)
+            break;
+        pit_wait(1000);
+    }
+
+    return __atomic_load_n(&online, __ATOMIC_ACQUIRE);
+}
+
+uint32_t smp_cpu_count()
+{
+    return online;
+}
+
+void smp_submit(smp_job* job)
+{
+    job->next = 0;
+    job->finished = 0;
+
+    // a full queue drains faster with the BSP helping
+    while (queueTail - __atomic_load_n(&queueHead, __ATOMIC_ACQUIRE) >= SMP_QUEUE_SIZE)
+    {
+        if (!work_once(0))
+            pause();
+    }
+
+    job->ticket = queueTail;
+    queue[queueTail % SMP_QUEUE_SIZE] = job;
+    __atomic_store_n(&queueTail, queueTail + 1, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&doorbell, 1, __ATOMIC_SEQ_CST);
+}
+
+void smp_wait(smp_job* job)
+{
+    // the queue is FIFO, so the job is out of it once the head moves past its ticket
+    while ((int32_t)(__atomic_load_n(&queueHead, __ATOMIC_ACQUIRE) - job->ticket) <= 0)
+    {
+        if (!work_once(0))
+            pause();
+    }
+
+    while (__atomic_load_n(&job->finished, __ATOMIC_ACQUIRE) < job->parts)
+        pause();
+
+    for (uint32_t cpu = 1; cpu < SMP_MAX_CPUS; cpu++)
+    {
+        while (__atomic_load_n(&working[cpu], __ATOMIC_ACQUIRE) == job)
+            pause();
+    }
+}
+
+void smp_run(smp_task task, void* arg, uint32_t parts)
+{
+    smp_job job;
+    job.task = task;
+    job.arg = arg;
+    job.parts = parts;
+    smp_submit(&job);
+    smp_wait(&job);
+}
+
+void smp_shutdown()
+{
+    if (apCount == 0)
+        return;
+
+    __atomic_store_n(&stopping, true, __ATOMIC_SEQ_CST);
+    __atomic_fetch_add(&doorbell, 1, __ATOMIC_SEQ_CST);
+    for (uint32_t cpu = 1; cpu < SMP_MAX_CPUS; cpu++)
+    {
+        while (__atomic_load_n(&working[cpu], __ATOMIC_ACQUIRE) != NULL)
+            pause();
+    }
+
+    for (uint32_t i = 0; i < apCount; i++)
+        send_ipi(apIds[i], LAPIC_ICR_INIT | LAPIC_ICR_ASSERT);
+}
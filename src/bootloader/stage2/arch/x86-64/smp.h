@@ -0,0 +1,113 @@
+/**
+ * @file smp.h
+ * @author Aidcraft
+ * @brief starts the application processors and hands them work
+ * @version 0.0.2
+ * @date 2025-03-14
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#pragma once
+
+#include "../../stdint.h"
+#include "../../memory/memory.h"
+
+/// @brief Most cpus used, the BSP included
+#define SMP_MAX_CPUS        16
+/// @brief Stack of each application processor
+#define SMP_STACK_SIZE      0x800
+/// @brief Jobs that can be queued before smp_submit has to wait
+#define SMP_QUEUE_SIZE      16
+
+static_assert((SMP_MAX_CPUS - 1) * SMP_STACK_SIZE <= MEMORY_SMP_STACKS_SIZE, "AP stacks don't fit");
+
+#define LAPIC_REG_ID        0x020
+#define LAPIC_REG_SVR       0x0F0
+#define LAPIC_REG_ESR       0x280
+#define LAPIC_REG_ICR_LOW   0x300
+#define LAPIC_REG_ICR_HIGH  0x310
+
+#define LAPIC_SVR_ENABLE    (1 << 8)
+#define LAPIC_SPURIOUS      0xFF
+
+#define LAPIC_ICR_INIT      (5 << 8)
+#define LAPIC_ICR_STARTUP   (6 << 8)
+#define LAPIC_ICR_PENDING   (1 << 12)
+#define LAPIC_ICR_ASSERT    (1 << 14)
+
+/// @brief Runs one part of a job, parts may run on any cpu in any order
+typedef void (*smp_task)(void* arg, uint32_t part);
+
+/// @brief Work split into parts that cpus claim one at a time
+typedef struct
+{
+    smp_task task;
+    void* arg;
+    uint32_t parts;
+    /// @brief next part to hand out
+    volatile uint32_t next;
+    /// @brief parts that have finished running
+    volatile uint32_t finished;
+    /// @brief position in the queue
+    uint32_t ticket;
+} smp_job;
+
+/// @brief Parameters at the end of smp-trampoline.asm
+typedef struct
+{
+    uint32_t cr3;
+    uint32_t cr4;
+    uint64_t efer;
+    uint64_t entry;
+    uint64_t stackBase;
+    uint64_t stackSize;
+    uint32_t next;
+} __attribute__((packed)) smp_startup_params;
+
+/**
+ * @brief Starts every enabled processor listed in the MADT
+ * @details Each one enters long mode on the BSP's page tables and waits for
+ * jobs. Without ACPI, a local APIC or other processors everything keeps
+ * running on the BSP.
+ *
+ * @return uint32_t number of cpus running, the BSP included
+ */
+uint32_t smp_init();
+
+/// @brief Number of cpus running stage2 work, the BSP included
+uint32_t smp_cpu_count();
+
+/**
+ * @brief Queues a job, application processors start on it right away
+ * @details The job must stay alive until smp_wait returns for it.
+ *
+ * @param[in] job task, arg and parts filled in
+ */
+void smp_submit(smp_job* job);
+
+/**
+ * @brief Helps with queued work until the job (and every job queued before
+ * it) has completed
+ *
+ * @param[in] job a submitted job
+ */
+void smp_wait(smp_job* job);
+
+/**
+ * @brief Runs a job on every cpu and waits for it
+ *
+ * @param[in] task function run for each part
+ * @param[in] arg passed to the task
+ * @param[in] parts number of parts
+ */
+void smp_run(smp_task task, void* arg, uint32_t parts);
+
+/**
+ * @brief Sends the application processors back to wait-for-SIPI so the
+ * kernel can start them itself and stage2 memory can be reclaimed
+ */
+void smp_shutdown();
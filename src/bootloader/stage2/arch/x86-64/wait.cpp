@@ -0,0 +1,104 @@
+/**
+ * @file wait.cpp
+ * @author Aidcraft
+ * @brief polling for completions without burning the core
+ * @version 0.0.2
+ * @date 2025-03-23
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#include "wait.h"
+#include "cpu.h"
+#include "../../trace.h"
+
+/// @brief Assumed when the TSC could not be calibrated, too fast only makes timeouts longer
+#define WAIT_FALLBACK_FREQUENCY 10000000000ULL
+
+static bool hasMonitor;
+static bool hasWaitpkg;
+static uint64_t ticksPerUs;
+
+void wait_init()
+{
+    hasMonitor = cpuid(1).ecx & CPUID_01_ECX_MONITOR;
+    hasWaitpkg = cpuid(0).eax >= 7 && (cpuid(7).ecx & CPUID_07_ECX_WAITPKG);
+
+    uint64_t frequency = trace_tsc_frequency();
+    ticksPerUs = (frequency != 0 ? frequency : WAIT_FALLBACK_FREQUENCY) / 1000000;
+}
+
+uint64_t wait_deadline(uint32_t microseconds)
+{
+    return rdtsc() + microseconds * ticksPerUs;
+}
+
+bool wait_expired(uint64_t deadline)
+{
+    return deadline != WAIT_FOREVER && rdtsc() >= deadline;
+}
+
+void wait_pause(wait_backoff* backoff)
+{
+    uint32_t spins = backoff->spins == 0 ? 1 : backoff->spins;
+    for (uint32_t i = 0; i < spins; i++)
+        pause();
+
+    if (spins < WAIT_BACKOFF_MAX)
+        spins *= 2;
+    backoff->spins = spins;
+}
+
+static bool done(const volatile uint32_t* address, uint32_t mask, uint32_t value, bool change)
+{
+    uint32_t current = *address & mask;
+    return change ? current != value : current == value;
+}
+
+/*
+ * The monitor is armed before the last look at the word, so a write
+ * landing between the look and the sleep still wakes it.
+ */
+static bool wait(const volatile uint32_t* address, uint32_t mask, uint32_t value, bool change, uint64_t deadline)
+{
+    wait_backoff backoff = {0};
+
+    while (!done(address, mask, value, change))
+    {
+        if (wait_expired(deadline))
+            return false;
+
+        if (hasWaitpkg)
+        {
+            umonitor(address);
+            if (done(address, mask, value, change))
+                break;
+            umwait(deadline == WAIT_FOREVER ? ~0ULL : deadline);
+        }
+        else if (hasMonitor && deadline == WAIT_FOREVER)
+        {
+            monitor(address);
+            if (done(address, mask, value, change))
+                break;
+            mwait();
+        }
+        else
+        {
+            wait_pause(&backoff);
+        }
+    }
+    return true;
+}
+
+bool wait_until(const volatile uint32_t* address, uint32_t mask, uint32_t value, uint64_t deadline)
+{
+    return wait(address, mask, value, false, deadline);
+}
+
+bool wait_change(const volatile uint32_t* address, uint32_t old, uint64_t deadline)
+{
+    return wait(address, 0xFFFFFFFF, old, true, deadline);
+}
@@ -0,0 +1,88 @@
+/**
+ * @file wait.h
+ * @author Aidcraft
+ * @brief polling for completions without burning the core
+ * @version 0.0.2
+ * @date 2025-03-23
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ * @details Stage2 runs with every interrupt masked, so a plain MWAIT only
+ * ends when the monitored line is written. Waits with a deadline therefore
+ * sleep with UMWAIT, which takes the deadline itself, and fall back to
+ * PAUSE with exponential backoff. MWAIT is only used for open ended waits
+ * where some other cpu or device is known to write the line.
+ */
+
+#pragma once
+
+#include "../../stdint.h"
+
+/// @brief Deadline of a wait that only ends when the value changes
+#define WAIT_FOREVER        0
+
+/// @brief Most PAUSEs between two polls
+#define WAIT_BACKOFF_MAX    64
+
+/// @brief Exponential PAUSE backoff between polls, start it zeroed
+typedef struct
+{
+    uint32_t spins;
+} wait_backoff;
+
+/**
+ * @brief Detects MONITOR/MWAIT and WAITPKG
+ * @details Needs trace_init for the TSC frequency.
+ */
+void wait_init();
+
+/**
+ * @brief TSC value a number of microseconds from now
+ *
+ * @param[in] microseconds timeout
+ * @return uint64_t deadline for wait_expired and the waits below
+ */
+uint64_t wait_deadline(uint32_t microseconds);
+
+/**
+ * @brief Whether the TSC has passed a deadline
+ *
+ * @param[in] deadline from wait_deadline, WAIT_FOREVER never expires
+ * @return true the deadline has passed
+ */
+bool wait_expired(uint64_t deadline);
+
+/**
+ * @brief Pauses between two polls of a register that can't be monitored
+ * @details Every call pauses twice as long as the one before, up to
+ * WAIT_BACKOFF_MAX. Port reads cost a VM exit each under virtualization,
+ * backing off keeps them from adding up.
+ *
+ * @param[in,out] backoff state kept across the polls of one wait
+ */
+void wait_pause(wait_backoff* backoff);
+
+/**
+ * @brief Waits for (*address & mask) == value
+ *
+ * @param[in] address completion word in memory, written by a device or another cpu
+ * @param[in] mask bits that matter
+ * @param[in] value expected bits
+ * @param[in] deadline from wait_deadline, or WAIT_FOREVER
+ * @return true the value arrived
+ * @return false the deadline passed first
+ */
+bool wait_until(const volatile uint32_t* address, uint32_t mask, uint32_t value, uint64_t deadline);
+
+/**
+ * @brief Waits for *address to differ from old
+ *
+ * @param[in] address word in memory, written by a device or another cpu
+ * @param[in] old value seen before deciding to wait
+ * @param[in] deadline from wait_deadline, or WAIT_FOREVER
+ * @return true the value changed
+ * @return false the deadline passed first
+ */
+bool wait_change(const volatile uint32_t* address, uint32_t old, uint64_t deadline);
@@ -0,0 +1,129 @@
+/**
+ * @file console.cpp
+ * @author Aidcraft
+ * @brief text console kept in a RAM shadow and copied to the screen by line
+ * @version 0.0.2
+ * @date 2025-03-19
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#include "console.h"
+#include "memory/memory.h"
+#include "framebuffer.h"
+
+#define BLANK ((CONSOLE_ATTRIBUTE << 8) | ' ')
+#define ALL_LINES ((1u << CONSOLE_HEIGHT) - 1)
+
+static_assert(CONSOLE_HEIGHT <= 32, "dirty lines are tracked in a uint32_t");
+
+__attribute__((aligned(8)))
+static uint16_t shadow[CONSOLE_HEIGHT][CONSOLE_WIDTH];
+/// @brief shadow line shown at the top of the screen
+static uint32_t top;
+static uint32_t cursorX;
+static uint32_t cursorY;
+/// @brief one bit per screen line that differs from video memory
+static uint32_t dirty;
+
+static uint16_t* line(uint32_t y)
+{
+    return shadow[(top + y) % CONSOLE_HEIGHT];
+}
+
+static void blank_line(uint16_t* cells)
+{
+    for (uint32_t x = 0; x < CONSOLE_WIDTH; x++)
+        cells[x] = BLANK;
+}
+
+void console_clear()
+{
+    for (uint32_t y = 0; y < CONSOLE_HEIGHT; y++)
+        blank_line(shadow[y]);
+
+    top = 0;
+    cursorX = 0;
+    cursorY = 0;
+    dirty = ALL_LINES;
+    console_flush();
+}
+
+void console_putchr(uint32_t x, uint32_t y, char c)
+{
+    if (x >= CONSOLE_WIDTH || y >= CONSOLE_HEIGHT)
+        return;
+
+    line(y)[x] = (CONSOLE_ATTRIBUTE << 8) | (uint8_t)c;
+    dirty |= 1u << y;
+}
+
+void console_putc(char c)
+{
+    if (c == '\n')
+    {
+        cursorX = 0;
+        cursorY++;
+    }
+    else if (c == '\r')
+    {
+        cursorX = 0;
+    }
+    else
+    {
+        console_putchr(cursorX, cursorY, c);
+        cursorX++;
+    }
+
+    if (cursorX >= CONSOLE_WIDTH)
+    {
+        cursorX = 0;
+        cursorY++;
+    }
+
+    if (cursorY >= CONSOLE_HEIGHT)
+    {
+        // the old top line becomes the new bottom one, every screen line moves
+        top = (top + 1) % CONSOLE_HEIGHT;
+        blank_line(line(CONSOLE_HEIGHT - 1));
+        cursorY = CONSOLE_HEIGHT - 1;
+        dirty = ALL_LINES;
+    }
+
+    if (c == '\n')
+        console_flush();
+}
+
+void console_flush()
+{
+    volatile uint64_t* screen = (volatile uint64_t*)VGA_TEXT_START;
+
+    for (uint32_t y = 0; dirty != 0; y++)
+    {
+        if (!(dirty & (1u << y)))
+            continue;
+
+        if (framebuffer_active())
+        {
+            framebuffer_draw_line(y, line(y), CONSOLE_WIDTH);
+        }
+        else
+        {
+            const uint64_t* cells = (const uint64_t*)line(y);
+            volatile uint64_t* out = screen + y * CONSOLE_WIDTH / 4;
+            for (uint32_t i = 0; i < CONSOLE_WIDTH / 4; i++)
+                out[i] = cells[i];
+        }
+
+        dirty &= ~(1u << y);
+    }
+}
+
+void console_redraw()
+{
+    dirty = ALL_LINES;
+    console_flush();
+}
@@ -0,0 +1,50 @@
+/**
+ * @file console.h
+ * @author Aidcraft
+ * @brief text console kept in a RAM shadow and copied to the screen by line
+ * @version 0.0.2
+ * @date 2025-03-19
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ * @details Video memory is never read back. Scrolling moves the shadow's
+ * start line instead of copying, and lines that changed are written out
+ * a qword at a time at each newline or console_flush. Once
+ * framebuffer_init succeeds, lines are drawn on the framebuffer instead.
+ */
+
+#pragma once
+
+#include "stdint.h"
+
+#define CONSOLE_WIDTH       80
+#define CONSOLE_HEIGHT      25
+/// @brief light grey on black
+#define CONSOLE_ATTRIBUTE   0x07
+
+/// @brief Blanks the console and the screen
+void console_clear();
+
+/**
+ * @brief Puts c at x, y without moving the cursor
+ *
+ * @param[in] x column
+ * @param[in] y screen line
+ * @param[in] c the character
+ */
+void console_putchr(uint32_t x, uint32_t y, char c);
+
+/**
+ * @brief Puts c at the cursor, handling '\n', '\r', wrapping and scrolling
+ *
+ * @param[in] c the character
+ */
+void console_putc(char c);
+
+/// @brief Copies the changed lines to the screen
+void console_flush();
+
+/// @brief Redraws every line, after the screen or font changed
+void console_redraw();
@@ -1,6 +1,99 @@
 #include "disk.h"
+#include "stdio.h"
+#include "memory/memory.h"
+#include "arch/x86-64/cpu.h"
+#include "trace.h"
 
-disk::disk(DiskReadFunc readFunc)
+#define SECTOR_SIZE 512
+
+disk::disk(DiskReadFunc readFunc, DiskWriteFunc writeFunc)
 {
     this->readFunc = readFunc;
-}
\ No newline at end of file
+    this->writeFunc = writeFunc;
+    memset(&stats, 0, sizeof(stats));
+}
+
+bool disk::read(void *buffer, uint8_t sectorCount, uint32_t LBA)
+{
+    uint64_t start = rdtsc();
+    bool ok = readFunc(buffer, sectorCount, LBA);
+    // a count of 0 asks the drive for 256 sectors
+    disk_stats_record(&stats, LBA, sectorCount == 0 ? 256 : sectorCount, start, ok);
+    return ok;
+}
+
+bool disk::write(const void *buffer, uint8_t sectorCount, uint32_t LBA)
+{
+    // the counters describe loading, they are handed over before anything is written
+    return writeFunc != NULL && writeFunc(buffer, sectorCount, LBA);
+}
+
+void disk_stats_record(disk_stats* stats, uint32_t LBA, uint32_t sectorCount, uint64_t start, bool ok)
+{
+    uint64_t cycles = rdtsc() - start;
+
+    stats->commands++;
+    if (!ok)
+    {
+        stats->errors++;
+        return;
+    }
+
+    if (stats->commands > 1 && LBA != stats->nextLba)
+        stats->seeks++;
+    stats->nextLba = (uint64_t)LBA + sectorCount;
+
+    stats->sectors += sectorCount;
+    stats->bytes += (uint64_t)sectorCount * SECTOR_SIZE;
+    stats->cycles += cycles;
+
+    uint32_t bucket = cycles == 0 ? 0 : 63 - __builtin_clzll(cycles);
+    if (bucket >= DISK_LATENCY_BUCKETS)
+        bucket = DISK_LATENCY_BUCKETS - 1;
+    stats->latency[bucket]++;
+}
+
+void disk_stats_dump(const char* name, const disk_stats* stats)
+{
+    puts(name);
+    puts(": commands ");
+    put_dec(stats->commands, 0);
+    puts(" sectors ");
+    put_dec(stats->sectors, 0);
+    puts(" errors ");
+    put_dec(stats->errors, 0);
+    puts(" seeks ");
+    put_dec(stats->seeks, 0);
+    puts(" cache hits ");
+    put_dec(stats->cacheHits, 0);
+    putc('\n');
+
+    uint64_t good = stats->commands - stats->errors;
+    if (good == 0)
+        return;
+
+    uint64_t frequency = trace_tsc_frequency();
+    puts("  ");
+    put_dec(trace_ticks_to_us(stats->cycles), 0);
+    puts(" us busy, ");
+    put_dec(trace_ticks_to_us(stats->cycles / good), 0);
+    puts(" us per command");
+    if (stats->cycles != 0 && frequency != 0)
+    {
+        puts(", ");
+        put_dec(stats->bytes * frequency / stats->cycles / 1024, 0);
+        puts(" KB/s");
+    }
+    putc('\n');
+
+    // cycles per command, log2 buckets
+    for (uint32_t bucket = 0; bucket < DISK_LATENCY_BUCKETS; bucket++)
+    {
+        if (stats->latency[bucket] == 0)
+            continue;
+        puts("  2^");
+        put_dec(bucket, 2);
+        put_dec(stats->latency[bucket], 8);
+        putc('\n');
+    }
+}
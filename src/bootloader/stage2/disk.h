@@ -14,14 +14,60 @@
 #pragma once
 
 #include "stdint.h"
+#include "stddef.h"
 
 /// @brief Function pointer for disk read function
 using DiskReadFunc = bool (*)(void *, uint8_t, uint32_t);
 
+/// @brief Function pointer for disk write function
+using DiskWriteFunc = bool (*)(const void *, uint8_t, uint32_t);
+
+/// @brief Number of log2 latency buckets, the last one collects everything slower
+#define DISK_LATENCY_BUCKETS 32
+
+/// @brief I/O counters of one layer of the disk stack
+typedef struct
+{
+    uint64_t commands;
+    uint64_t sectors;
+    uint64_t bytes;
+    uint64_t errors;
+    /// @brief commands that didn't start where the previous one ended
+    uint64_t seeks;
+    /// @brief reads answered from a buffer without a command
+    uint64_t cacheHits;
+    /// @brief TSC cycles spent inside commands
+    uint64_t cycles;
+    /// @brief LBA following the previous command
+    uint64_t nextLba;
+    /// @brief commands by log2 of their TSC cycles
+    uint32_t latency[DISK_LATENCY_BUCKETS];
+} disk_stats;
+
+/**
+ * @brief Accounts one finished command
+ *
+ * @param[in] stats counters to update
+ * @param[in] LBA first sector of the command
+ * @param[in] sectorCount sectors it covered
+ * @param[in] start rdtsc taken when it was issued
+ * @param[in] ok whether it succeeded
+ */
+void disk_stats_record(disk_stats* stats, uint32_t LBA, uint32_t sectorCount, uint64_t start, bool ok);
+
+/**
+ * @brief Prints the counters and the non empty latency buckets
+ *
+ * @param[in] name layer name to print in front
+ * @param[in] stats counters to print
+ */
+void disk_stats_dump(const char* name, const disk_stats* stats);
+
 class disk
 {
 private:
     DiskReadFunc readFunc;
+    DiskWriteFunc writeFunc;
 
 public:
     /// @brief Reads from the disk
@@ -29,10 +75,14 @@ public:
     /// @param sectorCount number of sectors to read
     /// @param LBA LBA to read from
     /// @return Sucess or failure
-    bool read(void *buffer, uint8_t sectorCount, uint32_t LBA)
-    {
-        return readFunc(buffer, sectorCount, LBA);
-    }
+    bool read(void *buffer, uint8_t sectorCount, uint32_t LBA);
+
+    /// @brief Writes to the disk, not counted in stats
+    /// @param buffer Buffer to write from
+    /// @param sectorCount number of sectors to write
+    /// @param LBA LBA to write to
+    /// @return Sucess or failure, always failure without a write function
+    bool write(const void *buffer, uint8_t sectorCount, uint32_t LBA);
 
     /// @brief Initializes the disk
     /// @param id Id of the disk
@@ -44,7 +94,11 @@ public:
     /// @brief Id of the disk
     uint8_t id;
 
+    /// @brief One entry per read command sent to the drive
+    disk_stats stats;
+
     /// @brief Constructor for disk
     /// @param readFunc Function to read from the disk (void* buffer, uint8_t sectorCount, uint32_t LBA)
-    disk(DiskReadFunc readFunc);
+    /// @param writeFunc Function to write to the disk (const void* buffer, uint8_t sectorCount, uint32_t LBA), NULL for a read only disk
+    disk(DiskReadFunc readFunc, DiskWriteFunc writeFunc = NULL);
 };
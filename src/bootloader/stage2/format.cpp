@@ -0,0 +1,280 @@
+/**
+ * @file format.cpp
+ * @author Aidcraft
+ * @brief printf style formatting into caller buffers
+ * @version 0.0.2
+ * @date 2025-03-18
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#include "format.h"
+
+static const char lowerDigits[] = "0123456789abcdef";
+static const char upperDigits[] = "0123456789ABCDEF";
+
+/// @brief Output position in the caller's buffer, writes past the end are dropped
+typedef struct
+{
+    char* buffer;
+    uint32_t size;
+    uint32_t length;
+} format_output;
+
+static void emit(format_output* out, char c)
+{
+    if (out->length + 1 < out->size)
+        out->buffer[out->length++] = c;
+}
+
+static void emit_padding(format_output* out, char pad, uint32_t count)
+{
+    while (count-- != 0)
+        emit(out, pad);
+}
+
+/*
+ * Pad and write a converted field. prefix ("-", "0x") stays in front of
+ * zero padding but behind space padding.
+ */
+static void emit_field(format_output* out, const format_spec* spec, const char* prefix, const char* text, uint32_t length)
+{
+    uint32_t prefixLength = 0;
+    while (prefix[prefixLength])
+        prefixLength++;
+
+    uint32_t padding = spec->width > prefixLength + length ? spec->width - prefixLength - length : 0;
+
+    if (!spec->left && !spec->zero)
+        emit_padding(out, ' ', padding);
+    for (uint32_t i = 0; i < prefixLength; i++)
+        emit(out, prefix[i]);
+    if (!spec->left && spec->zero)
+        emit_padding(out, '0', padding);
+    for (uint32_t i = 0; i < length; i++)
+        emit(out, text[i]);
+    if (spec->left)
+        emit_padding(out, ' ', padding);
+}
+
+/*
+ * Digits of value in base, most significant first, into digits[64].
+ */
+static uint32_t to_digits(uint64_t value, uint8_t base, const char* set, char* digits)
+{
+    char reversed[64];
+    uint32_t length = 0;
+    do
+    {
+        reversed[length++] = set[value % base];
+        value /= base;
+    } while (value != 0);
+
+    for (uint32_t i = 0; i < length; i++)
+        digits[i] = reversed[length - 1 - i];
+    return length;
+}
+
+static void format_one(format_output* out, const format_spec* spec, const format_arg* arg)
+{
+    char digits[64];
+    uint64_t value = arg->value;
+
+    // h and hh print the value converted to short or char, as C does
+    uint8_t narrow = spec->shorts == 0 ? 0 : spec->shorts == 1 ? 16 : 8;
+
+    switch (spec->conversion)
+    {
+    case 'c':
+    {
+        char c = (char)value;
+        emit_field(out, spec, "", &c, 1);
+        return;
+    }
+    case 's':
+    {
+        const char* str = (const char*)value;
+        if (str == 0)
+            str = "(null)";
+        uint32_t length = 0;
+        while (str[length])
+            length++;
+        emit_field(out, spec, "", str, length);
+        return;
+    }
+    case 'p':
+        emit_field(out, spec, "0x", digits, to_digits(value, 16, lowerDigits, digits));
+        return;
+    case 'd':
+    case 'i':
+    {
+        int64_t signedValue = (int64_t)value;
+        bool isSigned = arg->kind == FORMAT_SIGNED;
+        if (narrow != 0)
+        {
+            signedValue = (int64_t)(value << (64 - narrow)) >> (64 - narrow);
+            isSigned = true;
+        }
+        if (isSigned && signedValue < 0)
+        {
+            emit_field(out, spec, "-", digits, to_digits(-(uint64_t)signedValue, 10, lowerDigits, digits));
+            return;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+
+    // unsigned conversions see a negative argument as its own width in bits
+    if (arg->kind == FORMAT_SIGNED && arg->size < sizeof(uint64_t))
+        value &= (1ULL << (arg->size * 8)) - 1;
+    if (narrow != 0)
+        value &= (1ULL << narrow) - 1;
+
+    uint8_t base = 10;
+    const char* set = lowerDigits;
+    switch (spec->conversion)
+    {
+    case 'x':
+        base = 16;
+        break;
+    case 'X':
+        base = 16;
+        set = upperDigits;
+        break;
+    case 'o':
+        base = 8;
+        break;
+    case 'b':
+        base = 2;
+        break;
+    default:
+        break;
+    }
+
+    emit_field(out, spec, "", digits, to_digits(value, base, set, digits));
+}
+
+uint32_t format_args(char* buffer, uint32_t size, const char* fmt, const format_arg* args, uint32_t count)
+{
+    format_output out = {buffer, size, 0};
+    uint32_t used = 0;
+
+    while (*fmt)
+    {
+        if (*fmt != '%')
+        {
+            emit(&out, *fmt++);
+            continue;
+        }
+
+        fmt++;
+        if (*fmt == '%')
+        {
+            emit(&out, *fmt++);
+            continue;
+        }
+
+        format_spec spec = {};
+        fmt = format_parse_spec(fmt, &spec);
+        if (used < count && format_accepts(spec.conversion, args[used].kind))
+            format_one(&out, &spec, &args[used]);
+        used++;
+    }
+
+    if (size != 0)
+        buffer[out.length] = '\0';
+    return out.length;
+}
+
+/*
+ * Fetch one argument the way the C calling convention promoted it.
+ */
+static format_arg fetch_arg(const format_spec* spec, va_list* args)
+{
+    format_arg arg = {0, FORMAT_NONE, sizeof(uint64_t)};
+
+    switch (spec->conversion)
+    {
+    case 'd':
+    case 'i':
+        arg.kind = FORMAT_SIGNED;
+        if (spec->longs == 0)
+        {
+            arg.value = (int64_t)va_arg(*args, int);
+            arg.size = sizeof(int);
+        }
+        else
+            arg.value = (int64_t)va_arg(*args, long long);
+        break;
+    case 'u':
+    case 'x':
+    case 'X':
+    case 'o':
+    case 'b':
+        arg.kind = FORMAT_UNSIGNED;
+        if (spec->longs == 0)
+        {
+            arg.value = va_arg(*args, unsigned int);
+            arg.size = sizeof(unsigned int);
+        }
+        else
+            arg.value = va_arg(*args, unsigned long long);
+        break;
+    case 'c':
+        arg.kind = FORMAT_CHAR;
+        arg.value = (char)va_arg(*args, int);
+        arg.size = sizeof(char);
+        break;
+    case 's':
+        arg.kind = FORMAT_STRING;
+        arg.value = (uint64_t)va_arg(*args, const char*);
+        break;
+    case 'p':
+        arg.kind = FORMAT_POINTER;
+        arg.value = (uint64_t)va_arg(*args, void*);
+        break;
+    default:
+        break;
+    }
+    return arg;
+}
+
+uint32_t vsnprintf(char* buffer, uint32_t size, const char* fmt, va_list args)
+{
+    format_arg collected[FORMAT_MAX_ARGS];
+    uint32_t count = 0;
+    va_list walk;
+    va_copy(walk, args);
+
+    for (const char* scan = fmt; *scan && count < FORMAT_MAX_ARGS;)
+    {
+        if (*scan++ != '%')
+            continue;
+        if (*scan == '%')
+        {
+            scan++;
+            continue;
+        }
+
+        format_spec spec = {};
+        scan = format_parse_spec(scan, &spec);
+        collected[count++] = fetch_arg(&spec, &walk);
+    }
+
+    va_end(walk);
+    return format_args(buffer, size, fmt, collected, count);
+}
+
+uint32_t snprintf(char* buffer, uint32_t size, const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    uint32_t length = vsnprintf(buffer, size, fmt, args);
+    va_end(args);
+    return length;
+}
@@ -0,0 +1,275 @@
+/**
+ * @file format.h
+ * @author Aidcraft
+ * @brief printf style formatting into caller buffers
+ * @version 0.0.2
+ * @date 2025-03-18
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ * @details Supports %d %i %u %x %X %o %b %c %s %p and %%, the flags '-'
+ * and '0', a width and the length modifiers hh h l ll z. PRINTF checks the
+ * format against its argument types at compile time and passes the
+ * arguments as a typed array, without va_arg.
+ */
+
+#pragma once
+
+#include "stdint.h"
+#include "stdarg.h"
+#include "stdio.h"
+
+/// @brief What an argument can be printed as
+enum format_kind : uint8_t
+{
+    FORMAT_NONE,
+    FORMAT_SIGNED,
+    FORMAT_UNSIGNED,
+    FORMAT_CHAR,
+    FORMAT_STRING,
+    FORMAT_POINTER
+};
+
+/// @brief One argument, integers are sign or zero extended to 64 bits
+typedef struct
+{
+    uint64_t value;
+    format_kind kind;
+    /// @brief size of the original type in bytes
+    uint8_t size;
+} format_arg;
+
+/// @brief A parsed conversion specification
+typedef struct
+{
+    bool left;
+    bool zero;
+    uint8_t width;
+    /// @brief 0 for int, 1 for long, 2 for long long
+    uint8_t longs;
+    /// @brief 0 for int, 1 for short, 2 for char
+    uint8_t shorts;
+    char conversion;
+} format_spec;
+
+/// @brief Most arguments printf collects
+#define FORMAT_MAX_ARGS 16
+
+/// @brief Longest line PRINTF formats at once
+#define FORMAT_LINE_SIZE 160
+
+/**
+ * @brief Parses the specification following a '%'
+ *
+ * @param[in] fmt first character after the '%'
+ * @param[out] spec the parsed specification
+ * @return const char* the character after the conversion
+ */
+constexpr const char* format_parse_spec(const char* fmt, format_spec* spec)
+{
+    spec->left = false;
+    spec->zero = false;
+    spec->width = 0;
+    spec->longs = 0;
+    spec->shorts = 0;
+
+    for (;; fmt++)
+    {
+        if (*fmt == '-')
+            spec->left = true;
+        else if (*fmt == '0')
+            spec->zero = true;
+        else
+            break;
+    }
+
+    for (; *fmt >= '0' && *fmt <= '9'; fmt++)
+        spec->width = spec->width * 10 + (*fmt - '0');
+
+    for (; *fmt == 'h' || *fmt == 'l' || *fmt == 'z'; fmt++)
+    {
+        if (*fmt == 'l')
+            spec->longs++;
+        else if (*fmt == 'h')
+            spec->shorts++;
+        else if (*fmt == 'z')
+            spec->longs = 1;
+    }
+
+    spec->conversion = *fmt;
+    return *fmt ? fmt + 1 : fmt;
+}
+
+/**
+ * @brief Whether an argument of kind fits a conversion
+ *
+ * @param[in] conversion the conversion character
+ * @param[in] kind the argument
+ * @return bool true if it can be printed that way
+ */
+constexpr bool format_accepts(char conversion, format_kind kind)
+{
+    switch (conversion)
+    {
+    case 'd':
+    case 'i':
+    case 'u':
+    case 'x':
+    case 'X':
+    case 'o':
+    case 'b':
+    case 'c':
+        return kind == FORMAT_SIGNED || kind == FORMAT_UNSIGNED || kind == FORMAT_CHAR;
+    case 's':
+        return kind == FORMAT_STRING;
+    case 'p':
+        return kind == FORMAT_POINTER || kind == FORMAT_STRING;
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief Checks a format against the kinds of its arguments
+ *
+ * @param[in] fmt the format
+ * @param[in] kinds one kind per argument
+ * @param[in] count number of arguments
+ * @return bool true if every conversion has a fitting argument and none is left over
+ */
+constexpr bool format_valid(const char* fmt, const format_kind* kinds, uint32_t count)
+{
+    uint32_t used = 0;
+    while (*fmt)
+    {
+        if (*fmt++ != '%')
+            continue;
+        if (*fmt == '%')
+        {
+            fmt++;
+            continue;
+        }
+
+        format_spec spec = {};
+        fmt = format_parse_spec(fmt, &spec);
+        if (used == count || !format_accepts(spec.conversion, kinds[used++]))
+            return false;
+    }
+    return used == count;
+}
+
+/**
+ * @brief Formats into buffer, always NUL terminated
+ *
+ * @param[out] buffer where the text goes
+ * @param[in] size size of buffer, output beyond size - 1 is dropped
+ * @param[in] fmt the format
+ * @param[in] args the arguments, in order
+ * @param[in] count number of arguments
+ * @return uint32_t characters written, without the NUL
+ */
+uint32_t format_args(char* buffer, uint32_t size, const char* fmt, const format_arg* args, uint32_t count);
+
+/**
+ * @brief Formats a va_list into buffer
+ * @details Takes at most FORMAT_MAX_ARGS arguments, later conversions print nothing.
+ *
+ * @param[out] buffer where the text goes
+ * @param[in] size size of buffer
+ * @param[in] fmt the format
+ * @param[in] args the arguments
+ * @return uint32_t characters written, without the NUL
+ */
+uint32_t vsnprintf(char* buffer, uint32_t size, const char* fmt, va_list args);
+
+/**
+ * @brief Formats into buffer
+ *
+ * @param[out] buffer where the text goes
+ * @param[in] size size of buffer
+ * @param[in] fmt the format
+ * @return uint32_t characters written, without the NUL
+ */
+uint32_t snprintf(char* buffer, uint32_t size, const char* fmt, ...) __attribute__((format(printf, 3, 4)));
+
+/// @brief The format_kind of a type, FORMAT_NONE if it can't be printed
+template <typename T>
+struct format_traits
+{
+    static constexpr format_kind kind = FORMAT_NONE;
+};
+
+template <typename T>
+struct format_traits<T*>
+{
+    static constexpr format_kind kind = FORMAT_POINTER;
+};
+
+#define FORMAT_TRAIT(type, formatKind)                          \
+    template <>                                                 \
+    struct format_traits<type>                                  \
+    {                                                           \
+        static constexpr format_kind kind = formatKind;         \
+    };
+
+FORMAT_TRAIT(char*, FORMAT_STRING)
+FORMAT_TRAIT(const char*, FORMAT_STRING)
+FORMAT_TRAIT(char, FORMAT_CHAR)
+FORMAT_TRAIT(bool, FORMAT_UNSIGNED)
+FORMAT_TRAIT(signed char, FORMAT_SIGNED)
+FORMAT_TRAIT(short, FORMAT_SIGNED)
+FORMAT_TRAIT(int, FORMAT_SIGNED)
+FORMAT_TRAIT(long, FORMAT_SIGNED)
+FORMAT_TRAIT(long long, FORMAT_SIGNED)
+FORMAT_TRAIT(unsigned char, FORMAT_UNSIGNED)
+FORMAT_TRAIT(unsigned short, FORMAT_UNSIGNED)
+FORMAT_TRAIT(unsigned int, FORMAT_UNSIGNED)
+FORMAT_TRAIT(unsigned long, FORMAT_UNSIGNED)
+FORMAT_TRAIT(unsigned long long, FORMAT_UNSIGNED)
+
+#undef FORMAT_TRAIT
+
+/// @brief Carries the argument types of a PRINTF call into format_check
+template <typename... T>
+struct format_pack
+{
+};
+
+/// @brief Only used inside decltype, arguments decay as they would when passed
+template <typename... T>
+format_pack<T...> format_types(T...);
+
+template <typename... T>
+constexpr bool format_check(const char* fmt, format_pack<T...>)
+{
+    const format_kind kinds[] = {format_traits<T>::kind..., FORMAT_NONE};
+    return format_valid(fmt, kinds, sizeof...(T));
+}
+
+template <typename T>
+format_arg format_make(T value)
+{
+    return {(uint64_t)value, format_traits<T>::kind, sizeof(T)};
+}
+
+/**
+ * @brief Formats one line with typed arguments and writes it out
+ * @details Use PRINTF, which checks the format first.
+ */
+template <typename... T>
+void format_print(const char* fmt, T... values)
+{
+    const format_arg args[] = {format_make(values)..., {0, FORMAT_NONE, 0}};
+    char line[FORMAT_LINE_SIZE];
+    putn(line, format_args(line, sizeof(line), fmt, args, sizeof...(T)));
+}
+
+/// @brief printf with the format checked against the argument types at compile time
+#define PRINTF(fmt, ...)                                                                        \
+    do                                                                                          \
+    {                                                                                           \
+        static_assert(format_check(fmt, decltype(format_types(__VA_ARGS__)){}), "bad format");  \
+        format_print(fmt, ##__VA_ARGS__);                                                       \
+    } while (0)
@@ -0,0 +1,170 @@
+/**
+ * @file framebuffer.cpp
+ * @author Aidcraft
+ * @brief draws the console on the linear framebuffer set up through VBE
+ * @version 0.0.2
+ * @date 2025-03-19
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#include "framebuffer.h"
+#include "stdio.h"
+#include "stddef.h"
+#include "memory/memory.h"
+#include "memory/paging.h"
+
+#define PAGE_MASK 0xFFF
+
+#define GLYPH_WIDTH 8
+#define GLYPH_COUNT 256
+#define ROM_FONT_HEIGHT 16
+#define MAX_FONT_HEIGHT (MEMORY_FONT_SIZE / GLYPH_COUNT)
+
+/// @brief light grey on black, like the text console
+#define FOREGROUND_RGB 0xAAAAAA
+#define BACKGROUND_RGB 0x000000
+
+static uint8_t* const glyphs = (uint8_t*)MEMORY_FONT_START;
+static uint32_t glyphHeight;
+static bool active;
+
+/*
+ * Pixels for every 4 bit slice of a glyph row, most significant bit
+ * leftmost. A row is drawn as two 16 byte copies instead of 8 tests.
+ */
+__attribute__((aligned(16)))
+static uint32_t nibbles[16][4];
+
+/*
+ * Place an 0xRRGGBB color into the mode's pixel layout.
+ */
+static uint32_t pack(uint32_t rgb)
+{
+    const vbe_framebuffer_info* fb = &vbe_framebuffer;
+    uint32_t r = (rgb >> 16) & 0xFF, g = (rgb >> 8) & 0xFF, b = rgb & 0xFF;
+    return (r >> (8 - fb->redSize)) << fb->redPosition |
+           (g >> (8 - fb->greenSize)) << fb->greenPosition |
+           (b >> (8 - fb->blueSize)) << fb->bluePosition;
+}
+
+bool framebuffer_init()
+{
+    const vbe_framebuffer_info* fb = &vbe_framebuffer;
+    if (fb->address == 0 || fb->bpp != 32)
+        return false;
+
+    // usually high in the PCI hole, far above the identity map
+    uint64_t start = fb->address & ~(uint64_t)PAGE_MASK;
+    uint64_t end = fb->address + (uint64_t)fb->pitch * fb->height;
+    page_range(start, start, end - start, MAP_WRITE | MAP_CACHE_WC);
+
+    uint32_t foreground = pack(FOREGROUND_RGB);
+    uint32_t background = pack(BACKGROUND_RGB);
+    for (uint32_t bits = 0; bits < 16; bits++)
+        for (uint32_t x = 0; x < 4; x++)
+            nibbles[bits][x] = (bits & (8 >> x)) ? foreground : background;
+
+    glyphHeight = ROM_FONT_HEIGHT;
+    active = true;
+
+    // clear what the BIOS left, the console redraws its lines afterwards
+    for (uint32_t y = 0; y < fb->height; y++)
+        memset((void*)(fb->address + (uint64_t)y * fb->pitch), 0, fb->width * 4);
+    return true;
+}
+
+bool framebuffer_active()
+{
+    return active;
+}
+
+/*
+ * Read the glyphs of an 8 pixel wide font, one byte per row. They are
+ * staged in scratch memory so a short file leaves the current font alone.
+ */
+static bool take_font(fatFS* fs, FAT_File* file, uint32_t height, uint32_t glyphSize)
+{
+    if (height == 0 || height > MAX_FONT_HEIGHT || glyphSize != height)
+    {
+        puts("FONT: needs an 8 pixel wide font at most 32 lines tall\n");
+        return false;
+    }
+
+    uint32_t size = GLYPH_COUNT * height;
+    if (fs->read(file, size, (void*)MEMORY_SCRATCH_START) != size)
+    {
+        puts("FONT: truncated\n");
+        return false;
+    }
+
+    memcpy(glyphs, (void*)MEMORY_SCRATCH_START, size);
+    glyphHeight = height;
+    return true;
+}
+
+bool framebuffer_load_font(fatFS* fs)
+{
+    if (!active)
+        return false;
+
+    FAT_File* file = fs->open(FRAMEBUFFER_FONT_PATH);
+    if (file == NULL)
+        return false;
+
+    bool loaded = false;
+    union
+    {
+        psf1_header psf1;
+        psf2_header psf2;
+    } header;
+    uint32_t length = fs->read(file, sizeof(header), &header);
+
+    if (length >= sizeof(psf1_header) && header.psf1.magic == PSF1_MAGIC)
+    {
+        loaded = fs->seek(file, sizeof(psf1_header)) &&
+                 take_font(fs, file, header.psf1.height, header.psf1.height);
+    }
+    else if (length == sizeof(psf2_header) && header.psf2.magic == PSF2_MAGIC &&
+             header.psf2.width <= GLYPH_WIDTH && header.psf2.glyphCount >= GLYPH_COUNT)
+    {
+        loaded = fs->seek(file, header.psf2.headerSize) &&
+                 take_font(fs, file, header.psf2.height, header.psf2.glyphSize);
+    }
+    else
+    {
+        puts("FONT: not a PSF font\n");
+    }
+
+    fs->close(file);
+    return loaded;
+}
+
+void framebuffer_draw_line(uint32_t y, const uint16_t* cells, uint32_t count)
+{
+    const vbe_framebuffer_info* fb = &vbe_framebuffer;
+    if (!active || (y + 1) * glyphHeight > fb->height)
+        return;
+    if (count * GLYPH_WIDTH > fb->width)
+        count = fb->width / GLYPH_WIDTH;
+
+    for (uint32_t row = 0; row < glyphHeight; row++)
+    {
+        volatile uint64_t* out = (volatile uint64_t*)(fb->address + (uint64_t)(y * glyphHeight + row) * fb->pitch);
+
+        for (uint32_t x = 0; x < count; x++)
+        {
+            uint8_t bits = glyphs[(uint8_t)cells[x] * glyphHeight + row];
+            const uint64_t* left = (const uint64_t*)nibbles[bits >> 4];
+            const uint64_t* right = (const uint64_t*)nibbles[bits & 0xF];
+            out[0] = left[0];
+            out[1] = left[1];
+            out[2] = right[0];
+            out[3] = right[1];
+            out += 4;
+        }
+    }
+}
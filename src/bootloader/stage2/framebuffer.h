@@ -0,0 +1,94 @@
+/**
+ * @file framebuffer.h
+ * @author Aidcraft
+ * @brief draws the console on the linear framebuffer set up through VBE
+ * @version 0.0.2
+ * @date 2025-03-19
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#pragma once
+
+#include "stdint.h"
+#include "fs/FAT/fat.h"
+
+/// @brief Optional PSF1/PSF2 font replacing the 8x16 ROM font
+#define FRAMEBUFFER_FONT_PATH "boot/font.psf"
+
+#define PSF1_MAGIC      0x0436
+#define PSF1_MODE_512   0x01
+#define PSF2_MAGIC      0x864AB572
+
+/// @brief Mode recorded by set_vbe_mode (16-Real/vbe.asm)
+typedef struct
+{
+    /// @brief physical address, 0 when the screen is in text mode
+    uint64_t address;
+    uint32_t pitch;
+    uint32_t width;
+    uint32_t height;
+    uint8_t bpp;
+    uint8_t redPosition;
+    uint8_t redSize;
+    uint8_t greenPosition;
+    uint8_t greenSize;
+    uint8_t bluePosition;
+    uint8_t blueSize;
+    uint16_t mode;
+} __attribute__((packed)) vbe_framebuffer_info;
+
+extern "C" vbe_framebuffer_info vbe_framebuffer;
+
+typedef struct
+{
+    uint16_t magic;
+    uint8_t mode;
+    uint8_t height;
+} __attribute__((packed)) psf1_header;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t flags;
+    uint32_t glyphCount;
+    uint32_t glyphSize;
+    uint32_t height;
+    uint32_t width;
+} __attribute__((packed)) psf2_header;
+
+/**
+ * @brief Maps the framebuffer write-combining and takes over the console
+ * @details Needs paging, call after init_map. Uses the ROM font until
+ * framebuffer_load_font finds a better one.
+ *
+ * @return bool false if the screen is in text mode
+ */
+bool framebuffer_init();
+
+/// @brief Whether the console draws on the framebuffer
+bool framebuffer_active();
+
+/**
+ * @brief Loads FRAMEBUFFER_FONT_PATH if the volume has it
+ * @details Fonts must be 8 pixels wide and at most 32 tall, only the
+ * first 256 glyphs are used.
+ *
+ * @param[in] fs the boot volume
+ * @return bool true if the font was replaced
+ */
+bool framebuffer_load_font(fatFS* fs);
+
+/**
+ * @brief Draws a line of text cells, the low byte of each cell is the character
+ *
+ * @param[in] y text line
+ * @param[in] cells the characters
+ * @param[in] count number of cells
+ */
+void framebuffer_draw_line(uint32_t y, const uint16_t* cells, uint32_t count);
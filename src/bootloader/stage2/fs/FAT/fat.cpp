@@ -12,6 +12,9 @@
 #define MAX_FILE_HANDLES 10
 #define ROOT_DIRECTORY_HANDLE -1
 #define FAT_CACHE_SIZE 5
+#define NO_BUFFERED_LBA 0xFFFFFFFF
+/// @brief Chain values at or above this end the file, every width is widened to it
+#define FAT_CHAIN_END 0xFFFFFFF8
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 #define max(a, b) ((a) > (b) ? (a) : (b))
@@ -67,7 +70,7 @@ typedef struct
 
 } __attribute__((packed)) FAT_BootSector;
 
-typedef struct
+typedef struct FAT_FileData
 {
     uint8_t Buffer[SECTOR_SIZE];
     FAT_File Public;
@@ -75,6 +78,9 @@ typedef struct
     uint32_t FirstCluster;
     uint32_t CurrentCluster;
     uint32_t CurrentSectorInCluster;
+    uint32_t BufferedLba;
+    /// @brief last cluster of the contiguous run CurrentCluster is in, as far as it has been scanned
+    uint32_t RunLast;
 
 } FAT_FileData;
 
@@ -100,11 +106,164 @@ static uint32_t g_DataSectionLba;
 static uint32_t g_TotalSectors;
 static uint32_t g_SectorsPerFat;
 
-fatFS::fatFS(Partition *Disk)
+/// @brief Loads that may straddle entries and don't assume alignment
+typedef uint64_t fat_word __attribute__((may_alias, aligned(1)));
+
+/*
+ * Entry layouts of the three FAT widths, the chain walkers below are
+ * instantiated once per width. offset() is where a cluster's entry starts,
+ * decode() reads it with end of chain values widened to FAT_CHAIN_END and
+ * up, match() counts how many entries from cluster on point at the cluster
+ * right after their own. below() is the first cluster whose entry doesn't
+ * end within the first end bytes of the FAT.
+ */
+struct fat12
+{
+    static const uint32_t ENTRY_BYTES = 2;
+
+    static uint32_t offset(uint32_t cluster)
+    {
+        return cluster * 3 / 2;
+    }
+
+    static uint32_t below(uint32_t end)
+    {
+        uint32_t cluster = end * 2 / 3;
+        while (cluster > 0 && offset(cluster - 1) + ENTRY_BYTES > end)
+            cluster--;
+        while (offset(cluster) + ENTRY_BYTES <= end)
+            cluster++;
+        return cluster;
+    }
+
+    static uint32_t decode(const uint8_t* entry, uint32_t cluster)
+    {
+        uint16_t value = *(const uint16_t*)entry;
+        uint32_t next = (cluster % 2 == 0) ? value & 0x0FFF : value >> 4;
+        return next >= 0xFF8 ? next | 0xFFFFF000 : next;
+    }
+
+    static uint32_t match(const uint8_t* cache, uint32_t cacheStart, uint32_t cluster, uint32_t count)
+    {
+        uint32_t done = 0;
+        while (done < count && decode(cache + offset(cluster + done) - cacheStart, cluster + done) == cluster + done + 1)
+            done++;
+        return done;
+    }
+};
+
+struct fat16
+{
+    static const uint32_t ENTRY_BYTES = 2;
+    /// @brief adds 4 to every entry of a word
+    static const uint64_t STEP = 0x0004000400040004;
+
+    static uint32_t offset(uint32_t cluster)
+    {
+        return cluster * 2;
+    }
+
+    static uint32_t below(uint32_t end)
+    {
+        return end / 2;
+    }
+
+    static uint32_t decode(const uint8_t* entry, uint32_t)
+    {
+        uint32_t next = *(const uint16_t*)entry;
+        return next >= 0xFFF8 ? next | 0xFFFF0000 : next;
+    }
+
+    /*
+     * Four entries per 64-bit compare, sixteen per round. A lane that
+     * would pass 0xFFFF carries into its neighbour and just fails the
+     * compare, the scalar tail sorts it out.
+     */
+    static uint32_t match(const uint8_t* cache, uint32_t cacheStart, uint32_t cluster, uint32_t count)
+    {
+        const uint8_t* entries = cache + offset(cluster) - cacheStart;
+        uint64_t expected = (uint64_t)(cluster + 1) | (uint64_t)(cluster + 2) << 16 |
+                            (uint64_t)(cluster + 3) << 32 | (uint64_t)(cluster + 4) << 48;
+        uint32_t done = 0;
+
+        while (count - done >= 16)
+        {
+            const fat_word* words = (const fat_word*)(entries + done * 2);
+            uint64_t diff = (words[0] ^ expected) | (words[1] ^ (expected + STEP)) |
+                            (words[2] ^ (expected + 2 * STEP)) | (words[3] ^ (expected + 3 * STEP));
+            if (diff != 0)
+                break;
+            done += 16;
+            expected += 4 * STEP;
+        }
+
+        while (done < count && decode(entries + done * 2, 0) == cluster + done + 1)
+            done++;
+        return done;
+    }
+};
+
+struct fat32
+{
+    static const uint32_t ENTRY_BYTES = 4;
+    /// @brief adds 2 to both entries of a word
+    static const uint64_t STEP = 0x0000000200000002;
+    /// @brief the top 4 bits of a FAT32 entry are reserved
+    static const uint64_t MASK = 0x0FFFFFFF0FFFFFFF;
+
+    static uint32_t offset(uint32_t cluster)
+    {
+        return cluster * 4;
+    }
+
+    static uint32_t below(uint32_t end)
+    {
+        return end / 4;
+    }
+
+    static uint32_t decode(const uint8_t* entry, uint32_t)
+    {
+        uint32_t next = *(const uint32_t*)entry & 0x0FFFFFFF;
+        return next >= 0x0FFFFFF8 ? next | 0xF0000000 : next;
+    }
+
+    /*
+     * Two entries per 64-bit compare, eight per round. Stage2 never turns
+     * on SSE, general purpose registers are what there is.
+     */
+    static uint32_t match(const uint8_t* cache, uint32_t cacheStart, uint32_t cluster, uint32_t count)
+    {
+        const uint8_t* entries = cache + offset(cluster) - cacheStart;
+        uint64_t expected = (uint64_t)(cluster + 1) | (uint64_t)(cluster + 2) << 32;
+        uint32_t done = 0;
+
+        while (count - done >= 8)
+        {
+            const fat_word* words = (const fat_word*)(entries + done * 4);
+            uint64_t diff = (words[0] ^ expected) | (words[1] ^ (expected + STEP)) |
+                            (words[2] ^ (expected + 2 * STEP)) | (words[3] ^ (expected + 3 * STEP));
+            if ((diff & MASK) != 0)
+                break;
+            done += 8;
+            expected += 4 * STEP;
+        }
+
+        while (done < count && decode(entries + done * 4, 0) == cluster + done + 1)
+            done++;
+        return done;
+    }
+};
+
+fatFS::fatFS(Partition *Disk) : Exfat(Disk)
 {
     this->Disk = Disk;
 }
 
+uint8_t fatFS::type()
+{
+    return this->FatType;
+}
+
 bool fatFS::readBootSector()
 {
     return this->Disk->Partition_Read(&g_Data->BS, 1, 0);
@@ -119,11 +278,23 @@ void fatFS::FAT_Detect()
 {
     uint32_t dataClusters = (g_TotalSectors - g_DataSectionLba) / g_Data->BS.BootSector.SectorsPerCluster;
     if (dataClusters < 0xFF5)
+    {
         this->FatType = 12;
+        this->chainNext = &fatFS::nextClusterOf<fat12>;
+        this->chainRun = &fatFS::runOf<fat12>;
+    }
     else if (g_Data->BS.BootSector.SectorsPerFat != 0)
+    {
         this->FatType = 16;
+        this->chainNext = &fatFS::nextClusterOf<fat16>;
+        this->chainRun = &fatFS::runOf<fat16>;
+    }
     else
+    {
         this->FatType = 32;
+        this->chainNext = &fatFS::nextClusterOf<fat32>;
+        this->chainRun = &fatFS::runOf<fat32>;
+    }
 }
 
 bool fatFS::Init()
@@ -137,6 +308,12 @@ bool fatFS::Init()
         return false;
     }
 
+    if (exfatFS::detect(g_Data->BS.BootSectorBytes))
+    {
+        this->FatType = FAT_TYPE_EXFAT;
+        return this->Exfat.Init();
+    }
+
     g_Data->FatCachePosition = 0xFFFFFFFF;
 
     g_TotalSectors = g_Data->BS.BootSector.TotalSectors;
@@ -156,10 +333,12 @@ bool fatFS::Init()
     // open root directory file
     uint32_t rootDirLba;
     uint32_t rootDirSize;
+    uint32_t rootDirCluster;
     if (isFat32)
     {
         g_DataSectionLba = g_Data->BS.BootSector.ReservedSectors + g_SectorsPerFat * g_Data->BS.BootSector.FatCount;
-        rootDirLba = this->clusterToLba(g_Data->BS.BootSector.EBR32.RootDirectoryCluster);
+        rootDirCluster = g_Data->BS.BootSector.EBR32.RootDirectoryCluster;
+        rootDirLba = this->clusterToLba(rootDirCluster);
         rootDirSize = 0;
     }
     else
@@ -168,6 +347,8 @@ bool fatFS::Init()
         rootDirSize = sizeof(FAT_DirectoryEntry) * g_Data->BS.BootSector.DirEntryCount;
         uint32_t rootDirSectors = (rootDirSize + g_Data->BS.BootSector.BytesPerSector - 1) / g_Data->BS.BootSector.BytesPerSector;
         g_DataSectionLba = rootDirLba + rootDirSectors;
+        // the FAT12/16 root directory is a fixed run of sectors, track it by lba
+        rootDirCluster = rootDirLba;
     }
 
     g_Data->RootDirectory.Public.Handle = ROOT_DIRECTORY_HANDLE;
@@ -175,9 +356,11 @@ bool fatFS::Init()
     g_Data->RootDirectory.Public.Position = 0;
     g_Data->RootDirectory.Public.Size = sizeof(FAT_DirectoryEntry) * g_Data->BS.BootSector.DirEntryCount;
     g_Data->RootDirectory.Opened = true;
-    g_Data->RootDirectory.FirstCluster = rootDirLba;
-    g_Data->RootDirectory.CurrentCluster = rootDirLba;
+    g_Data->RootDirectory.FirstCluster = rootDirCluster;
+    g_Data->RootDirectory.CurrentCluster = rootDirCluster;
     g_Data->RootDirectory.CurrentSectorInCluster = 0;
+    g_Data->RootDirectory.BufferedLba = rootDirLba;
+    g_Data->RootDirectory.RunLast = rootDirCluster;
 
     if (!this->Disk->Partition_Read(&g_Data->RootDirectory.Buffer, 1, rootDirLba))
     {
@@ -195,6 +378,9 @@ bool fatFS::Init()
 
 FAT_File *fatFS::open(const char *path)
 {
+    if (this->FatType == FAT_TYPE_EXFAT)
+        return this->Exfat.open(path);
+
     char name[MAX_PATH_SIZE];
 
     // ignore leading slash
@@ -218,7 +404,7 @@ FAT_File *fatFS::open(const char *path)
         {
             unsigned len = strlen(path);
             memcpy(name, path, len);
-            name[len + 1] = '\0';
+            name[len] = '\0';
             path += len;
             isLast = true;
         }
@@ -229,7 +415,7 @@ FAT_File *fatFS::open(const char *path)
             this->close(current);
 
             // check if directory
-            if (!isLast && entry.Attributes & FAT_ATTRIBUTE_DIRECTORY == 0)
+            if (!isLast && (entry.Attributes & FAT_ATTRIBUTE_DIRECTORY) == 0)
             {
                 puts("FAT: not a directory\r\n");
                 return NULL;
@@ -292,12 +478,32 @@ bool fatFS::readEntry(FAT_File *file, FAT_DirectoryEntry *dirEntry)
     return output;
 }
 
+FAT_FileData *fatFS::fileData(FAT_File *file)
+{
+    return (file->Handle == ROOT_DIRECTORY_HANDLE)
+               ? &g_Data->RootDirectory
+               : &g_Data->OpenedFiles[file->Handle];
+}
+
+bool fatFS::isFixedRoot(FAT_FileData *fd)
+{
+    return fd->Public.Handle == ROOT_DIRECTORY_HANDLE && this->FatType != 32;
+}
+
+uint32_t fatFS::currentLba(FAT_FileData *fd)
+{
+    if (this->isFixedRoot(fd))
+        return fd->CurrentCluster + fd->CurrentSectorInCluster;
+    return this->clusterToLba(fd->CurrentCluster) + fd->CurrentSectorInCluster;
+}
+
 uint32_t fatFS::read(FAT_File *file, uint32_t byteCount, void *dataOut)
 {
+    if (this->FatType == FAT_TYPE_EXFAT)
+        return this->Exfat.read(file, byteCount, dataOut);
+
     // get file data
-    FAT_FileData *fd = (file->Handle == ROOT_DIRECTORY_HANDLE)
-                           ? &g_Data->RootDirectory
-                           : &g_Data->OpenedFiles[file->Handle];
+    FAT_FileData *fd = this->fileData(file);
 
     uint8_t *u8DataOut = (uint8_t *)dataOut;
 
@@ -307,98 +513,280 @@ uint32_t fatFS::read(FAT_File *file, uint32_t byteCount, void *dataOut)
 
     while (byteCount > 0)
     {
-        uint32_t leftInBuffer = SECTOR_SIZE - (fd->Public.Position % SECTOR_SIZE);
-        uint32_t take = min(byteCount, leftInBuffer);
+        uint32_t offset = fd->Public.Position % SECTOR_SIZE;
+        uint32_t lba = this->currentLba(fd);
+        uint32_t take;
+        uint32_t sectorsDone;
 
-        memcpy(u8DataOut, fd->Buffer + fd->Public.Position % SECTOR_SIZE, take);
-        u8DataOut += take;
-        fd->Public.Position += take;
-        byteCount -= take;
-
-        // printf("leftInBuffer=%lu take=%lu\r\n", leftInBuffer, take);
-        // See if we need to read more data
-        if (leftInBuffer == take)
+        if (offset == 0 && byteCount >= SECTOR_SIZE)
         {
-            // calculate next cluster & sector to read
-            if (++fd->CurrentSectorInCluster >= g_Data->BS.BootSector.SectorsPerCluster)
-            {
-                fd->CurrentSectorInCluster = 0;
-                fd->CurrentCluster = this->nextCluster(fd->CurrentCluster);
-            }
+            // whole sectors go straight to the caller, as many as the contiguous run allows
+            uint32_t sectors = this->runSectors(fd, byteCount / SECTOR_SIZE);
 
-            if (fd->CurrentCluster >= 0xFFFFFFF8)
+            if (!this->Disk->Partition_Read(u8DataOut, sectors, lba))
             {
-                // Mark end of file
-                fd->Public.Size = fd->Public.Position;
+                printf("FAT: read error!\r\n");
                 break;
             }
 
-            // read next sector
-            if (!this->Disk->Partition_Read(fd->Buffer, 1, this->clusterToLba(fd->CurrentCluster) + fd->CurrentSectorInCluster))
+            take = sectors * SECTOR_SIZE;
+            sectorsDone = sectors;
+        }
+        else
+        {
+            if (fd->BufferedLba == lba)
             {
-                printf("FAT: read error!\r\n");
-                break;
+                this->Disk->Partition_CacheHit();
+            }
+            else
+            {
+                if (!this->Disk->Partition_Read(fd->Buffer, 1, lba))
+                {
+                    printf("FAT: read error!\r\n");
+                    break;
+                }
+                fd->BufferedLba = lba;
             }
+
+            take = min(byteCount, SECTOR_SIZE - offset);
+            memcpy(u8DataOut, fd->Buffer + offset, take);
+            sectorsDone = (offset + take == SECTOR_SIZE) ? 1 : 0;
+        }
+
+        u8DataOut += take;
+        fd->Public.Position += take;
+        byteCount -= take;
+
+        if (sectorsDone != 0 && !this->advance(fd, sectorsDone))
+        {
+            // Mark end of file
+            fd->Public.Size = fd->Public.Position;
+            break;
         }
     }
 
     return u8DataOut - (uint8_t *)dataOut;
 }
 
-uint32_t fatFS::nextCluster(uint32_t currentCluster)
+/*
+ * Limits a transfer of sectors from the current sector on to the
+ * contiguous run the current cluster is in, scanning the FAT for as much
+ * of the run as the transfer could use.
+ */
+uint32_t fatFS::runSectors(FAT_FileData *fd, uint32_t sectors)
 {
-    // Determine the byte offset of the entry we need to read
-    uint32_t fatIndex;
-    if (this->FatType == 12)
+    if (this->isFixedRoot(fd))
+        return sectors;
+
+    uint32_t sectorsPerCluster = g_Data->BS.BootSector.SectorsPerCluster;
+    if (fd->RunLast == fd->CurrentCluster)
     {
-        fatIndex = currentCluster * 3 / 2;
+        uint32_t clustersWanted = (fd->CurrentSectorInCluster + sectors - 1) / sectorsPerCluster;
+        fd->RunLast = fd->CurrentCluster + this->clusterRun(fd->CurrentCluster, clustersWanted);
     }
-    else if (this->FatType == 16)
+    uint32_t available = (fd->RunLast - fd->CurrentCluster + 1) * sectorsPerCluster - fd->CurrentSectorInCluster;
+    return min(sectors, available);
+}
+
+/*
+ * Moves the current sector on by sectors, which never go past the run.
+ * False when that leaves the end of the chain.
+ */
+bool fatFS::advance(FAT_FileData *fd, uint32_t sectors)
+{
+    uint32_t sectorsPerCluster = g_Data->BS.BootSector.SectorsPerCluster;
+
+    // calculate next cluster & sector to read
+    fd->CurrentSectorInCluster += sectors;
+    if (this->isFixedRoot(fd) || fd->CurrentSectorInCluster < sectorsPerCluster)
+        return true;
+
+    // inside the run the next clusters are known
+    uint32_t clusters = fd->CurrentSectorInCluster / sectorsPerCluster;
+    fd->CurrentSectorInCluster %= sectorsPerCluster;
+    if (fd->CurrentCluster + clusters <= fd->RunLast)
     {
-        fatIndex = currentCluster * 2;
+        fd->CurrentCluster += clusters;
+        return true;
     }
-    else /*if (this->FatType == 32)*/
+
+    fd->CurrentCluster = this->nextCluster(fd->RunLast);
+    fd->RunLast = fd->CurrentCluster;
+    return fd->CurrentCluster < FAT_CHAIN_END;
+}
+
+/*
+ * Only whole sectors inside the file's current size are written, through
+ * the clusters its chain already has. The FAT and the directory entry are
+ * never touched, so an interrupted write can only leave stale file data.
+ */
+uint32_t fatFS::write(FAT_File *file, uint32_t byteCount, const void *dataIn)
+{
+    if (this->FatType == FAT_TYPE_EXFAT)
     {
-        fatIndex = currentCluster * 4;
+        puts("FAT: exFAT volumes are read only\r\n");
+        return 0;
     }
 
-    // Make sure cache has the right number
-    uint32_t fatIndexSector = fatIndex / SECTOR_SIZE;
-    if (fatIndexSector < g_Data->FatCachePosition || fatIndexSector >= g_Data->FatCachePosition + FAT_CACHE_SIZE)
+    FAT_FileData *fd = this->fileData(file);
+    if (fd->Public.IsDirectory || fd->Public.Position % SECTOR_SIZE != 0 || byteCount % SECTOR_SIZE != 0 ||
+        byteCount > fd->Public.Size - fd->Public.Position)
     {
-        this->readFat(fatIndexSector);
-        g_Data->FatCachePosition = fatIndexSector;
+        puts("FAT: only whole sectors inside a file can be written\r\n");
+        return 0;
     }
 
-    fatIndex -= (g_Data->FatCachePosition * SECTOR_SIZE);
+    const uint8_t *u8DataIn = (const uint8_t *)dataIn;
 
-    uint32_t nextCluster;
-    if (this->FatType == 12)
-    {
-        if (currentCluster % 2 == 0)
-            nextCluster = (*(uint16_t *)(g_Data->FatCache + fatIndex)) & 0x0FFF;
-        else
-            nextCluster = (*(uint16_t *)(g_Data->FatCache + fatIndex)) >> 4;
+    // the buffer may hold a sector about to change
+    fd->BufferedLba = NO_BUFFERED_LBA;
 
-        if (nextCluster >= 0xFF8)
+    while (byteCount > 0)
+    {
+        uint32_t sectors = this->runSectors(fd, byteCount / SECTOR_SIZE);
+        if (!this->Disk->Partition_Write(u8DataIn, sectors, this->currentLba(fd)))
         {
-            nextCluster |= 0xFFFFF000;
+            printf("FAT: write error!\r\n");
+            break;
         }
+
+        uint32_t take = sectors * SECTOR_SIZE;
+        u8DataIn += take;
+        fd->Public.Position += take;
+        byteCount -= take;
+
+        if (!this->advance(fd, sectors))
+            break;
     }
-    else if (this->FatType == 16)
+
+    return u8DataIn - (const uint8_t *)dataIn;
+}
+
+bool fatFS::seek(FAT_File *file, uint64_t position)
+{
+    if (this->FatType == FAT_TYPE_EXFAT)
+        return this->Exfat.seek(file, position);
+
+    FAT_FileData *fd = this->fileData(file);
+
+    // FAT sizes are 32-bit, even a directory of unknown size can't reach this far
+    if ((fd->Public.Size != 0 && position > fd->Public.Size) || position > 0xFFFFFFFF)
+        return false;
+
+    if (this->isFixedRoot(fd))
+    {
+        fd->CurrentSectorInCluster = position / SECTOR_SIZE;
+        fd->Public.Position = position;
+        return true;
+    }
+
+    uint32_t clusterBytes = g_Data->BS.BootSector.SectorsPerCluster * SECTOR_SIZE;
+    uint32_t currentIndex = fd->Public.Position / clusterBytes;
+    uint32_t targetIndex = position / clusterBytes;
+
+    // the chain only goes forward, so rewind to go back
+    if (targetIndex < currentIndex)
+    {
+        fd->CurrentCluster = fd->FirstCluster;
+        fd->RunLast = fd->FirstCluster;
+        currentIndex = 0;
+    }
+
+    while (currentIndex < targetIndex)
     {
-        nextCluster = *(uint16_t *)(g_Data->FatCache + fatIndex);
-        if (nextCluster >= 0xFFF8)
+        if (fd->CurrentCluster >= FAT_CHAIN_END)
+            return false;
+
+        // contiguous clusters are skipped without reading their entries
+        if (fd->RunLast == fd->CurrentCluster)
+            fd->RunLast = fd->CurrentCluster + this->clusterRun(fd->CurrentCluster, targetIndex - currentIndex);
+        uint32_t step = min(targetIndex - currentIndex, fd->RunLast - fd->CurrentCluster);
+        if (step != 0)
         {
-            nextCluster |= 0xFFFF0000;
+            fd->CurrentCluster += step;
+            currentIndex += step;
+            continue;
         }
+
+        fd->CurrentCluster = this->nextCluster(fd->CurrentCluster);
+        fd->RunLast = fd->CurrentCluster;
+        currentIndex++;
+    }
+
+    fd->CurrentSectorInCluster = (position % clusterBytes) / SECTOR_SIZE;
+    fd->Public.Position = position;
+    return true;
+}
+
+uint32_t fatFS::nextCluster(uint32_t currentCluster)
+{
+    return (this->*chainNext)(currentCluster);
+}
+
+/*
+ * Number of clusters from cluster on, at most limit, whose entries point
+ * at the cluster right after them. cluster + clusterRun() is the last
+ * cluster of the run.
+ */
+uint32_t fatFS::clusterRun(uint32_t cluster, uint32_t limit)
+{
+    return (this->*chainRun)(cluster, limit);
+}
+
+/*
+ * Make sure bytes FAT bytes from offset are in the cache, reading the
+ * sectors from the one holding offset on when they aren't.
+ */
+bool fatFS::loadFat(uint32_t offset, uint32_t bytes)
+{
+    uint32_t first = offset / SECTOR_SIZE;
+    uint32_t last = (offset + bytes - 1) / SECTOR_SIZE;
+    if (g_Data->FatCachePosition != NO_BUFFERED_LBA && first >= g_Data->FatCachePosition &&
+        last < g_Data->FatCachePosition + FAT_CACHE_SIZE)
+    {
+        this->Disk->Partition_CacheHit();
+        return true;
     }
-    else /*if (this->FatType == 32)*/
+
+    if (!this->readFat(first))
     {
-        nextCluster = *(uint32_t *)(g_Data->FatCache + fatIndex);
+        g_Data->FatCachePosition = NO_BUFFERED_LBA;
+        return false;
     }
+    g_Data->FatCachePosition = first;
+    return true;
+}
 
-    return nextCluster;
+template <typename Fat>
+uint32_t fatFS::nextClusterOf(uint32_t cluster)
+{
+    uint32_t offset = Fat::offset(cluster);
+    if (!this->loadFat(offset, Fat::ENTRY_BYTES))
+        return FAT_CHAIN_END;
+    return Fat::decode(g_Data->FatCache + offset - g_Data->FatCachePosition * SECTOR_SIZE, cluster);
+}
+
+template <typename Fat>
+uint32_t fatFS::runOf(uint32_t cluster, uint32_t limit)
+{
+    uint32_t count = 0;
+    while (count < limit)
+    {
+        uint32_t current = cluster + count;
+        if (!this->loadFat(Fat::offset(current), Fat::ENTRY_BYTES))
+            break;
+
+        // only entries that lie wholly inside the cached sectors are compared
+        uint32_t cacheStart = g_Data->FatCachePosition * SECTOR_SIZE;
+        uint32_t cached = Fat::below(cacheStart + FAT_CACHE_SIZE * SECTOR_SIZE) - current;
+        uint32_t wanted = min(limit - count, cached);
+
+        uint32_t matched = Fat::match(g_Data->FatCache, cacheStart, current, wanted);
+        count += matched;
+        if (matched < wanted)
+            break;
+    }
+    return count;
 }
 
 bool fatFS::readFat(uint32_t lbaIndex)
@@ -408,10 +796,18 @@ bool fatFS::readFat(uint32_t lbaIndex)
 
 void fatFS::close(FAT_File *file)
 {
+    if (this->FatType == FAT_TYPE_EXFAT)
+    {
+        this->Exfat.close(file);
+        return;
+    }
+
     if (file->Handle == ROOT_DIRECTORY_HANDLE)
     {
         file->Position = 0;
         g_Data->RootDirectory.CurrentCluster = g_Data->RootDirectory.FirstCluster;
+        g_Data->RootDirectory.RunLast = g_Data->RootDirectory.FirstCluster;
+        g_Data->RootDirectory.CurrentSectorInCluster = 0;
     }
     else
     {
@@ -445,8 +841,10 @@ FAT_File *fatFS::openEntry(FAT_DirectoryEntry *entry)
     fd->FirstCluster = entry->FirstClusterLow + ((uint32_t)entry->FirstClusterHigh << 16);
     fd->CurrentCluster = fd->FirstCluster;
     fd->CurrentSectorInCluster = 0;
+    fd->BufferedLba = this->clusterToLba(fd->CurrentCluster);
+    fd->RunLast = fd->FirstCluster;
 
-    if (!this->Disk->Partition_Read(fd->Buffer, 1, this->clusterToLba(fd->CurrentCluster)))
+    if (!this->Disk->Partition_Read(fd->Buffer, 1, fd->BufferedLba))
     {
         printf("FAT: open entry failed - read error cluster=%u lba=%u\n", fd->CurrentCluster, this->clusterToLba(fd->CurrentCluster));
         for (int i = 0; i < 11; i++)
@@ -18,6 +18,10 @@
 #include "../../string.h"
 #include "../../mbr.h"
 #include "../../memory/memory.h"
+#include "../exFAT/exfat.h"
+
+/// @brief type() of an exFAT volume, which fatFS hands over to exfatFS
+#define FAT_TYPE_EXFAT 64
 
 typedef struct 
 {
@@ -35,12 +39,13 @@ typedef struct
     uint32_t Size;
 } __attribute__((packed)) FAT_DirectoryEntry;
 
-typedef struct 
+/// @brief Open file, positions are 64-bit since exFAT files can pass 4 GiB
+typedef struct FAT_File
 {
     int Handle;
     bool IsDirectory;
-    uint32_t Position;
-    uint32_t Size;
+    uint64_t Position;
+    uint64_t Size;
 } FAT_File;
 
 enum FAT_Attributes
@@ -54,11 +59,18 @@ enum FAT_Attributes
     FAT_ATTRIBUTE_LFN               = FAT_ATTRIBUTE_READ_ONLY | FAT_ATTRIBUTE_HIDDEN | FAT_ATTRIBUTE_SYSTEM | FAT_ATTRIBUTE_VOLUME_ID
 };
 
+struct FAT_FileData;
+
 class fatFS
 {
 private:
     Partition* Disk;
     uint8_t FatType;
+    exfatFS Exfat;
+
+    /// @brief chain walkers for FatType, picked once by FAT_Detect
+    uint32_t (fatFS::*chainNext)(uint32_t cluster);
+    uint32_t (fatFS::*chainRun)(uint32_t cluster, uint32_t limit);
 
     bool readBootSector();
     uint32_t clusterToLba(uint32_t cluster);
@@ -66,9 +78,17 @@ private:
     bool findFile(FAT_File* file, const char* name, FAT_DirectoryEntry* entryOut);
     bool readEntry(FAT_File* file, FAT_DirectoryEntry* entry);
     uint32_t nextCluster(uint32_t currentCluster);
+    uint32_t clusterRun(uint32_t cluster, uint32_t limit);
+    template <typename Fat> uint32_t nextClusterOf(uint32_t cluster);
+    template <typename Fat> uint32_t runOf(uint32_t cluster, uint32_t limit);
+    bool loadFat(uint32_t offset, uint32_t bytes);
     bool readFat(uint32_t fatIndex);
-    void close(FAT_File* file);
     FAT_File* openEntry(FAT_DirectoryEntry* entry);
+    FAT_FileData* fileData(FAT_File* file);
+    bool isFixedRoot(FAT_FileData* fd);
+    uint32_t currentLba(FAT_FileData* fd);
+    uint32_t runSectors(FAT_FileData* fd, uint32_t sectors);
+    bool advance(FAT_FileData* fd, uint32_t sectors);
 
 public:
 
@@ -79,6 +99,23 @@ public:
     /// @return number of bytes read
     uint32_t read(FAT_File* file, uint32_t byteCount, void* dataOut);
 
+    /// @brief Overwrites a file in place from its read position, it is never extended or moved
+    /// @param file File descriptor, its position must be on a sector boundary
+    /// @param byteCount number of bytes to write, whole sectors that end within the file's size
+    /// @param dataIn buffer to write from
+    /// @return number of bytes written
+    uint32_t write(FAT_File* file, uint32_t byteCount, const void* dataIn);
+
+    /// @brief Moves the read position of a file
+    /// @param file File descriptor
+    /// @param position Byte offset from the start of the file
+    /// @return Success or failure (past the end of the file or chain)
+    bool seek(FAT_File* file, uint64_t position);
+
+    /// @brief Closes a file and frees its handle
+    /// @param file File descriptor
+    void close(FAT_File* file);
+
     /// @brief Opens a file
     /// @param disk Pointer to the disk
     /// @param path Path to the file
@@ -92,4 +129,8 @@ public:
     /// @brief Initializes the FAT file system
     /// @return Success or failure
     bool Init();
+
+    /// @brief FAT variant found by Init
+    /// @return 12, 16, 32 or FAT_TYPE_EXFAT
+    uint8_t type();
 };
@@ -0,0 +1,814 @@
+#include "exfat.h"
+
+#include "../FAT/fat.h"
+#include "../../stdint.h"
+#include "../../stdio.h"
+#include "../../stddef.h"
+#include "../../string.h"
+#include "../../mbr.h"
+#include "../../memory/memory.h"
+
+#define SECTOR_SIZE 512
+#define SECTOR_SHIFT 9
+#define MAX_PATH_SIZE 256
+#define MAX_FILE_HANDLES 10
+#define ROOT_DIRECTORY_HANDLE -1
+#define BITMAP_HANDLE -2
+#define FAT_CACHE_SIZE 4
+#define NO_BUFFERED_LBA 0xFFFFFFFF
+/// @brief Main boot sector, 8 extended boot sectors, OEM parameters, reserved and the checksum sector
+#define BOOT_REGION_SECTORS 12
+/// @brief Largest cluster the spec allows, 32MB
+#define MAX_CLUSTER_SHIFT 25
+/// @brief FAT values from here on are bad clusters or end the chain
+#define EXFAT_CHAIN_END 0xFFFFFFF7
+/// @brief Characters whose up-case mapping is kept, stage2 only looks up ASCII paths
+#define UPCASE_CHARS 256
+#define NAME_CHARS_PER_ENTRY 15
+
+#define EXFAT_ENTRY_END         0x00
+#define EXFAT_ENTRY_IN_USE      0x80
+#define EXFAT_ENTRY_BITMAP      0x81
+#define EXFAT_ENTRY_UPCASE      0x82
+#define EXFAT_ENTRY_FILE        0x85
+#define EXFAT_ENTRY_STREAM      0xC0
+#define EXFAT_ENTRY_NAME        0xC1
+
+#define EXFAT_ATTRIBUTE_DIRECTORY   0x10
+/// @brief Stream extension flags
+#define EXFAT_STREAM_ALLOCATED      0x01
+#define EXFAT_STREAM_NO_FAT_CHAIN   0x02
+/// @brief Boot sector VolumeFlags, which FAT and bitmap are in use
+#define EXFAT_VOLUME_ACTIVE_FAT     0x01
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+
+typedef struct
+{
+    uint8_t JumpBoot[3];
+    uint8_t FileSystemName[8];
+    uint8_t MustBeZero[53];
+    uint64_t PartitionOffset;
+    uint64_t VolumeLength;
+    uint32_t FatOffset;
+    uint32_t FatLength;
+    uint32_t ClusterHeapOffset;
+    uint32_t ClusterCount;
+    uint32_t FirstClusterOfRootDirectory;
+    uint32_t VolumeSerialNumber;
+    uint16_t FileSystemRevision;
+    uint16_t VolumeFlags;
+    uint8_t BytesPerSectorShift;
+    uint8_t SectorsPerClusterShift;
+    uint8_t NumberOfFats;
+    uint8_t DriveSelect;
+    uint8_t PercentInUse;
+    uint8_t _Reserved[7];
+
+    // ... we don't care about code ...
+
+} __attribute__((packed)) EXFAT_BootSector;
+
+/// @brief Bytes of the main boot sector the boot checksum leaves out (VolumeFlags, PercentInUse)
+#define BOOT_CHECKSUM_SKIP(i) ((i) == 106 || (i) == 107 || (i) == 112)
+
+typedef struct
+{
+    uint8_t EntryType;
+    uint8_t SecondaryCount;
+    uint16_t SetChecksum;
+    uint16_t FileAttributes;
+    uint8_t _Reserved[26];
+} __attribute__((packed)) EXFAT_FileEntry;
+
+typedef struct
+{
+    uint8_t EntryType;
+    uint8_t Flags;
+    uint8_t _Reserved1;
+    uint8_t NameLength;
+    uint16_t NameHash;
+    uint8_t _Reserved2[2];
+    uint64_t ValidDataLength;
+    uint8_t _Reserved3[4];
+    uint32_t FirstCluster;
+    uint64_t DataLength;
+} __attribute__((packed)) EXFAT_StreamEntry;
+
+typedef struct
+{
+    uint8_t EntryType;
+    uint8_t Flags;
+    uint16_t FileName[NAME_CHARS_PER_ENTRY];
+} __attribute__((packed)) EXFAT_NameEntry;
+
+/// @brief Allocation bitmap and up-case table entries
+typedef struct
+{
+    uint8_t EntryType;
+    uint8_t Flags;
+    uint8_t _Reserved1[2];
+    uint32_t TableChecksum;
+    uint8_t _Reserved2[12];
+    uint32_t FirstCluster;
+    uint64_t DataLength;
+} __attribute__((packed)) EXFAT_SystemEntry;
+
+typedef union
+{
+    uint8_t Bytes[32];
+    uint8_t EntryType;
+    EXFAT_FileEntry File;
+    EXFAT_StreamEntry Stream;
+    EXFAT_NameEntry Name;
+    EXFAT_SystemEntry System;
+} EXFAT_DirectoryEntry;
+
+/// @brief What open needs from a directory entry set
+typedef struct EXFAT_Stream
+{
+    uint16_t Attributes;
+    uint8_t Flags;
+    uint32_t FirstCluster;
+    uint64_t ValidLength;
+    uint64_t DataLength;
+} EXFAT_Stream;
+
+typedef struct EXFAT_FileData
+{
+    uint8_t Buffer[SECTOR_SIZE];
+    FAT_File Public;
+    bool Opened;
+    /// @brief NoFatChain, cluster n of the file is FirstCluster + n
+    bool Contiguous;
+    uint32_t FirstCluster;
+    uint32_t CurrentCluster;
+    /// @brief index of CurrentCluster in the file
+    uint32_t CurrentIndex;
+    /// @brief bytes from here to Size were never written and read as zero
+    uint64_t ValidLength;
+    uint32_t BufferedLba;
+
+} EXFAT_FileData;
+
+typedef struct
+{
+    union
+    {
+        EXFAT_BootSector BootSector;
+        uint8_t BootSectorBytes[SECTOR_SIZE];
+    } BS;
+
+    EXFAT_FileData RootDirectory;
+    EXFAT_FileData Bitmap;
+
+    EXFAT_FileData OpenedFiles[MAX_FILE_HANDLES];
+
+    uint8_t FatCache[FAT_CACHE_SIZE * SECTOR_SIZE];
+    uint32_t FatCachePosition;
+
+    uint16_t UpCase[UPCASE_CHARS];
+
+} EXFAT_Data;
+
+static_assert(sizeof(EXFAT_Data) <= MEMORY_FAT_SIZE, "exFAT state doesn't fit the FAT driver's memory");
+
+// only one of the FAT and exFAT drivers is mounted, they share the memory
+static EXFAT_Data *g_Data;
+static uint32_t g_FatLba;
+static uint32_t g_ClusterShift;
+
+/*
+ * The boot region, entry set and up-case table checksums all rotate the
+ * sum right by one before adding the next byte, they differ in width.
+ */
+static uint32_t checksum32(uint32_t checksum, uint8_t byte)
+{
+    return ((checksum & 1) ? 0x80000000 : 0) + (checksum >> 1) + byte;
+}
+
+static uint16_t checksum16(uint16_t checksum, uint8_t byte)
+{
+    return ((checksum & 1) ? 0x8000 : 0) + (checksum >> 1) + byte;
+}
+
+static uint16_t upcase(uint16_t c)
+{
+    return c < UPCASE_CHARS ? g_Data->UpCase[c] : c;
+}
+
+bool exfatFS::detect(const void *bootSector)
+{
+    return memcmp(((const EXFAT_BootSector *)bootSector)->FileSystemName, "EXFAT   ", 8) == true;
+}
+
+exfatFS::exfatFS(Partition *Disk)
+{
+    this->Disk = Disk;
+}
+
+uint32_t exfatFS::clusterToLba(uint32_t cluster)
+{
+    return g_Data->BS.BootSector.ClusterHeapOffset + ((cluster - 2) << (g_ClusterShift - SECTOR_SHIFT));
+}
+
+/*
+ * The main boot region is read whole once, its checksum sector holds the
+ * sum of the eleven sectors before it repeated over the sector.
+ */
+bool exfatFS::readBootRegion()
+{
+    uint8_t *region = (uint8_t *)MEMORY_SCRATCH_START;
+    if (!this->Disk->Partition_Read(region, BOOT_REGION_SECTORS, 0))
+    {
+        puts("EXFAT: failed to read the boot region\n");
+        return false;
+    }
+
+    uint32_t checksum = 0;
+    for (uint32_t i = 0; i < (BOOT_REGION_SECTORS - 1) * SECTOR_SIZE; i++)
+    {
+        if (!BOOT_CHECKSUM_SKIP(i))
+            checksum = checksum32(checksum, region[i]);
+    }
+
+    const uint32_t *stored = (const uint32_t *)(region + (BOOT_REGION_SECTORS - 1) * SECTOR_SIZE);
+    for (uint32_t i = 0; i < SECTOR_SIZE / sizeof(uint32_t); i++)
+    {
+        if (stored[i] != checksum)
+        {
+            puts("EXFAT: boot region checksum mismatch\n");
+            return false;
+        }
+    }
+
+    memcpy(g_Data->BS.BootSectorBytes, region, SECTOR_SIZE);
+    EXFAT_BootSector *bs = &g_Data->BS.BootSector;
+
+    if (bs->BytesPerSectorShift != SECTOR_SHIFT)
+    {
+        puts("EXFAT: only 512 byte sectors are supported\n");
+        return false;
+    }
+    if (bs->BytesPerSectorShift + bs->SectorsPerClusterShift > MAX_CLUSTER_SHIFT || bs->NumberOfFats == 0)
+    {
+        puts("EXFAT: bad boot sector\n");
+        return false;
+    }
+
+    g_ClusterShift = bs->BytesPerSectorShift + bs->SectorsPerClusterShift;
+
+    // with two FATs VolumeFlags says which one is current
+    g_FatLba = bs->FatOffset;
+    if (bs->NumberOfFats > 1 && (bs->VolumeFlags & EXFAT_VOLUME_ACTIVE_FAT))
+        g_FatLba += bs->FatLength;
+    return true;
+}
+
+bool exfatFS::Init()
+{
+    g_Data = (EXFAT_Data *)MEMORY_FAT_START;
+
+    if (!this->readBootRegion())
+        return false;
+
+    g_Data->FatCachePosition = NO_BUFFERED_LBA;
+    for (int i = 0; i < MAX_FILE_HANDLES; i++)
+        g_Data->OpenedFiles[i].Opened = false;
+
+    // the root directory has no stream extension, its chain says how long it is
+    EXFAT_Stream root = {EXFAT_ATTRIBUTE_DIRECTORY, EXFAT_STREAM_ALLOCATED,
+                         g_Data->BS.BootSector.FirstClusterOfRootDirectory, 0, 0};
+    this->setupFile(&g_Data->RootDirectory, &root);
+    g_Data->RootDirectory.Public.Handle = ROOT_DIRECTORY_HANDLE;
+    g_Data->RootDirectory.Opened = true;
+
+    return this->readRoot();
+}
+
+/*
+ * Picks the allocation bitmap belonging to the active FAT and the up-case
+ * table out of the root directory's critical entries.
+ */
+bool exfatFS::readRoot()
+{
+    FAT_File *root = &g_Data->RootDirectory.Public;
+    EXFAT_DirectoryEntry entry;
+    EXFAT_Stream bitmap = {0, 0, 0, 0, 0};
+    EXFAT_Stream table = {0, 0, 0, 0, 0};
+    uint32_t tableChecksum = 0;
+    uint8_t activeFat = g_Data->BS.BootSector.VolumeFlags & EXFAT_VOLUME_ACTIVE_FAT;
+
+    while (this->readEntry(root, &entry))
+    {
+        EXFAT_Stream *found = NULL;
+        if (entry.EntryType == EXFAT_ENTRY_BITMAP && (entry.System.Flags & 1) == activeFat)
+            found = &bitmap;
+        else if (entry.EntryType == EXFAT_ENTRY_UPCASE)
+        {
+            found = &table;
+            tableChecksum = entry.System.TableChecksum;
+        }
+
+        if (found != NULL)
+        {
+            found->Flags = EXFAT_STREAM_ALLOCATED;
+            found->FirstCluster = entry.System.FirstCluster;
+            found->ValidLength = entry.System.DataLength;
+            found->DataLength = entry.System.DataLength;
+        }
+    }
+    this->close(root);
+
+    if (bitmap.FirstCluster == 0 || table.FirstCluster == 0)
+    {
+        puts("EXFAT: missing allocation bitmap or up-case table\n");
+        return false;
+    }
+
+    this->setupFile(&g_Data->Bitmap, &bitmap);
+    g_Data->Bitmap.Public.Handle = BITMAP_HANDLE;
+    g_Data->Bitmap.Opened = true;
+
+    return this->loadUpCase(&table, tableChecksum);
+}
+
+/*
+ * The table is stored compressed: 0xFFFF followed by a count stands for
+ * that many characters that map to themselves. The whole table goes
+ * through the checksum, only the first UPCASE_CHARS mappings are kept.
+ */
+bool exfatFS::loadUpCase(EXFAT_Stream *table, uint32_t checksum)
+{
+    for (uint32_t i = 0; i < UPCASE_CHARS; i++)
+        g_Data->UpCase[i] = i;
+
+    FAT_File *file = this->openStream(table);
+    if (file == NULL)
+        return false;
+
+    uint8_t *chunk = (uint8_t *)MEMORY_SCRATCH_START;
+    uint32_t sum = 0;
+    uint32_t index = 0;
+    bool run = false;
+
+    while (file->Position < file->Size)
+    {
+        uint32_t length = this->read(file, min(file->Size - file->Position, MEMORY_SCRATCH_SIZE), chunk);
+        if (length == 0)
+            break;
+
+        for (uint32_t i = 0; i < length; i++)
+            sum = checksum32(sum, chunk[i]);
+
+        const uint16_t *values = (const uint16_t *)chunk;
+        for (uint32_t i = 0; i < length / 2 && index < UPCASE_CHARS; i++)
+        {
+            if (run)
+            {
+                index += values[i];
+                run = false;
+            }
+            else if (values[i] == 0xFFFF)
+            {
+                run = true;
+            }
+            else
+            {
+                g_Data->UpCase[index++] = values[i];
+            }
+        }
+    }
+
+    bool complete = file->Position == file->Size;
+    this->close(file);
+
+    if (!complete || sum != checksum)
+    {
+        puts("EXFAT: up-case table checksum mismatch\n");
+        return false;
+    }
+    return true;
+}
+
+bool exfatFS::inHeap(uint32_t cluster)
+{
+    return cluster >= 2 && (uint64_t)cluster < (uint64_t)g_Data->BS.BootSector.ClusterCount + 2;
+}
+
+/*
+ * A corrupt chain ends here rather than sending the cache outside the FAT
+ * or the file outside the cluster heap.
+ */
+uint32_t exfatFS::nextCluster(uint32_t cluster)
+{
+    uint32_t fatLength = g_Data->BS.BootSector.FatLength;
+    uint32_t sector = cluster / (SECTOR_SIZE / 4);
+    if (!this->inHeap(cluster) || sector >= fatLength)
+    {
+        puts("EXFAT: cluster chain leaves the cluster heap\n");
+        return EXFAT_CHAIN_END;
+    }
+
+    if (g_Data->FatCachePosition == NO_BUFFERED_LBA || sector < g_Data->FatCachePosition ||
+        sector >= g_Data->FatCachePosition + FAT_CACHE_SIZE)
+    {
+        if (!this->Disk->Partition_Read(g_Data->FatCache, min(FAT_CACHE_SIZE, fatLength - sector), g_FatLba + sector))
+        {
+            g_Data->FatCachePosition = NO_BUFFERED_LBA;
+            return EXFAT_CHAIN_END;
+        }
+        g_Data->FatCachePosition = sector;
+    }
+    else
+    {
+        this->Disk->Partition_CacheHit();
+    }
+
+    uint32_t index = cluster - g_Data->FatCachePosition * (SECTOR_SIZE / 4);
+    uint32_t next = ((const uint32_t *)g_Data->FatCache)[index];
+    if (next < EXFAT_CHAIN_END && !this->inHeap(next))
+    {
+        puts("EXFAT: cluster chain leaves the cluster heap\n");
+        return EXFAT_CHAIN_END;
+    }
+    return next;
+}
+
+bool exfatFS::isAllocated(uint32_t cluster)
+{
+    FAT_File *bitmap = &g_Data->Bitmap.Public;
+    uint32_t bit = cluster - 2;
+    uint8_t bits;
+
+    if (!this->seek(bitmap, bit / 8) || this->read(bitmap, 1, &bits) != 1)
+        return false;
+    return (bits >> (bit % 8)) & 1;
+}
+
+/*
+ * Points CurrentCluster at cluster clusterIndex of the file. NoFatChain
+ * files get there by adding, the others walk the FAT, from the start when
+ * they have to go back.
+ */
+bool exfatFS::locate(EXFAT_FileData *fd, uint32_t clusterIndex)
+{
+    if (fd->Contiguous)
+    {
+        fd->CurrentCluster = fd->FirstCluster + clusterIndex;
+        fd->CurrentIndex = clusterIndex;
+        return true;
+    }
+
+    if (clusterIndex < fd->CurrentIndex)
+    {
+        fd->CurrentCluster = fd->FirstCluster;
+        fd->CurrentIndex = 0;
+    }
+
+    while (fd->CurrentIndex < clusterIndex)
+    {
+        uint32_t next = this->nextCluster(fd->CurrentCluster);
+        if (next < 2 || next >= EXFAT_CHAIN_END)
+            return false;
+        fd->CurrentCluster = next;
+        fd->CurrentIndex++;
+    }
+    return true;
+}
+
+EXFAT_FileData *exfatFS::fileData(FAT_File *file)
+{
+    if (file->Handle == ROOT_DIRECTORY_HANDLE)
+        return &g_Data->RootDirectory;
+    if (file->Handle == BITMAP_HANDLE)
+        return &g_Data->Bitmap;
+    return &g_Data->OpenedFiles[file->Handle];
+}
+
+uint32_t exfatFS::read(FAT_File *file, uint32_t byteCount, void *dataOut)
+{
+    EXFAT_FileData *fd = this->fileData(file);
+
+    uint8_t *u8DataOut = (uint8_t *)dataOut;
+    uint32_t sectorsPerCluster = 1 << (g_ClusterShift - SECTOR_SHIFT);
+
+    // the root directory's size is only known once its chain ends
+    if (fd->Public.Size != 0 || !fd->Public.IsDirectory)
+        byteCount = min(byteCount, fd->Public.Size - fd->Public.Position);
+
+    while (byteCount > 0)
+    {
+        uint64_t position = fd->Public.Position;
+        uint32_t offset = position % SECTOR_SIZE;
+        uint32_t take;
+
+        if (position >= fd->ValidLength)
+        {
+            // allocated but never written
+            take = byteCount;
+            memset(u8DataOut, 0, take);
+        }
+        else
+        {
+            if (!this->locate(fd, position >> g_ClusterShift))
+            {
+                // Mark end of file
+                fd->Public.Size = position;
+                break;
+            }
+
+            uint32_t sectorInCluster = (position >> SECTOR_SHIFT) & (sectorsPerCluster - 1);
+            uint32_t lba = this->clusterToLba(fd->CurrentCluster) + sectorInCluster;
+            uint64_t validSectors = (fd->ValidLength - position) / SECTOR_SIZE;
+
+            if (offset == 0 && byteCount >= SECTOR_SIZE && validSectors != 0)
+            {
+                // a NoFatChain file goes to the caller in one read, a chained one a cluster at a time
+                uint32_t sectors = min(byteCount / SECTOR_SIZE, validSectors);
+                if (!fd->Contiguous)
+                    sectors = min(sectors, sectorsPerCluster - sectorInCluster);
+
+                if (!this->Disk->Partition_Read(u8DataOut, sectors, lba))
+                {
+                    printf("EXFAT: read error!\r\n");
+                    break;
+                }
+                take = sectors * SECTOR_SIZE;
+            }
+            else
+            {
+                if (fd->BufferedLba == lba)
+                {
+                    this->Disk->Partition_CacheHit();
+                }
+                else
+                {
+                    if (!this->Disk->Partition_Read(fd->Buffer, 1, lba))
+                    {
+                        printf("EXFAT: read error!\r\n");
+                        break;
+                    }
+                    fd->BufferedLba = lba;
+                }
+
+                take = min(byteCount, SECTOR_SIZE - offset);
+                memcpy(u8DataOut, fd->Buffer + offset, take);
+
+                // the sector holding the end of the valid data may have anything after it
+                if (position + take > fd->ValidLength)
+                    memset(u8DataOut + (fd->ValidLength - position), 0, position + take - fd->ValidLength);
+            }
+        }
+
+        u8DataOut += take;
+        fd->Public.Position += take;
+        byteCount -= take;
+    }
+
+    return u8DataOut - (uint8_t *)dataOut;
+}
+
+bool exfatFS::seek(FAT_File *file, uint64_t position)
+{
+    EXFAT_FileData *fd = this->fileData(file);
+
+    if (fd->Public.Size != 0 && position > fd->Public.Size)
+        return false;
+
+    // the cluster is looked up by the next read
+    fd->Public.Position = position;
+    return true;
+}
+
+void exfatFS::close(FAT_File *file)
+{
+    if (file->Handle == ROOT_DIRECTORY_HANDLE)
+    {
+        file->Position = 0;
+        g_Data->RootDirectory.CurrentCluster = g_Data->RootDirectory.FirstCluster;
+        g_Data->RootDirectory.CurrentIndex = 0;
+    }
+    else if (file->Handle != BITMAP_HANDLE)
+    {
+        g_Data->OpenedFiles[file->Handle].Opened = false;
+    }
+}
+
+bool exfatFS::readEntry(FAT_File *file, void *entry)
+{
+    EXFAT_DirectoryEntry *dirEntry = (EXFAT_DirectoryEntry *)entry;
+    return this->read(file, sizeof(EXFAT_DirectoryEntry), dirEntry) == sizeof(EXFAT_DirectoryEntry) &&
+           dirEntry->EntryType != EXFAT_ENTRY_END;
+}
+
+/*
+ * A file is an entry set: the file entry, its stream extension and the
+ * name entries. Sets whose stream hash or name length don't match are
+ * skipped without reading their names, the names of the rest are
+ * compared up-cased and the set checksum is checked before it is used.
+ */
+bool exfatFS::findFile(FAT_File *file, const char *name, EXFAT_Stream *streamOut)
+{
+    uint16_t wanted[MAX_PATH_SIZE];
+    uint32_t length = strlen(name);
+    uint16_t hash = 0;
+
+    for (uint32_t i = 0; i < length; i++)
+    {
+        wanted[i] = upcase((uint8_t)name[i]);
+        hash = checksum16(hash, wanted[i] & 0xFF);
+        hash = checksum16(hash, wanted[i] >> 8);
+    }
+
+    EXFAT_DirectoryEntry entry;
+    while (this->readEntry(file, &entry))
+    {
+        if (entry.EntryType != EXFAT_ENTRY_FILE || entry.File.SecondaryCount < 2)
+            continue;
+
+        EXFAT_FileEntry primary = entry.File;
+        uint16_t checksum = 0;
+        for (uint32_t i = 0; i < sizeof(entry); i++)
+        {
+            if (i != 2 && i != 3)
+                checksum = checksum16(checksum, entry.Bytes[i]);
+        }
+
+        if (!this->readEntry(file, &entry))
+            return false;
+        uint32_t remaining = primary.SecondaryCount - 1;
+        if (entry.EntryType != EXFAT_ENTRY_STREAM || entry.Stream.NameLength != length ||
+            entry.Stream.NameHash != hash)
+        {
+            this->seek(file, file->Position + remaining * sizeof(entry));
+            continue;
+        }
+
+        EXFAT_StreamEntry stream = entry.Stream;
+        for (uint32_t i = 0; i < sizeof(entry); i++)
+            checksum = checksum16(checksum, entry.Bytes[i]);
+
+        bool matches = true;
+        uint32_t compared = 0;
+        for (; remaining > 0 && this->readEntry(file, &entry); remaining--)
+        {
+            for (uint32_t i = 0; i < sizeof(entry); i++)
+                checksum = checksum16(checksum, entry.Bytes[i]);
+
+            if (entry.EntryType != EXFAT_ENTRY_NAME)
+                continue;
+            for (uint32_t i = 0; i < NAME_CHARS_PER_ENTRY && compared < length; i++, compared++)
+            {
+                if (upcase(entry.Name.FileName[i]) != wanted[compared])
+                    matches = false;
+            }
+        }
+
+        if (remaining != 0)
+            return false;
+        if (!matches || compared != length)
+            continue;
+
+        if (checksum != primary.SetChecksum)
+        {
+            puts("EXFAT: entry set checksum mismatch\n");
+            return false;
+        }
+
+        streamOut->Attributes = primary.FileAttributes;
+        streamOut->Flags = stream.Flags;
+        streamOut->FirstCluster = stream.FirstCluster;
+        streamOut->ValidLength = stream.ValidDataLength;
+        streamOut->DataLength = stream.DataLength;
+        return true;
+    }
+
+    return false;
+}
+
+/*
+ * Every stream has to start inside the heap and be no longer than the
+ * heap. A NoFatChain stream has nothing in the FAT to vouch for the rest,
+ * so all its clusters have to be inside the heap and the first and last
+ * of them marked in use in the allocation bitmap.
+ */
+bool exfatFS::checkExtent(EXFAT_Stream *stream)
+{
+    if (stream->DataLength == 0)
+        return true;
+
+    uint64_t clusters = (stream->DataLength + (1u << g_ClusterShift) - 1) >> g_ClusterShift;
+    if (!this->inHeap(stream->FirstCluster) || clusters > g_Data->BS.BootSector.ClusterCount)
+        return false;
+    if (!(stream->Flags & EXFAT_STREAM_NO_FAT_CHAIN))
+        return true;
+
+    uint64_t last = stream->FirstCluster + clusters - 1;
+    if (last >= (uint64_t)g_Data->BS.BootSector.ClusterCount + 2)
+        return false;
+
+    return this->isAllocated(stream->FirstCluster) && this->isAllocated(last);
+}
+
+void exfatFS::setupFile(EXFAT_FileData *fd, EXFAT_Stream *stream)
+{
+    fd->Public.IsDirectory = (stream->Attributes & EXFAT_ATTRIBUTE_DIRECTORY) != 0;
+    fd->Public.Position = 0;
+    fd->Public.Size = stream->DataLength;
+    fd->Contiguous = (stream->Flags & EXFAT_STREAM_NO_FAT_CHAIN) != 0;
+    fd->FirstCluster = stream->FirstCluster;
+    fd->CurrentCluster = stream->FirstCluster;
+    fd->CurrentIndex = 0;
+    fd->ValidLength = (stream->Attributes & EXFAT_ATTRIBUTE_DIRECTORY) ? stream->DataLength : stream->ValidLength;
+    fd->BufferedLba = NO_BUFFERED_LBA;
+
+    // the root directory reads until its chain ends
+    if (stream->DataLength == 0 && fd->Public.IsDirectory)
+        fd->ValidLength = 0xFFFFFFFFFFFFFFFF;
+}
+
+FAT_File *exfatFS::openStream(EXFAT_Stream *stream)
+{
+    if (stream->ValidLength > stream->DataLength)
+    {
+        puts("EXFAT: bad stream extension\n");
+        return NULL;
+    }
+
+    if (!this->checkExtent(stream))
+    {
+        puts("EXFAT: file extent is outside the cluster heap or not allocated\n");
+        return NULL;
+    }
+
+    // find empty handle
+    int handle = -1;
+    for (int i = 0; i < MAX_FILE_HANDLES && handle < 0; i++)
+    {
+        if (!g_Data->OpenedFiles[i].Opened)
+            handle = i;
+    }
+
+    // out of handles
+    if (handle < 0)
+    {
+        puts("EXFAT: out of file handles\r\n");
+        return NULL;
+    }
+
+    EXFAT_FileData *fd = &g_Data->OpenedFiles[handle];
+    this->setupFile(fd, stream);
+    fd->Public.Handle = handle;
+    fd->Opened = true;
+    return &fd->Public;
+}
+
+FAT_File *exfatFS::open(const char *path)
+{
+    char name[MAX_PATH_SIZE];
+
+    // ignore leading slash
+    if (path[0] == '/')
+        path++;
+
+    FAT_File *current = &g_Data->RootDirectory.Public;
+
+    while (*path)
+    {
+        // extract next file name from path
+        const char *delim = strchr(path, '/');
+        uint32_t len = delim != NULL ? delim - path : strlen(path);
+        if (len >= MAX_PATH_SIZE)
+        {
+            this->close(current);
+            puts("EXFAT: name too long\r\n");
+            return NULL;
+        }
+        memcpy(name, path, len);
+        name[len] = '\0';
+        path += delim != NULL ? len + 1 : len;
+
+        if (!current->IsDirectory)
+        {
+            this->close(current);
+            puts("EXFAT: not a directory\r\n");
+            return NULL;
+        }
+
+        EXFAT_Stream stream;
+        bool found = this->findFile(current, name, &stream);
+        this->close(current);
+        if (!found)
+        {
+            puts("EXFAT: not found\r\n");
+            return NULL;
+        }
+
+        current = this->openStream(&stream);
+        if (current == NULL)
+            return NULL;
+    }
+
+    return current;
+}
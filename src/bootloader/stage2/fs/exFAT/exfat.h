@@ -0,0 +1,83 @@
+/**
+ * @file exfat.h
+ * @author Aidcraft
+ * @brief exFAT driver, read only
+ * @version 0.0.2
+ * @date 2025-03-24
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ * @details Mounted through fatFS, which hands its calls over when Init
+ * finds an exFAT boot sector, so the loaders keep taking a fatFS and
+ * FAT_File handles. Files whose stream extension is flagged NoFatChain
+ * lie in one run of clusters and are read without looking at the FAT.
+ * Files may pass 4 GiB, single reads are still limited to 32-bit counts.
+ */
+#pragma once
+
+#include "../../stdint.h"
+#include "../../mbr.h"
+
+struct FAT_File;
+struct EXFAT_FileData;
+struct EXFAT_Stream;
+
+class exfatFS
+{
+private:
+    Partition* Disk;
+
+    bool readBootRegion();
+    bool readRoot();
+    bool loadUpCase(EXFAT_Stream* table, uint32_t checksum);
+    uint32_t clusterToLba(uint32_t cluster);
+    bool inHeap(uint32_t cluster);
+    uint32_t nextCluster(uint32_t cluster);
+    bool isAllocated(uint32_t cluster);
+    bool locate(EXFAT_FileData* fd, uint32_t clusterIndex);
+    bool readEntry(FAT_File* file, void* entry);
+    bool findFile(FAT_File* file, const char* name, EXFAT_Stream* streamOut);
+    bool checkExtent(EXFAT_Stream* stream);
+    void setupFile(EXFAT_FileData* fd, EXFAT_Stream* stream);
+    FAT_File* openStream(EXFAT_Stream* stream);
+    EXFAT_FileData* fileData(FAT_File* file);
+
+public:
+
+    /// @brief Whether a boot sector is an exFAT one
+    /// @param bootSector first sector of the partition
+    /// @return true the file system name is "EXFAT   "
+    static bool detect(const void* bootSector);
+
+    /// @brief Reads from the file, bytes past the valid data length read as zero
+    /// @param file File descriptor
+    /// @param byteCount number of bytes to read
+    /// @param dataOut buffer to read to
+    /// @return number of bytes read
+    uint32_t read(FAT_File* file, uint32_t byteCount, void* dataOut);
+
+    /// @brief Moves the read position of a file
+    /// @param file File descriptor
+    /// @param position Byte offset from the start of the file
+    /// @return Success or failure (past the end of the file)
+    bool seek(FAT_File* file, uint64_t position);
+
+    /// @brief Closes a file and frees its handle
+    /// @param file File descriptor
+    void close(FAT_File* file);
+
+    /// @brief Opens a file, names are compared through the volume's up-case table
+    /// @param path Path to the file
+    /// @return Pointer to the file
+    FAT_File* open(const char* path);
+
+    /// @brief Constructor for exFAT file system
+    /// @param Disk pointer to disk partition
+    exfatFS(Partition* Disk);
+
+    /// @brief Checks the boot region and loads the bitmap and up-case table entries
+    /// @return Success or failure
+    bool Init();
+};
@@ -0,0 +1,241 @@
+/**
+ * @file bootinfo.cpp
+ * @author Aidcraft
+ * @brief builds the kernel handoff structure
+ * @version 0.0.2
+ * @date 2025-03-09
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#include "bootinfo.h"
+#include "../stdio.h"
+#include "../stddef.h"
+#include "../string.h"
+#include "../memory/memory.h"
+#include "../memory/paging.h"
+#include "../memory/frames.h"
+
+#define PAGE_SIZE 0x1000
+#define PAGE_MASK (PAGE_SIZE - 1)
+
+/// @brief most E820 entries considered, matches the map Main keeps
+#define MAX_E820 32
+#define MAX_FRAME_RANGES 32
+
+bootinfo* bootinfo_create()
+{
+    uint64_t pages = (sizeof(bootinfo) + PAGE_MASK) / PAGE_SIZE;
+    uint64_t phys = frames_alloc(pages);
+    if (phys == 0)
+        return NULL;
+
+    // identity map it so the kernel can use the pointer as is
+    page_range(phys, phys, pages * PAGE_SIZE, MAP_WRITE);
+
+    bootinfo* info = (bootinfo*)phys;
+    memset(info, 0, sizeof(bootinfo));
+    info->magic = BOOTINFO_MAGIC;
+    info->version = BOOTINFO_VERSION;
+    info->size = sizeof(bootinfo);
+    return info;
+}
+
+bool bootinfo_add_module(bootinfo* info, const char* name, uint64_t base, uint64_t size)
+{
+    if (info->moduleCount >= BOOTINFO_MAX_MODULES)
+        return false;
+
+    bootinfo_module* module = &info->modules[info->moduleCount++];
+    module->base = base;
+    module->size = size;
+
+    uint32_t i = 0;
+    for (; name[i] && i < BOOTINFO_MODULE_NAME_SIZE - 1; i++)
+        module->name[i] = name[i];
+    module->name[i] = '\0';
+    return true;
+}
+
+/*
+ * Rank of a type when two E820 entries overlap, the higher rank wins.
+ */
+static uint8_t type_rank(uint32_t type)
+{
+    switch (type)
+    {
+    case BOOTINFO_MEMORY_USABLE:
+        return 0;
+    case BOOTINFO_MEMORY_ACPI_RECLAIMABLE:
+        return 1;
+    case BOOTINFO_MEMORY_ACPI_NVS:
+        return 2;
+    default:
+        return 3;
+    }
+}
+
+/*
+ * Append [base, end) to the map, merging with the previous entry when it
+ * is adjacent and of the same type.
+ */
+static void append(bootinfo* info, uint64_t base, uint64_t end, uint32_t type)
+{
+    if (type == BOOTINFO_MEMORY_USABLE)
+    {
+        base = (base + PAGE_MASK) & ~(uint64_t)PAGE_MASK;
+        end &= ~(uint64_t)PAGE_MASK;
+    }
+
+    if (end <= base)
+        return;
+
+    if (info->memoryMapCount > 0)
+    {
+        bootinfo_memory* last = &info->memoryMap[info->memoryMapCount - 1];
+        if (last->type == type && last->base + last->length == base)
+        {
+            last->length += end - base;
+            return;
+        }
+    }
+
+    if (info->memoryMapCount >= BOOTINFO_MAX_MEMORY)
+        return;
+
+    bootinfo_memory* entry = &info->memoryMap[info->memoryMapCount++];
+    entry->base = base;
+    entry->length = end - base;
+    entry->type = type;
+    entry->_reserved = 0;
+}
+
+/*
+ * Change the type of the usable parts of [base, end), splitting entries as
+ * needed. Only usable memory is ever re-typed; reserved holes stay as the
+ * bios described them. Fails when the map has no room for the pieces,
+ * the range would then still look usable to the kernel.
+ */
+static bool mark(bootinfo* info, uint64_t base, uint64_t end, uint32_t type)
+{
+    for (uint32_t i = 0; i < info->memoryMapCount; i++)
+    {
+        bootinfo_memory* entry = &info->memoryMap[i];
+        uint64_t entryEnd = entry->base + entry->length;
+
+        if (entry->type != BOOTINFO_MEMORY_USABLE || entryEnd <= base || entry->base >= end)
+            continue;
+
+        uint64_t cutBase = entry->base > base ? entry->base : base;
+        uint64_t cutEnd = entryEnd < end ? entryEnd : end;
+
+        // pieces: [entry->base, cutBase) usable, [cutBase, cutEnd) type, [cutEnd, entryEnd) usable
+        uint32_t extra = (cutBase > entry->base) + (cutEnd < entryEnd);
+        if (info->memoryMapCount + extra > BOOTINFO_MAX_MEMORY)
+        {
+            puts("BOOTINFO: memory map is full, can't reserve loader memory\n");
+            return false;
+        }
+
+        for (uint32_t j = info->memoryMapCount; j > i + 1; j--)
+            info->memoryMap[j - 1 + extra] = info->memoryMap[j - 1];
+        info->memoryMapCount += extra;
+
+        uint32_t k = i;
+        if (cutBase > entry->base)
+        {
+            info->memoryMap[k].length = cutBase - entry->base;
+            k++;
+        }
+
+        info->memoryMap[k].base = cutBase;
+        info->memoryMap[k].length = cutEnd - cutBase;
+        info->memoryMap[k].type = type;
+        info->memoryMap[k]._reserved = 0;
+
+        if (cutEnd < entryEnd)
+        {
+            k++;
+            info->memoryMap[k].base = cutEnd;
+            info->memoryMap[k].length = entryEnd - cutEnd;
+            info->memoryMap[k].type = BOOTINFO_MEMORY_USABLE;
+            info->memoryMap[k]._reserved = 0;
+        }
+
+        i = k;
+    }
+    return true;
+}
+
+/*
+ * Insert a value into a sorted array of boundaries unless already present.
+ */
+static void insert_bound(uint64_t* bounds, uint32_t* count, uint64_t value)
+{
+    for (uint32_t i = 0; i < *count; i++)
+        if (bounds[i] == value)
+            return;
+
+    uint32_t j = *count;
+    while (j > 0 && bounds[j - 1] > value)
+    {
+        bounds[j] = bounds[j - 1];
+        j--;
+    }
+    bounds[j] = value;
+    (*count)++;
+}
+
+bool bootinfo_finalize(bootinfo* info, const memory_map* map, uint8_t count)
+{
+    uint64_t bounds[MAX_E820 * 2];
+    uint32_t boundCount = 0;
+
+    if (count > MAX_E820)
+        count = MAX_E820;
+
+    // every start and end point, sorted and deduplicated
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (map[i].length == 0)
+            continue;
+
+        insert_bound(bounds, &boundCount, map[i].base);
+        insert_bound(bounds, &boundCount, map[i].base + map[i].length);
+    }
+
+    // each interval between two points takes the most restrictive type covering it
+    info->memoryMapCount = 0;
+    for (uint32_t b = 0; b + 1 < boundCount; b++)
+    {
+        uint64_t base = bounds[b];
+        uint64_t end = bounds[b + 1];
+        uint32_t type = 0;
+
+        for (uint8_t i = 0; i < count; i++)
+        {
+            if (map[i].base > base || map[i].base + map[i].length < end)
+                continue;
+            if (type == 0 || type_rank(map[i].type) > type_rank(type))
+                type = map[i].type;
+        }
+
+        if (type != 0)
+            append(info, base, end, type);
+    }
+
+    if (!mark(info, MEMORY_STAGE2_START, MEMORY_STAGE2_END, BOOTINFO_MEMORY_LOADER))
+        return false;
+
+    frame_range used[MAX_FRAME_RANGES];
+    uint8_t usedCount = frames_used(used, MAX_FRAME_RANGES);
+    for (uint8_t i = 0; i < usedCount; i++)
+    {
+        if (!mark(info, used[i].base, used[i].end, BOOTINFO_MEMORY_LOADED))
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,307 @@
+/**
+ * @file bootinfo.h
+ * @author Aidcraft
+ * @brief structure handed to the kernel on entry
+ * @version 0.0.2
+ * @date 2025-03-09
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ * @details The kernel is entered with a pointer to a bootinfo in RDI (so a
+ * kernel_main(bootinfo*) can be the entry point directly). The structure and
+ * everything it points to is identity mapped. New fields are only ever added
+ * at the end, with the version bumped, so a kernel can check version/size.
+ */
+
+#pragma once
+
+#include "../stdint.h"
+
+struct memory_map;
+
+/// @brief "AIDBOOT\0"
+#define BOOTINFO_MAGIC              0x00544F4F42444941ULL
+#define BOOTINFO_VERSION            3
+
+#define BOOTINFO_MAX_MEMORY         64
+#define BOOTINFO_MAX_MODULES        16
+#define BOOTINFO_MODULE_NAME_SIZE   48
+
+/// @brief Memory types, the first five match E820
+enum bootinfo_memory_type
+{
+    BOOTINFO_MEMORY_USABLE              = 1,
+    BOOTINFO_MEMORY_RESERVED            = 2,
+    BOOTINFO_MEMORY_ACPI_RECLAIMABLE    = 3,
+    BOOTINFO_MEMORY_ACPI_NVS            = 4,
+    BOOTINFO_MEMORY_BAD                 = 5,
+    /// @brief stage2 code, data and the page tables the kernel starts on
+    BOOTINFO_MEMORY_LOADER              = 0x1000,
+    /// @brief kernel segments, modules, this structure and the entry stack
+    BOOTINFO_MEMORY_LOADED              = 0x1001,
+};
+
+/// @brief Framebuffer types
+enum bootinfo_framebuffer_type
+{
+    BOOTINFO_FRAMEBUFFER_NONE   = 0,
+    BOOTINFO_FRAMEBUFFER_TEXT   = 1,
+    BOOTINFO_FRAMEBUFFER_RGB    = 2,
+};
+
+/// @brief Indexes into bootinfo::timestamps (raw TSC values)
+enum bootinfo_timestamp
+{
+    BOOTINFO_TIME_STAGE2_START  = 0,
+    BOOTINFO_TIME_LOAD_START    = 1,
+    BOOTINFO_TIME_LOAD_END      = 2,
+    BOOTINFO_TIME_HANDOFF       = 3,
+    BOOTINFO_TIME_COUNT         = 4,
+};
+
+/// @brief One entry of the cleaned memory map
+typedef struct
+{
+    uint64_t base;
+    uint64_t length;
+    uint32_t type;
+    uint32_t _reserved;
+} __attribute__((packed)) bootinfo_memory;
+
+/// @brief Display left set up by the loader
+typedef struct
+{
+    uint64_t address;
+    uint32_t width;
+    uint32_t height;
+    /// @brief bytes per line
+    uint32_t pitch;
+    uint8_t bpp;
+    uint8_t type;
+    uint8_t redPosition;
+    uint8_t redSize;
+    uint8_t greenPosition;
+    uint8_t greenSize;
+    uint8_t bluePosition;
+    uint8_t blueSize;
+} __attribute__((packed)) bootinfo_framebuffer;
+
+/// @brief A file the loader placed in memory for the kernel
+typedef struct
+{
+    uint64_t base;
+    uint64_t size;
+    char name[BOOTINFO_MODULE_NAME_SIZE];
+} __attribute__((packed)) bootinfo_module;
+
+/// @brief log2 buckets in bootinfo_io_stats::latency
+#define BOOTINFO_IO_LATENCY_BUCKETS 32
+
+/// @brief Disk counters gathered while loading (version 2)
+typedef struct
+{
+    uint64_t commands;
+    uint64_t sectors;
+    uint64_t bytes;
+    uint64_t errors;
+    /// @brief commands that didn't continue where the previous one ended
+    uint64_t seeks;
+    /// @brief reads answered from a loader buffer
+    uint64_t cacheHits;
+    /// @brief TSC ticks spent inside commands
+    uint64_t cycles;
+    /// @brief commands by log2 of their TSC ticks
+    uint32_t latency[BOOTINFO_IO_LATENCY_BUCKETS];
+} __attribute__((packed)) bootinfo_io_stats;
+
+/// @brief Lengths of the lists in bootinfo_acpi
+#define BOOTINFO_ACPI_MAX_TABLES    48
+#define BOOTINFO_ACPI_MAX_CPUS      64
+#define BOOTINFO_ACPI_MAX_IO_APICS  8
+#define BOOTINFO_ACPI_MAX_OVERRIDES 16
+#define BOOTINFO_ACPI_MAX_ECAM      4
+#define BOOTINFO_ACPI_MAX_MEMORY    16
+
+/// @brief bootinfo_acpi_cpu::proximity without an SRAT entry
+#define BOOTINFO_PROXIMITY_NONE     0xFFFFFFFF
+/// @brief bootinfo_acpi_cpu::flags
+#define BOOTINFO_CPU_ENABLED        (1u << 0)
+#define BOOTINFO_CPU_ONLINE_CAPABLE (1u << 1)
+#define BOOTINFO_CPU_X2APIC         (1u << 31)
+
+/// @brief A table that passed its checksum
+typedef struct
+{
+    char signature[4];
+    uint32_t length;
+    uint64_t address;
+} __attribute__((packed)) bootinfo_acpi_table;
+
+/// @brief A processor listed in the MADT
+typedef struct
+{
+    uint32_t apicId;
+    uint32_t processorUid;
+    uint32_t proximity;
+    uint32_t flags;
+} __attribute__((packed)) bootinfo_acpi_cpu;
+
+/// @brief An I/O APIC listed in the MADT
+typedef struct
+{
+    uint32_t id;
+    uint32_t gsiBase;
+    uint64_t address;
+} __attribute__((packed)) bootinfo_acpi_io_apic;
+
+/// @brief An ISA interrupt source override from the MADT
+typedef struct
+{
+    uint8_t bus;
+    uint8_t source;
+    uint16_t flags;
+    uint32_t gsi;
+} __attribute__((packed)) bootinfo_acpi_override;
+
+/// @brief A PCI Express configuration space window from the MCFG
+typedef struct
+{
+    uint64_t base;
+    uint16_t segment;
+    uint8_t startBus;
+    uint8_t endBus;
+    uint32_t _reserved;
+} __attribute__((packed)) bootinfo_acpi_ecam;
+
+/// @brief A memory range of one proximity domain from the SRAT
+typedef struct
+{
+    uint64_t base;
+    uint64_t length;
+    uint32_t proximity;
+    uint32_t flags;
+} __attribute__((packed)) bootinfo_acpi_memory;
+
+/**
+ * @brief The ACPI tables as stage2 already parsed them (version 3)
+ * @details Saves the kernel walking firmware memory early on. Lists that
+ * were longer than their arrays are cut off, the tables themselves are
+ * still reachable through acpiRsdp or the table index.
+ */
+typedef struct
+{
+    uint64_t localApicAddress;
+    uint32_t madtFlags;
+    uint32_t cpuCount;
+    uint32_t ioApicCount;
+    uint32_t overrideCount;
+    uint32_t ecamCount;
+    uint32_t memoryCount;
+    uint32_t tableCount;
+    uint32_t _reserved;
+
+    /// @brief HPET register block, 0 without an HPET
+    uint64_t hpetAddress;
+    uint32_t hpetBlockId;
+    uint16_t hpetMinimumTick;
+    uint8_t hpetNumber;
+    uint8_t _reserved2;
+
+    bootinfo_acpi_cpu cpus[BOOTINFO_ACPI_MAX_CPUS];
+    bootinfo_acpi_io_apic ioApics[BOOTINFO_ACPI_MAX_IO_APICS];
+    bootinfo_acpi_override overrides[BOOTINFO_ACPI_MAX_OVERRIDES];
+    bootinfo_acpi_ecam ecam[BOOTINFO_ACPI_MAX_ECAM];
+    bootinfo_acpi_memory memory[BOOTINFO_ACPI_MAX_MEMORY];
+    /// @brief every table the XSDT/RSDT lists, and the DSDT
+    bootinfo_acpi_table tables[BOOTINFO_ACPI_MAX_TABLES];
+} __attribute__((packed)) bootinfo_acpi;
+
+/// @brief The handoff structure
+typedef struct
+{
+    uint64_t magic;
+    uint32_t version;
+    /// @brief sizeof(bootinfo) as built by the loader
+    uint32_t size;
+
+    uint8_t bootDrive;
+    uint8_t _reserved[3];
+    uint32_t partitionLba;
+    uint32_t partitionSectors;
+    uint32_t _reserved2;
+    uint64_t diskSectors;
+
+    uint64_t kernelEntry;
+    uint64_t kernelVirtStart;
+    uint64_t kernelVirtEnd;
+
+    /// @brief physical address of the ACPI RSDP, 0 if not found
+    uint64_t acpiRsdp;
+    /// @brief TSC ticks per second, 0 if not calibrated
+    uint64_t tscFrequency;
+    uint64_t timestamps[BOOTINFO_TIME_COUNT];
+
+    bootinfo_framebuffer framebuffer;
+
+    uint32_t memoryMapCount;
+    uint32_t moduleCount;
+    bootinfo_memory memoryMap[BOOTINFO_MAX_MEMORY];
+    bootinfo_module modules[BOOTINFO_MAX_MODULES];
+
+    /// @brief raw ATA IDENTIFY words of the boot disk
+    uint16_t identify[256];
+
+    /// @brief commands as sent to the drive
+    bootinfo_io_stats diskIo;
+    /// @brief reads as the file system asked for them
+    bootinfo_io_stats partitionIo;
+
+    bootinfo_acpi acpi;
+} __attribute__((packed)) bootinfo;
+
+/**
+ * @brief Allocates and zeroes the bootinfo and fills in the header
+ *
+ * @return bootinfo* the structure, NULL if out of memory
+ */
+bootinfo* bootinfo_create();
+
+/**
+ * @brief Records a module loaded for the kernel
+ *
+ * @param[in] info bootinfo to add to
+ * @param[in] name file name of the module
+ * @param[in] base physical address it was placed at
+ * @param[in] size size in bytes
+ * @return true added
+ * @return false the module list is full
+ */
+bool bootinfo_add_module(bootinfo* info, const char* name, uint64_t base, uint64_t size);
+
+/**
+ * @brief Builds the cleaned memory map
+ * @details The E820 entries are sorted, overlaps resolved in favour of the
+ * more restrictive type, neighbours of the same type merged and usable
+ * ranges trimmed to whole pages. Memory stage2 lives in and everything the
+ * frame allocator handed out is then carved out of the usable ranges. Call
+ * this last, after every allocation.
+ *
+ * @param[in] info bootinfo to fill
+ * @param[in] map E820 memory map
+ * @param[in] count number of E820 entries
+ * @return true the map is complete
+ * @return false the map had no room to carve out memory in use, handing
+ * it to the kernel would let it reuse that memory
+ */
+bool bootinfo_finalize(bootinfo* info, const memory_map* map, uint8_t count);
+
+/**
+ * @brief Jumps to the kernel entry with the bootinfo in RDI
+ *
+ * @param[in] entry virtual entry point
+ * @param[in] info the bootinfo
+ * @param[in] stack top of the kernel's initial stack
+ */
+extern "C" void __attribute__((noreturn)) kernel_handoff(uint64_t entry, bootinfo* info, uint64_t stack);
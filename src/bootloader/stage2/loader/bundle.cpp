@@ -0,0 +1,173 @@
+/**
+ * @file bundle.cpp
+ * @author Aidcraft
+ * @brief boot files stored contiguously in front of the partition
+ * @version 0.0.2
+ * @date 2025-03-20
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#include "bundle.h"
+#include "integrity.h"
+#include "../stdio.h"
+#include "../stddef.h"
+#include "../string.h"
+#include "../memory/memory.h"
+
+#define SECTOR_SIZE 512
+#define DISK_MAX_SECTORS 255
+#define MANIFEST_SECTORS ((sizeof(bundle_header) + BUNDLE_MAX_ENTRIES * sizeof(bundle_entry)) / SECTOR_SIZE)
+
+// not zero, so the variable lands in .data where build_disk.py can patch it
+uint32_t boot_bundle_lba = BUNDLE_NONE;
+
+static struct __attribute__((packed))
+{
+    bundle_header header;
+    bundle_entry entries[BUNDLE_MAX_ENTRIES];
+} manifest;
+
+static disk* bundleDisk;
+static uint16_t entryCount;
+
+/// @brief the sector partial reads were last served from
+static uint8_t sectorBuffer[SECTOR_SIZE] __attribute__((aligned(8)));
+static uint32_t bufferedLba = BUNDLE_NONE;
+
+/*
+ * Every entry has to be named and lie inside the bundle, past the header.
+ */
+static bool check_entries(const bundle_header* header)
+{
+    uint64_t end = (uint64_t)header->totalSectors * SECTOR_SIZE;
+
+    for (uint16_t i = 0; i < header->count; i++)
+    {
+        const bundle_entry* entry = &manifest.entries[i];
+        if (entry->name[0] == '\0' || entry->name[BUNDLE_NAME_SIZE - 1] != '\0')
+            return false;
+        if (entry->offset % BUNDLE_ALIGN != 0 || entry->offset < header->headerSize)
+            return false;
+        if ((uint64_t)entry->offset + entry->size > end)
+            return false;
+    }
+    return true;
+}
+
+uint16_t bundle_init(disk* Disk)
+{
+    entryCount = 0;
+    bufferedLba = BUNDLE_NONE;
+    bundleDisk = Disk;
+
+    if (boot_bundle_lba == BUNDLE_NONE)
+        return 0;
+
+    if (!Disk->read(&manifest, MANIFEST_SECTORS, boot_bundle_lba))
+    {
+        puts("BUNDLE: failed to read the header\n");
+        return 0;
+    }
+
+    const bundle_header* header = &manifest.header;
+    if (header->magic != BUNDLE_MAGIC || header->version != BUNDLE_VERSION ||
+        header->count > BUNDLE_MAX_ENTRIES || header->headerSize % BUNDLE_ALIGN != 0)
+    {
+        puts("BUNDLE: bad header, using the FAT copies\n");
+        return 0;
+    }
+
+    uint32_t crc = crc32c_update(CRC32C_INIT, manifest.entries, header->count * sizeof(bundle_entry));
+    if ((crc ^ CRC32C_INIT) != header->entriesCrc || !check_entries(header))
+    {
+        puts("BUNDLE: corrupt manifest, using the FAT copies\n");
+        return 0;
+    }
+
+    entryCount = header->count;
+    return entryCount;
+}
+
+const bundle_entry* bundle_lookup(const char* path)
+{
+    for (uint16_t i = 0; i < entryCount; i++)
+    {
+        if (!strcmp(manifest.entries[i].name, path))
+            return &manifest.entries[i];
+    }
+    return NULL;
+}
+
+/*
+ * Copy part of one sector out of the buffer, reading it first unless it is
+ * the sector that is already there.
+ */
+static bool read_partial(uint32_t LBA, uint32_t offset, uint32_t length, uint8_t* out)
+{
+    if (LBA != bufferedLba)
+    {
+        if (!bundleDisk->read(sectorBuffer, 1, LBA))
+        {
+            bufferedLba = BUNDLE_NONE;
+            return false;
+        }
+        bufferedLba = LBA;
+    }
+    else
+    {
+        bundleDisk->stats.cacheHits++;
+    }
+
+    memcpy(out, sectorBuffer + offset, length);
+    return true;
+}
+
+uint32_t bundle_read(const bundle_entry* entry, uint32_t position, uint32_t byteCount, void* dataOut)
+{
+    if (position >= entry->size)
+        return 0;
+    if (byteCount > entry->size - position)
+        byteCount = entry->size - position;
+
+    uint8_t* out = (uint8_t*)dataOut;
+    uint64_t start = (uint64_t)entry->offset + position;
+    uint32_t LBA = boot_bundle_lba + start / SECTOR_SIZE;
+    uint32_t offset = start % SECTOR_SIZE;
+    uint32_t done = 0;
+
+    if (offset != 0)
+    {
+        uint32_t length = SECTOR_SIZE - offset;
+        if (length > byteCount)
+            length = byteCount;
+        if (!read_partial(LBA, offset, length, out))
+            return 0;
+        done = length;
+        LBA++;
+    }
+
+    while (byteCount - done >= SECTOR_SIZE)
+    {
+        uint32_t count = (byteCount - done) / SECTOR_SIZE;
+        if (count > DISK_MAX_SECTORS)
+            count = DISK_MAX_SECTORS;
+
+        if (!bundleDisk->read(out + done, count, LBA))
+            return done;
+        done += count * SECTOR_SIZE;
+        LBA += count;
+    }
+
+    if (done < byteCount)
+    {
+        if (!read_partial(LBA, 0, byteCount - done, out + done))
+            return done;
+        done = byteCount;
+    }
+
+    return done;
+}
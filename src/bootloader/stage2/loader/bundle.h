@@ -0,0 +1,101 @@
+/**
+ * @file bundle.h
+ * @author Aidcraft
+ * @brief boot files stored contiguously in front of the partition
+ * @version 0.0.2
+ * @date 2025-03-20
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ * @details build_disk.py writes the kernel and the other boot files a
+ * second time between stage2 and the partition and patches the first
+ * sector into boot_bundle_lba. A header page lists every file with its
+ * offset, size and CRC32C, payloads start on page boundaries. Files found
+ * there are read with a few long commands instead of walking the FAT, the
+ * copies on the FAT volume remain for when the bundle is missing or broken.
+ */
+
+#pragma once
+
+#include "../stdint.h"
+#include "../disk.h"
+
+/// @brief "BNDL"
+#define BUNDLE_MAGIC        0x4C444E42
+#define BUNDLE_VERSION      1
+/// @brief Payloads and the header page are aligned to this
+#define BUNDLE_ALIGN        0x1000
+#define BUNDLE_NAME_SIZE    48
+/// @brief The header and its entries fill the first 2KB of the header page
+#define BUNDLE_MAX_ENTRIES  31
+
+/// @brief boot_bundle_lba when the image has no bundle
+#define BUNDLE_NONE         0xFFFFFFFF
+
+/// @brief Start of the bundle on the disk, patched by build_disk.py
+extern "C" uint32_t boot_bundle_lba;
+
+/// @brief Head of the header page
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+    /// @brief bytes in front of the first payload, a multiple of BUNDLE_ALIGN
+    uint32_t headerSize;
+    /// @brief sectors covered by the whole bundle
+    uint32_t totalSectors;
+    /// @brief CRC32C of the count entries following the header
+    uint32_t entriesCrc;
+    uint8_t reserved[44];
+} bundle_header;
+
+/// @brief One file in the bundle
+typedef struct __attribute__((packed))
+{
+    /// @brief path as passed to open, without a leading '/'
+    char name[BUNDLE_NAME_SIZE];
+    /// @brief from the start of the bundle, a multiple of BUNDLE_ALIGN
+    uint32_t offset;
+    uint32_t size;
+    /// @brief CRC32C of the payload
+    uint32_t crc;
+    uint32_t reserved;
+} bundle_entry;
+
+static_assert(sizeof(bundle_header) == 64, "bundle header is 64 bytes");
+static_assert(sizeof(bundle_entry) == 64, "bundle entries are 64 bytes");
+
+/**
+ * @brief Reads and checks the bundle header
+ * @details Needs crc32c_init. Without a bundle, or when it fails its
+ * checks, every lookup misses and files come from the FAT volume.
+ *
+ * @param[in] Disk disk the bundle is read from
+ * @return uint16_t number of files in the bundle
+ */
+uint16_t bundle_init(disk* Disk);
+
+/**
+ * @brief Finds a file in the bundle
+ *
+ * @param[in] path path as passed to open, without a leading '/'
+ * @return const bundle_entry* the file, NULL when it isn't bundled
+ */
+const bundle_entry* bundle_lookup(const char* path);
+
+/**
+ * @brief Reads part of a bundled file
+ * @details Whole sectors go straight to dataOut in commands as long as the
+ * disk takes, partial ones go through a one sector buffer that is kept for
+ * the next read.
+ *
+ * @param[in] entry the file
+ * @param[in] position byte offset in the file
+ * @param[in] byteCount bytes to read
+ * @param[out] dataOut where to read to
+ * @return uint32_t bytes read, short at the end of the file or on errors
+ */
+uint32_t bundle_read(const bundle_entry* entry, uint32_t position, uint32_t byteCount, void* dataOut);
@@ -0,0 +1,322 @@
+/**
+ * @file elf.cpp
+ * @author Aidcraft
+ * @brief ELF64 kernel loader
+ * @version 0.0.2
+ * @date 2025-03-08
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#include "elf.h"
+#include "../stdio.h"
+#include "../memory/memory.h"
+#include "../memory/paging.h"
+#include "../memory/frames.h"
+#include "../memory/zero.h"
+
+#define PAGE_SIZE 0x1000
+#define PAGE_MASK (PAGE_SIZE - 1)
+#define LARGE_PAGE_SIZE 0x200000
+
+/// @brief Segment tails cleared in the background at once, the rest are cleared in place
+#define ELF_MAX_TAILS 4
+
+static bool check_header(const Elf64_Ehdr* header, bool allow32)
+{
+    if (header->magic != ELF_MAGIC)
+    {
+        puts("ELF: bad magic\n");
+        return false;
+    }
+
+    bool is64 = header->fileClass == ELF_CLASS_64 && header->machine == ELF_MACHINE_X86_64;
+    bool is32 = header->fileClass == ELF_CLASS_32 && header->machine == ELF_MACHINE_386;
+    if (header->data != ELF_DATA_LSB || !(is64 || (allow32 && is32)))
+    {
+        puts("ELF: not a little endian x86 image for this mode\n");
+        return false;
+    }
+
+    if (header->type != ELF_TYPE_EXEC)
+    {
+        puts("ELF: not an executable\n");
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Read the file and program headers, widening ELF32 ones so the rest of the
+ * loader only deals with the 64 bit layout.
+ */
+static bool read_headers(imageFile* file, bool allow32, uint64_t* entry, Elf64_Phdr* phdrs, uint16_t* phnum)
+{
+    union
+    {
+        Elf64_Ehdr h64;
+        Elf32_Ehdr h32;
+    } header;
+
+    if (!file->seek(0) || file->read(sizeof(header.h64), &header) != sizeof(header.h64))
+    {
+        puts("ELF: failed to read header\n");
+        return false;
+    }
+
+    if (!check_header(&header.h64, allow32))
+        return false;
+
+    bool is32 = header.h64.fileClass == ELF_CLASS_32;
+    uint64_t phoff = is32 ? header.h32.phoff : header.h64.phoff;
+    uint16_t phentsize = is32 ? header.h32.phentsize : header.h64.phentsize;
+    *phnum = is32 ? header.h32.phnum : header.h64.phnum;
+    *entry = is32 ? header.h32.entry : header.h64.entry;
+
+    uint32_t expected = is32 ? sizeof(Elf32_Phdr) : sizeof(Elf64_Phdr);
+    if (phentsize != expected || *phnum == 0 || *phnum > ELF_MAX_PHDRS)
+    {
+        puts("ELF: unsupported program header table\n");
+        return false;
+    }
+
+    // ELF32 headers are read into the back half of the array and widened in place
+    uint32_t phdrBytes = *phnum * phentsize;
+    void* raw = is32 ? (void*)((uint8_t*)phdrs + sizeof(Elf64_Phdr) * ELF_MAX_PHDRS - phdrBytes) : (void*)phdrs;
+    if (!file->seek(phoff) || file->read(phdrBytes, raw) != phdrBytes)
+    {
+        puts("ELF: failed to read program headers\n");
+        return false;
+    }
+
+    if (is32)
+    {
+        Elf32_Phdr* narrow = (Elf32_Phdr*)raw;
+        for (uint16_t i = 0; i < *phnum; i++)
+        {
+            Elf32_Phdr source = narrow[i];
+            phdrs[i].type = source.type;
+            phdrs[i].flags = source.flags;
+            phdrs[i].offset = source.offset;
+            phdrs[i].vaddr = source.vaddr;
+            phdrs[i].paddr = source.paddr;
+            phdrs[i].filesz = source.filesz;
+            phdrs[i].memsz = source.memsz;
+            phdrs[i].align = source.align;
+        }
+    }
+
+    return true;
+}
+
+static uint32_t segment_flags(const Elf64_Phdr* phdr)
+{
+    uint32_t flags = MAP_GLOBAL;
+    if (phdr->flags & ELF_PF_W)
+        flags |= MAP_WRITE;
+    if (phdr->flags & ELF_PF_X)
+        flags |= MAP_EXEC;
+    return flags;
+}
+
+/*
+ * Segments below MEMORY_IDENTITY_END are already mapped 1:1, so they are
+ * loaded at that physical address. Everything else gets fresh frames.
+ * Identity placed segments get their p_flags by splitting the 2MB pages
+ * under them.
+ */
+static bool is_identity(const Elf64_Phdr* phdr)
+{
+    return phdr->vaddr + phdr->memsz <= MEMORY_IDENTITY_END;
+}
+
+static bool map_segment(const Elf64_Phdr* phdr, bool physical)
+{
+    uint64_t virt = phdr->vaddr & ~(uint64_t)PAGE_MASK;
+    uint64_t size = (phdr->vaddr + phdr->memsz + PAGE_MASK) & ~(uint64_t)PAGE_MASK;
+    size -= virt;
+
+    // physical images run with paging off, the mapping doesn't matter
+    if (physical)
+        return true;
+
+    if (is_identity(phdr))
+    {
+        uint32_t flags = segment_flags(phdr);
+        if ((flags & MAP_DEFAULT) == MAP_DEFAULT)
+            return true;
+
+        for (uint64_t large = virt & ~(uint64_t)(LARGE_PAGE_SIZE - 1); large < virt + size; large += LARGE_PAGE_SIZE)
+        {
+            if (!page_split(large))
+            {
+                puts("ELF: out of page tables for segment permissions\n");
+                return false;
+            }
+        }
+        page_range(virt, virt, size, flags);
+        return true;
+    }
+
+    uint64_t phys = frames_alloc(size / PAGE_SIZE);
+    if (phys == 0)
+    {
+        puts("ELF: out of memory for segment\n");
+        return false;
+    }
+
+    page_range(phys, virt, size, segment_flags(phdr));
+    return true;
+}
+
+/*
+ * Place every PT_LOAD at phdr->vaddr. In physical mode the caller has
+ * already copied p_paddr into vaddr, so only identity placement is allowed.
+ */
+static bool load_segments(imageFile* file, Elf64_Phdr* phdrs, uint16_t phnum, bool physical, elf_image* image)
+{
+    image->virtStart = 0xFFFFFFFFFFFFFFFF;
+    image->virtEnd = 0;
+
+    // claim identity placed segments first so fresh frames never land on them
+    uint64_t previousEnd = 0;
+    for (uint16_t i = 0; i < phnum; i++)
+    {
+        Elf64_Phdr* phdr = &phdrs[i];
+        if (phdr->type != ELF_PT_LOAD || phdr->memsz == 0)
+            continue;
+
+        if (phdr->filesz > phdr->memsz || (!physical && (phdr->vaddr & PAGE_MASK) != (phdr->offset & PAGE_MASK)))
+        {
+            puts("ELF: malformed segment\n");
+            return false;
+        }
+
+        // every segment gets its own pages, so they must not share one
+        if ((phdr->vaddr & ~(uint64_t)PAGE_MASK) < previousEnd)
+        {
+            puts("ELF: segments overlap or are out of order\n");
+            return false;
+        }
+        previousEnd = (phdr->vaddr + phdr->memsz + PAGE_MASK) & ~(uint64_t)PAGE_MASK;
+
+        if (physical && !is_identity(phdr))
+        {
+            puts("ELF: physical segment outside the identity map\n");
+            return false;
+        }
+
+        if (is_identity(phdr) && !frames_reserve(phdr->vaddr, phdr->memsz))
+        {
+            puts("ELF: segment is not in usable memory\n");
+            return false;
+        }
+    }
+
+    // tails are cleared by the other cpus while the next segment is read
+    zero_request tails[ELF_MAX_TAILS];
+    uint16_t tailCount = 0;
+    bool ok = true;
+
+    for (uint16_t i = 0; i < phnum; i++)
+    {
+        Elf64_Phdr* phdr = &phdrs[i];
+        if (phdr->type != ELF_PT_LOAD || phdr->memsz == 0)
+            continue;
+
+        if (!map_segment(phdr, physical))
+        {
+            ok = false;
+            break;
+        }
+
+        // CR0.WP is clear in stage2, so read-only pages can still be filled in
+        uint8_t* dest = (uint8_t*)phdr->vaddr;
+
+        if (phdr->filesz != 0)
+        {
+            if (!file->seek(phdr->offset) || file->read(phdr->filesz, dest) != phdr->filesz)
+            {
+                puts("ELF: failed to read segment\n");
+                ok = false;
+                break;
+            }
+        }
+
+        if (phdr->memsz > phdr->filesz)
+        {
+            if (tailCount < ELF_MAX_TAILS)
+                zero_range_start(&tails[tailCount++], dest + phdr->filesz, phdr->memsz - phdr->filesz);
+            else
+                zero_range(dest + phdr->filesz, phdr->memsz - phdr->filesz);
+        }
+
+        if (phdr->vaddr < image->virtStart)
+            image->virtStart = phdr->vaddr;
+        if (phdr->vaddr + phdr->memsz > image->virtEnd)
+            image->virtEnd = phdr->vaddr + phdr->memsz;
+    }
+
+    for (uint16_t i = 0; i < tailCount; i++)
+        zero_range_wait(&tails[i]);
+
+    if (!ok)
+        return false;
+
+    if (image->virtEnd == 0)
+    {
+        puts("ELF: no loadable segments\n");
+        return false;
+    }
+
+    return true;
+}
+
+bool elf_load(imageFile* file, elf_image* image)
+{
+    Elf64_Phdr phdrs[ELF_MAX_PHDRS];
+    uint16_t phnum;
+
+    if (!read_headers(file, false, &image->entry, phdrs, &phnum))
+        return false;
+
+    return load_segments(file, phdrs, phnum, false, image);
+}
+
+bool elf_load_physical(imageFile* file, elf_image* image)
+{
+    Elf64_Phdr phdrs[ELF_MAX_PHDRS];
+    uint16_t phnum;
+
+    if (!read_headers(file, true, &image->entry, phdrs, &phnum))
+        return false;
+
+    // e_entry is virtual, a higher half kernel has to be entered at the
+    // physical address of the segment holding it, like GRUB does
+    uint64_t entry = 0xFFFFFFFFFFFFFFFF;
+    for (uint16_t i = 0; i < phnum; i++)
+    {
+        Elf64_Phdr* phdr = &phdrs[i];
+        if (phdr->type == ELF_PT_LOAD && image->entry >= phdr->vaddr && image->entry - phdr->vaddr < phdr->memsz)
+        {
+            entry = image->entry - phdr->vaddr + phdr->paddr;
+            break;
+        }
+    }
+
+    if (entry > 0xFFFFFFFF)
+    {
+        puts("ELF: entry point is not in a segment below 4 GB\n");
+        return false;
+    }
+    image->entry = entry;
+
+    for (uint16_t i = 0; i < phnum; i++)
+        phdrs[i].vaddr = phdrs[i].paddr;
+
+    return load_segments(file, phdrs, phnum, true, image);
+}
@@ -0,0 +1,150 @@
+/**
+ * @file elf.h
+ * @author Aidcraft
+ * @brief ELF64 kernel loader
+ * @version 0.0.2
+ * @date 2025-03-08
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#pragma once
+
+#include "../stdint.h"
+#include "image.h"
+
+#define ELF_MAGIC           0x464C457F // "\x7F" "ELF"
+#define ELF_CLASS_32        1
+#define ELF_CLASS_64        2
+#define ELF_DATA_LSB        1
+#define ELF_TYPE_EXEC       2
+#define ELF_MACHINE_386     0x03
+#define ELF_MACHINE_X86_64  0x3E
+
+#define ELF_PT_LOAD         1
+
+#define ELF_PF_X            0x1
+#define ELF_PF_W            0x2
+#define ELF_PF_R            0x4
+
+/// @brief Most program headers the loader will look at
+#define ELF_MAX_PHDRS       32
+
+/// @brief ELF64 file header
+typedef struct
+{
+    uint32_t magic;
+    uint8_t fileClass;
+    uint8_t data;
+    uint8_t identVersion;
+    uint8_t osAbi;
+    uint8_t _padding[8];
+    uint16_t type;
+    uint16_t machine;
+    uint32_t version;
+    uint64_t entry;
+    uint64_t phoff;
+    uint64_t shoff;
+    uint32_t flags;
+    uint16_t ehsize;
+    uint16_t phentsize;
+    uint16_t phnum;
+    uint16_t shentsize;
+    uint16_t shnum;
+    uint16_t shstrndx;
+} __attribute__((packed)) Elf64_Ehdr;
+
+/// @brief ELF64 program header
+typedef struct
+{
+    uint32_t type;
+    uint32_t flags;
+    uint64_t offset;
+    uint64_t vaddr;
+    uint64_t paddr;
+    uint64_t filesz;
+    uint64_t memsz;
+    uint64_t align;
+} __attribute__((packed)) Elf64_Phdr;
+
+/// @brief ELF32 file header
+typedef struct
+{
+    uint32_t magic;
+    uint8_t fileClass;
+    uint8_t data;
+    uint8_t identVersion;
+    uint8_t osAbi;
+    uint8_t _padding[8];
+    uint16_t type;
+    uint16_t machine;
+    uint32_t version;
+    uint32_t entry;
+    uint32_t phoff;
+    uint32_t shoff;
+    uint32_t flags;
+    uint16_t ehsize;
+    uint16_t phentsize;
+    uint16_t phnum;
+    uint16_t shentsize;
+    uint16_t shnum;
+    uint16_t shstrndx;
+} __attribute__((packed)) Elf32_Ehdr;
+
+/// @brief ELF32 program header
+typedef struct
+{
+    uint32_t type;
+    uint32_t offset;
+    uint32_t vaddr;
+    uint32_t paddr;
+    uint32_t filesz;
+    uint32_t memsz;
+    uint32_t flags;
+    uint32_t align;
+} __attribute__((packed)) Elf32_Phdr;
+
+/// @brief Where the loader put an image
+typedef struct
+{
+    /// @brief Virtual entry point
+    uint64_t entry;
+    /// @brief Lowest virtual address that was mapped
+    uint64_t virtStart;
+    /// @brief One past the highest virtual address that was mapped
+    uint64_t virtEnd;
+} elf_image;
+
+/**
+ * @brief Loads the PT_LOAD segments of an ELF64 executable
+ * @details Each segment is mapped at its p_vaddr with permissions taken from
+ * p_flags, p_filesz bytes are streamed from the file straight into place and
+ * the rest of p_memsz is zeroed. Segments whose p_vaddr falls inside the
+ * identity map are placed at that physical address instead, the 2MB pages
+ * under them are split so p_flags still apply. Nothing outside the loadable
+ * segments is read.
+ *
+ * @param[in] file the opened ELF file
+ * @param[out] image entry point and extent of the loaded image
+ * @return true the image was loaded
+ * @return false the file is not a loadable x86-64 executable
+ */
+bool elf_load(imageFile* file, elf_image* image);
+
+/**
+ * @brief Loads an ELF32 or ELF64 executable at its physical addresses
+ * @details Used for kernels entered with paging off (multiboot): every
+ * PT_LOAD is placed at p_paddr, which must lie in usable memory inside the
+ * identity map. No mappings are created. e_entry is translated through the
+ * PT_LOAD that contains it, so linking the kernel at a higher half p_vaddr
+ * is fine.
+ *
+ * @param[in] file the opened ELF file
+ * @param[out] image physical entry point and extent of the loaded image
+ * @return true the image was loaded
+ * @return false the file is not a loadable x86 executable
+ */
+bool elf_load_physical(imageFile* file, elf_image* image);
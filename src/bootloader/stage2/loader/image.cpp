@@ -0,0 +1,414 @@
+/**
+ * @file image.cpp
+ * @author Aidcraft
+ * @brief reads boot images from the FAT volume, decompressing them on the fly
+ * @version 0.0.2
+ * @date 2025-03-12
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#include "image.h"
+#include "../stdio.h"
+#include "../stddef.h"
+#include "../memory/memory.h"
+#include "integrity.h"
+#include "../arch/x86-64/smp.h"
+#include "../arch/x86-64/cpu.h"
+#include "../trace.h"
+
+/// @brief reads shorter than a sector aren't traced
+#define TRACE_MIN_SPAN 512
+
+static uint8_t* const lz4Input = (uint8_t*)MEMORY_LZ4_INPUT_START;
+static uint8_t* const lz4Window = (uint8_t*)MEMORY_LZ4_WINDOW_START;
+
+/// @brief One block handed to the decoder
+struct lz4_decode_job
+{
+    smp_job job;
+    const uint8_t* src;
+    uint32_t srcSize;
+    uint8_t* dst;
+    uint32_t capacity;
+    /// @brief decoded size, -1 when the block is corrupt
+    int32_t result;
+};
+
+static void decode_task(void* arg, uint32_t)
+{
+    lz4_decode_job* job = (lz4_decode_job*)arg;
+    job->result = lz4_decode_block(job->src, job->srcSize, job->dst, job->capacity);
+}
+
+/*
+ * Add a decoded block to the running total. Only the final block of a frame
+ * may be short, anything placed after a short one would be misplaced.
+ */
+static bool account_block(const lz4_decode_job* job, uint32_t blockMaxSize, uint32_t* produced)
+{
+    if (job->result <= 0 || *produced % blockMaxSize != 0)
+        return false;
+    *produced += job->result;
+    return true;
+}
+
+imageFile::imageFile(fatFS* fs)
+{
+    this->fs = fs;
+    file = NULL;
+    bundled = NULL;
+    compressed = false;
+}
+
+bool imageFile::open(const char* path)
+{
+    // the bundle copy saves the directory walk and the cluster chain
+    bundled = bundle_lookup(path);
+    if (bundled != NULL)
+    {
+        bundlePosition = 0;
+        checked = true;
+        expectedCrc = bundled->crc;
+    }
+    else
+    {
+        file = fs->open(path);
+        if (file == NULL)
+            return false;
+        checked = integrity_lookup(path, &expectedCrc);
+    }
+
+    compressed = false;
+    position = 0;
+    crc = CRC32C_INIT;
+    crcPosition = 0;
+
+    uint8_t header[LZ4_MAX_HEADER_SIZE];
+    uint32_t length = readRaw(sizeof(header), header);
+
+    if (length >= 4 && *(uint32_t*)header == LZ4_FRAME_MAGIC)
+    {
+        if (!lz4_parse_frame(header, length, &frame))
+        {
+            puts("LZ4: unsupported frame\n");
+            close();
+            return false;
+        }
+
+        // the decoder keeps no history between blocks and buffers one block at most
+        if (!frame.independentBlocks || frame.blockMaxSize > MEMORY_LZ4_WINDOW_SIZE)
+        {
+            puts("LZ4: needs independent blocks of at most 64KB\n");
+            close();
+            return false;
+        }
+
+        compressed = true;
+        return restart();
+    }
+
+    return seekRaw(0);
+}
+
+void imageFile::close()
+{
+    if (file != NULL)
+        fs->close(file);
+    file = NULL;
+    bundled = NULL;
+}
+
+/*
+ * Every read of the file on disk goes through here. Bytes that extend the
+ * checksummed prefix are folded in while they are still in cache, so a
+ * straight pass over the file costs no extra read.
+ */
+uint32_t imageFile::readRaw(uint32_t byteCount, void* dataOut)
+{
+    uint64_t start = bundled ? bundlePosition : file->Position;
+    uint64_t startTsc = rdtsc();
+    uint32_t length;
+    if (bundled)
+    {
+        length = bundle_read(bundled, bundlePosition, byteCount, dataOut);
+        bundlePosition += length;
+    }
+    else
+    {
+        length = fs->read(file, byteCount, dataOut);
+    }
+
+    // block headers and other small reads would only crowd the trace ring
+    if (length >= TRACE_MIN_SPAN)
+        trace_span("image read", startTsc, length);
+
+    if (checked && start <= crcPosition && start + length > crcPosition)
+    {
+        crc = crc32c_update(crc, (uint8_t*)dataOut + (crcPosition - start), start + length - crcPosition);
+        crcPosition = start + length;
+    }
+
+    return length;
+}
+
+/*
+ * Skipping ahead would leave a hole in the checksum, so the bytes in
+ * between are read and folded in first. Only uncompressed files ever seek
+ * forwards, which leaves the LZ4 input buffer free to stage them.
+ */
+bool imageFile::seekRaw(uint64_t position)
+{
+    if (checked && position > crcPosition)
+    {
+        if (!seekFile(crcPosition))
+            return false;
+
+        while (crcPosition < position)
+        {
+            uint32_t chunk = MEMORY_LZ4_INPUT_SIZE;
+            if (position - crcPosition < chunk)
+                chunk = position - crcPosition;
+            if (readRaw(chunk, (void*)MEMORY_LZ4_INPUT_START) != chunk)
+                return false;
+        }
+    }
+
+    return seekFile(position);
+}
+
+bool imageFile::seekFile(uint64_t position)
+{
+    if (!bundled)
+        return fs->seek(file, position);
+
+    if (position > bundled->size)
+        return false;
+    bundlePosition = position;
+    return true;
+}
+
+uint64_t imageFile::fileSize()
+{
+    return bundled ? bundled->size : file->Size;
+}
+
+bool imageFile::verify()
+{
+    if (!checked)
+        return true;
+
+    if (!seekRaw(fileSize()))
+        return false;
+
+    if ((crc ^ CRC32C_INIT) != expectedCrc)
+    {
+        puts("IMAGE: checksum mismatch\n");
+        return false;
+    }
+    return true;
+}
+
+bool imageFile::isCompressed()
+{
+    return compressed;
+}
+
+uint64_t imageFile::size()
+{
+    return compressed ? frame.contentSize : fileSize();
+}
+
+bool imageFile::restart()
+{
+    streamEnd = 0;
+    windowLength = 0;
+    finished = false;
+    return seekRaw(frame.headerSize);
+}
+
+/*
+ * Read the next block header and body. Stored blocks go straight to dst,
+ * compressed ones land in input and are described in job for the decoder
+ * (srcSize stays 0 when there is nothing to decode). Sets finished at the
+ * end mark, returns false on errors.
+ */
+bool imageFile::readBlock(uint8_t* input, uint8_t* dst, uint32_t capacity, lz4_decode_job* job)
+{
+    job->srcSize = 0;
+    job->result = 0;
+
+    uint32_t blockSize;
+    if (readRaw(sizeof(blockSize), &blockSize) != sizeof(blockSize))
+        return false;
+
+    if (blockSize == 0)
+    {
+        finished = true;
+        return true;
+    }
+
+    bool stored = blockSize & LZ4_BLOCK_UNCOMPRESSED;
+    blockSize &= ~LZ4_BLOCK_UNCOMPRESSED;
+    if (blockSize > frame.blockMaxSize || blockSize > capacity)
+        return false;
+
+    if (stored)
+    {
+        if (readRaw(blockSize, dst) != blockSize)
+            return false;
+        job->result = blockSize;
+    }
+    else
+    {
+        if (readRaw(blockSize, input) != blockSize)
+            return false;
+        job->src = input;
+        job->srcSize = blockSize;
+        job->dst = dst;
+        job->capacity = capacity;
+    }
+
+    uint32_t checksum;
+    return !frame.blockChecksum || readRaw(sizeof(checksum), &checksum) == sizeof(checksum);
+}
+
+/*
+ * Read the next block and decode it into dst. Returns the decoded size, 0
+ * at the end of the frame and -1 on errors.
+ */
+int32_t imageFile::nextBlock(uint8_t* dst, uint32_t capacity)
+{
+    lz4_decode_job job;
+    if (!readBlock(lz4Input, dst, capacity, &job))
+        return -1;
+
+    if (job.srcSize != 0)
+        decode_task(&job, 0);
+    return job.result;
+}
+
+/*
+ * Decode whole blocks straight into out. While one block is decoded on
+ * another cpu the next is read into the other buffer (the window is dead
+ * once a read bypasses it); without APs smp_wait just decodes on the BSP.
+ * Every block but the last of a frame is exactly blockMaxSize, which fixes
+ * where a block lands before the one ahead of it is decoded. Returns the
+ * bytes produced, -1 on errors.
+ */
+int64_t imageFile::readDirect(uint8_t* out, uint32_t blocks)
+{
+    uint8_t* inputs[2] = {lz4Input, lz4Window};
+    lz4_decode_job jobs[2];
+    lz4_decode_job* pending = NULL;
+    uint32_t produced = 0;
+    bool ok = true;
+
+    windowLength = 0;
+
+    for (uint32_t i = 0; i < blocks && ok && !finished; i++)
+    {
+        lz4_decode_job* current = &jobs[i & 1];
+        ok = readBlock(inputs[i & 1], out + (uint64_t)i * frame.blockMaxSize, frame.blockMaxSize, current);
+        if (ok && current->srcSize != 0)
+        {
+            current->job.task = decode_task;
+            current->job.arg = current;
+            current->job.parts = 1;
+            smp_submit(&current->job);
+        }
+
+        if (pending != NULL)
+        {
+            smp_wait(&pending->job);
+            ok = account_block(pending, frame.blockMaxSize, &produced) && ok;
+            pending = NULL;
+        }
+
+        if (!ok || finished)
+            break;
+
+        if (current->srcSize != 0)
+            pending = current;
+        else
+            ok = account_block(current, frame.blockMaxSize, &produced);
+    }
+
+    if (pending != NULL)
+    {
+        smp_wait(&pending->job);
+        ok = account_block(pending, frame.blockMaxSize, &produced) && ok;
+    }
+
+    return ok ? produced : -1;
+}
+
+bool imageFile::seek(uint64_t position)
+{
+    if (!compressed)
+        return seekRaw(position);
+
+    if (position < streamEnd - windowLength && !restart())
+        return false;
+
+    this->position = position;
+    return true;
+}
+
+uint32_t imageFile::read(uint32_t byteCount, void* dataOut)
+{
+    if (!compressed)
+        return readRaw(byteCount, dataOut);
+
+    uint8_t* out = (uint8_t*)dataOut;
+    uint32_t done = 0;
+
+    while (done < byteCount)
+    {
+        uint64_t windowStart = streamEnd - windowLength;
+        if (position >= windowStart && position < streamEnd)
+        {
+            uint32_t take = streamEnd - position;
+            if (take > byteCount - done)
+                take = byteCount - done;
+            memcpy(out + done, lz4Window + (position - windowStart), take);
+            position += take;
+            done += take;
+            continue;
+        }
+
+        if (finished)
+            break;
+
+        // whole blocks the caller wants are decoded in place, anything else goes through the window
+        int64_t decoded;
+        if (position == streamEnd && byteCount - done >= frame.blockMaxSize)
+        {
+            decoded = readDirect(out + done, (byteCount - done) / frame.blockMaxSize);
+            if (decoded > 0)
+            {
+                position += decoded;
+                done += decoded;
+            }
+        }
+        else
+        {
+            decoded = nextBlock(lz4Window, MEMORY_LZ4_WINDOW_SIZE);
+            if (decoded > 0)
+                windowLength = decoded;
+        }
+
+        if (decoded < 0)
+        {
+            puts("LZ4: corrupt or truncated block\n");
+            finished = true;
+            break;
+        }
+        streamEnd += decoded;
+    }
+
+    return done;
+}
@@ -0,0 +1,98 @@
+/**
+ * @file image.h
+ * @author Aidcraft
+ * @brief reads boot images from the FAT volume, decompressing them on the fly
+ * @version 0.0.2
+ * @date 2025-03-12
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#pragma once
+
+#include "../stdint.h"
+#include "../fs/FAT/fat.h"
+#include "lz4.h"
+#include "bundle.h"
+
+struct lz4_decode_job;
+
+/**
+ * @brief A file the loaders read from
+ * @details Files that start with an LZ4 frame are decompressed block by
+ * block as they are read, so callers only ever see the original contents.
+ * Each block is decoded as soon as it has been read off the disk, straight
+ * into the caller's buffer when the read covers whole blocks. Those are
+ * decoded on an application processor while the next block is read. Seeking
+ * forwards skips data by decoding it, seeking backwards restarts the frame.
+ * Files in the boot bundle are read from there, anything else from the FAT
+ * volume. When the bundle or the integrity manifest has a checksum for the
+ * file, a CRC32C of the bytes on disk is folded in as each read lands and
+ * checked by verify().
+ * The LZ4 buffers live at fixed addresses, so only one image may be open
+ * at a time.
+ */
+class imageFile
+{
+private:
+    fatFS* fs;
+    FAT_File* file;
+    /// @brief the file in the boot bundle, NULL when it comes from FAT
+    const bundle_entry* bundled;
+    /// @brief read position in a bundled file
+    uint32_t bundlePosition;
+    bool compressed;
+    lz4_frame frame;
+    /// @brief position in the decompressed contents
+    uint64_t position;
+    /// @brief decompressed offset one past the last decoded block
+    uint64_t streamEnd;
+    /// @brief how much of the last decoded block is in the window
+    uint32_t windowLength;
+    bool finished;
+    /// @brief whether the bundle or the manifest has a checksum for this file
+    bool checked;
+    uint32_t expectedCrc;
+    uint32_t crc;
+    /// @brief offset in the file on disk up to which crc has been computed
+    uint64_t crcPosition;
+    uint32_t readRaw(uint32_t byteCount, void* dataOut);
+    bool seekRaw(uint64_t position);
+    bool seekFile(uint64_t position);
+    uint64_t fileSize();
+    bool restart();
+    bool readBlock(uint8_t* input, uint8_t* dst, uint32_t capacity, lz4_decode_job* job);
+    int32_t nextBlock(uint8_t* dst, uint32_t capacity);
+    int64_t readDirect(uint8_t* out, uint32_t blocks);
+public:
+    /// @brief Opens a file and checks whether it is compressed
+    /// @param path Path to the file
+    /// @return Success or failure
+    bool open(const char* path);
+    /// @brief Closes the file
+    void close();
+    /// @brief Checks the file against its manifest checksum
+    /// @details Parts of the file that were never read are read now.
+    /// @return false on a mismatch, true when it matches or isn't listed
+    bool verify();
+    /// @brief Reads the decompressed contents
+    /// @param byteCount number of bytes to read
+    /// @param dataOut buffer to read to
+    /// @return number of bytes read
+    uint32_t read(uint32_t byteCount, void* dataOut);
+    /// @brief Moves the read position
+    /// @param position Byte offset in the decompressed contents
+    /// @return Success or failure
+    bool seek(uint64_t position);
+    /// @brief Size of the decompressed contents
+    /// @return size in bytes, 0 if a compressed file doesn't record it
+    uint64_t size();
+    /// @brief Whether the file on disk is compressed
+    bool isCompressed();
+    /// @brief Constructor for an image file
+    /// @param fs file system the image lives on
+    imageFile(fatFS* fs);
+};
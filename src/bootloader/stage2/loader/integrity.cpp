@@ -0,0 +1,184 @@
+/**
+ * @file integrity.cpp
+ * @author Aidcraft
+ * @brief CRC32C checksums of boot images
+ * @version 0.0.2
+ * @date 2025-03-13
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#include "integrity.h"
+#include "../stdio.h"
+#include "../stddef.h"
+#include "../string.h"
+#include "../memory/memory.h"
+#include "../arch/x86-64/cpu.h"
+
+/// @brief reflected Castagnoli polynomial
+#define CRC32C_POLY 0x82F63B78
+
+#define MAX_MANIFEST_SIZE 0x1000
+
+typedef struct
+{
+    uint32_t crc;
+    char path[INTEGRITY_PATH_SIZE];
+} manifest_entry;
+
+static manifest_entry manifest[INTEGRITY_MAX_ENTRIES];
+static uint8_t manifestCount;
+
+static bool hasSse42;
+static uint32_t (*const table)[256] = (uint32_t (*)[256])MEMORY_CRC_TABLE_START;
+
+void crc32c_init()
+{
+    hasSse42 = cpuid(1).ecx & CPUID_01_ECX_SSE42;
+    if (hasSse42)
+        return;
+
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t crc = i;
+        for (uint8_t bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLY : 0);
+        table[0][i] = crc;
+    }
+
+    // table[n][i] is the crc of byte i followed by n zero bytes
+    for (uint32_t i = 0; i < 256; i++)
+        for (uint8_t n = 1; n < 8; n++)
+            table[n][i] = (table[n - 1][i] >> 8) ^ table[0][table[n - 1][i] & 0xFF];
+}
+
+static uint32_t crc32c_hardware(uint32_t crc, const uint8_t* data, uint64_t size)
+{
+    uint64_t value = crc;
+
+    while (size != 0 && ((uint64_t)data & 7))
+    {
+        asm("crc32b %1, %k0" : "+r"(value) : "rm"(*data));
+        data++;
+        size--;
+    }
+
+    for (; size >= 8; size -= 8, data += 8)
+        asm("crc32q %1, %0" : "+r"(value) : "rm"(*(const uint64_t*)data));
+
+    for (; size != 0; size--, data++)
+        asm("crc32b %1, %k0" : "+r"(value) : "rm"(*data));
+
+    return value;
+}
+
+static uint32_t crc32c_sliced(uint32_t crc, const uint8_t* data, uint64_t size)
+{
+    for (; size >= 8; size -= 8, data += 8)
+    {
+        uint32_t low = *(const uint32_t*)data ^ crc;
+        uint32_t high = *(const uint32_t*)(data + 4);
+        crc = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF] ^
+              table[5][(low >> 16) & 0xFF] ^ table[4][low >> 24] ^
+              table[3][high & 0xFF] ^ table[2][(high >> 8) & 0xFF] ^
+              table[1][(high >> 16) & 0xFF] ^ table[0][high >> 24];
+    }
+
+    for (; size != 0; size--, data++)
+        crc = (crc >> 8) ^ table[0][(crc ^ *data) & 0xFF];
+
+    return crc;
+}
+
+uint32_t crc32c_update(uint32_t crc, const void* data, uint64_t size)
+{
+    if (hasSse42)
+        return crc32c_hardware(crc, (const uint8_t*)data, size);
+    return crc32c_sliced(crc, (const uint8_t*)data, size);
+}
+
+static bool parse_hex(const char* text, uint32_t length, uint32_t* value)
+{
+    if (length == 0 || length > 8)
+        return false;
+
+    *value = 0;
+    for (uint32_t i = 0; i < length; i++)
+    {
+        char c = text[i];
+        uint8_t digit;
+        if (c >= '0' && c <= '9')
+            digit = c - '0';
+        else if (c >= 'a' && c <= 'f')
+            digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            digit = c - 'A' + 10;
+        else
+            return false;
+        *value = (*value << 4) | digit;
+    }
+    return true;
+}
+
+uint8_t integrity_load(fatFS* fs)
+{
+    manifestCount = 0;
+
+    FAT_File* file = fs->open(INTEGRITY_MANIFEST_PATH);
+    if (file == NULL)
+        return 0;
+
+    char* text = (char*)MEMORY_SCRATCH_START;
+    uint32_t length = fs->read(file, MAX_MANIFEST_SIZE, text);
+    fs->close(file);
+
+    uint32_t position = 0;
+    while (position < length && manifestCount < INTEGRITY_MAX_ENTRIES)
+    {
+        uint32_t start = position;
+        while (position < length && text[position] != '\n')
+            position++;
+        uint32_t end = position++;
+        while (end > start && (text[end - 1] == '\r' || text[end - 1] == ' '))
+            end--;
+
+        // "<crc> <path>", same layout as the output of the usual checksum tools
+        uint32_t split = start;
+        while (split < end && text[split] != ' ')
+            split++;
+
+        manifest_entry* entry = &manifest[manifestCount];
+        if (!parse_hex(text + start, split - start, &entry->crc))
+            continue;
+
+        while (split < end && (text[split] == ' ' || text[split] == '/'))
+            split++;
+        if (split == end || end - split >= INTEGRITY_PATH_SIZE)
+            continue;
+
+        memcpy(entry->path, text + split, end - split);
+        entry->path[end - split] = '\0';
+        manifestCount++;
+    }
+
+    return manifestCount;
+}
+
+bool integrity_lookup(const char* path, uint32_t* crc)
+{
+    while (*path == '/')
+        path++;
+
+    for (uint8_t i = 0; i < manifestCount; i++)
+    {
+        if (!strcmp(manifest[i].path, path))
+        {
+            *crc = manifest[i].crc;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,66 @@
+/**
+ * @file integrity.h
+ * @author Aidcraft
+ * @brief CRC32C checksums of boot images
+ * @version 0.0.2
+ * @date 2025-03-13
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#pragma once
+
+#include "../stdint.h"
+#include "../fs/FAT/fat.h"
+
+/// @brief Checksums written by build_disk.py, one "crc32c path" pair per line
+#define INTEGRITY_MANIFEST_PATH "boot/crc32c.txt"
+
+/// @brief Most files the manifest can describe
+#define INTEGRITY_MAX_ENTRIES   24
+/// @brief Longest path kept from the manifest
+#define INTEGRITY_PATH_SIZE     64
+
+/// @brief Starting value of a running CRC32C
+#define CRC32C_INIT             0xFFFFFFFF
+
+/**
+ * @brief Picks the crc32 instruction when the cpu has SSE4.2, otherwise
+ * builds the slicing-by-8 tables
+ */
+void crc32c_init();
+
+/**
+ * @brief Folds more data into a running CRC32C
+ * @details Start from CRC32C_INIT and invert the result once all data has
+ * been folded in to get the standard checksum.
+ *
+ * @param[in] crc running value
+ * @param[in] data bytes to add
+ * @param[in] size number of bytes
+ * @return uint32_t the new running value
+ */
+uint32_t crc32c_update(uint32_t crc, const void* data, uint64_t size);
+
+/**
+ * @brief Reads INTEGRITY_MANIFEST_PATH
+ * @details A missing manifest is not an error, images are then simply not
+ * verified.
+ *
+ * @param[in] fs file system to read from
+ * @return uint8_t number of checksums loaded
+ */
+uint8_t integrity_load(fatFS* fs);
+
+/**
+ * @brief Finds the expected checksum of a file
+ *
+ * @param[in] path path as passed to open, without a leading '/'
+ * @param[out] crc the expected CRC32C
+ * @return true the manifest lists the file
+ * @return false it doesn't
+ */
+bool integrity_lookup(const char* path, uint32_t* crc);
@@ -0,0 +1,129 @@
+/**
+ * @file lz4.cpp
+ * @author Aidcraft
+ * @brief LZ4 frame and block decoding
+ * @version 0.0.2
+ * @date 2025-03-12
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#include "lz4.h"
+#include "../memory/memory.h"
+
+#define MIN_MATCH 4
+
+bool lz4_parse_frame(const uint8_t* data, uint32_t length, lz4_frame* frame)
+{
+    if (length < 7 || *(const uint32_t*)data != LZ4_FRAME_MAGIC)
+        return false;
+
+    uint8_t flg = data[4];
+    uint8_t bd = data[5];
+
+    if ((flg & LZ4_FLG_VERSION_MASK) != LZ4_FLG_VERSION || (flg & LZ4_FLG_DICT_ID))
+        return false;
+
+    uint8_t blockMaxId = (bd >> 4) & 0x7;
+    if (blockMaxId < 4)
+        return false;
+
+    frame->blockMaxSize = 1 << (8 + 2 * blockMaxId); // 4 = 64KB ... 7 = 4MB
+    frame->independentBlocks = flg & LZ4_FLG_BLOCK_INDEP;
+    frame->blockChecksum = flg & LZ4_FLG_BLOCK_CHECKSUM;
+    frame->contentChecksum = flg & LZ4_FLG_CONTENT_CHECKSUM;
+    frame->contentSize = 0;
+
+    uint32_t offset = 6;
+    if (flg & LZ4_FLG_CONTENT_SIZE)
+    {
+        if (length < offset + 8 + 1)
+            return false;
+        frame->contentSize = *(const uint64_t*)(data + offset);
+        offset += 8;
+    }
+
+    // header checksum byte, not verified
+    frame->headerSize = offset + 1;
+    return true;
+}
+
+int32_t lz4_decode_block(const uint8_t* src, uint32_t srcSize, uint8_t* dst, uint32_t dstCapacity)
+{
+    const uint8_t* ip = src;
+    const uint8_t* iend = src + srcSize;
+    uint8_t* op = dst;
+    uint8_t* oend = dst + dstCapacity;
+
+    while (ip < iend)
+    {
+        uint8_t token = *ip++;
+
+        // literals
+        uint32_t literals = token >> 4;
+        if (literals == 15)
+        {
+            uint8_t extra;
+            do
+            {
+                if (ip >= iend)
+                    return -1;
+                extra = *ip++;
+                literals += extra;
+            } while (extra == 255);
+        }
+
+        if (literals > (uint32_t)(iend - ip) || literals > (uint32_t)(oend - op))
+            return -1;
+        memcpy(op, ip, literals);
+        ip += literals;
+        op += literals;
+
+        // the last sequence is literals only
+        if (ip >= iend)
+            break;
+
+        // match
+        if (iend - ip < 2)
+            return -1;
+        uint32_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (uint32_t)(op - dst))
+            return -1;
+
+        uint32_t length = token & 0xF;
+        if (length == 15)
+        {
+            uint8_t extra;
+            do
+            {
+                if (ip >= iend)
+                    return -1;
+                extra = *ip++;
+                length += extra;
+            } while (extra == 255);
+        }
+        length += MIN_MATCH;
+
+        if (length > (uint32_t)(oend - op))
+            return -1;
+
+        // matches may overlap their own output, so copy forwards a byte at a time
+        const uint8_t* match = op - offset;
+        if (offset >= length)
+        {
+            memcpy(op, match, length);
+            op += length;
+        }
+        else
+        {
+            while (length--)
+                *op++ = *match++;
+        }
+    }
+
+    return op - dst;
+}
@@ -0,0 +1,68 @@
+/**
+ * @file lz4.h
+ * @author Aidcraft
+ * @brief LZ4 frame and block decoding
+ * @version 0.0.2
+ * @date 2025-03-12
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#pragma once
+
+#include "../stdint.h"
+
+#define LZ4_FRAME_MAGIC         0x184D2204
+
+/// @brief Longest possible frame header (magic, FLG, BD, size, dict id, HC)
+#define LZ4_MAX_HEADER_SIZE     19
+/// @brief Set in a block size when the block is stored uncompressed
+#define LZ4_BLOCK_UNCOMPRESSED  0x80000000
+
+#define LZ4_FLG_VERSION_MASK    0xC0
+#define LZ4_FLG_VERSION         0x40
+#define LZ4_FLG_BLOCK_INDEP     0x20
+#define LZ4_FLG_BLOCK_CHECKSUM  0x10
+#define LZ4_FLG_CONTENT_SIZE    0x08
+#define LZ4_FLG_CONTENT_CHECKSUM 0x04
+#define LZ4_FLG_DICT_ID         0x01
+
+/// @brief Decoded frame descriptor
+typedef struct
+{
+    /// @brief size of the frame header in bytes
+    uint32_t headerSize;
+    /// @brief largest decompressed size of a block
+    uint32_t blockMaxSize;
+    /// @brief decompressed size of the whole frame, 0 if not stored
+    uint64_t contentSize;
+    bool blockChecksum;
+    bool contentChecksum;
+    bool independentBlocks;
+} lz4_frame;
+
+/**
+ * @brief Parses an LZ4 frame header
+ *
+ * @param[in] data start of the frame
+ * @param[in] length bytes available at data
+ * @param[out] frame the parsed descriptor
+ * @return true data starts with a frame header this decoder understands
+ * @return false not an LZ4 frame, or one using unsupported features
+ */
+bool lz4_parse_frame(const uint8_t* data, uint32_t length, lz4_frame* frame);
+
+/**
+ * @brief Decodes one LZ4 block
+ * @details Blocks must be independent: matches never reach before dst.
+ *
+ * @param[in] src compressed block
+ * @param[in] srcSize size of the compressed block
+ * @param[out] dst where the decoded bytes go
+ * @param[in] dstCapacity space at dst
+ * @return int32_t number of bytes decoded, -1 if the block is corrupt
+ */
+int32_t lz4_decode_block(const uint8_t* src, uint32_t srcSize, uint8_t* dst, uint32_t dstCapacity);
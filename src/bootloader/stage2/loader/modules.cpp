@@ -0,0 +1,114 @@
+/**
+ * @file modules.cpp
+ * @author Aidcraft
+ * @brief loads the extra files listed in boot/modules.cfg
+ * @version 0.0.2
+ * @date 2025-03-10
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#include "modules.h"
+#include "../stdio.h"
+#include "../stddef.h"
+#include "../memory/memory.h"
+#include "../memory/paging.h"
+#include "../memory/frames.h"
+#include "image.h"
+
+#define PAGE_SIZE 0x1000
+#define MAX_CONFIG_SIZE 0x1000
+#define MAX_PATH 128
+
+static bool load_one(fatFS* fs, const char* line, uint32_t length, loaded_module* module)
+{
+    char path[MAX_PATH];
+    uint32_t pathLength = 0;
+    while (pathLength < length && line[pathLength] != ' ' && pathLength < MAX_PATH - 1)
+    {
+        path[pathLength] = line[pathLength];
+        pathLength++;
+    }
+    path[pathLength] = '\0';
+
+    imageFile file(fs);
+    if (!file.open(path))
+    {
+        puts("MODULES: missing module\n");
+        return false;
+    }
+
+    // compressed modules must record their size, it decides how much is allocated
+    uint64_t size = file.size();
+    if (size == 0 && file.isCompressed())
+    {
+        puts("MODULES: compressed module without a content size\n");
+        file.close();
+        return false;
+    }
+
+    uint64_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint64_t base = frames_alloc(pages ? pages : 1);
+    if (base == 0 || base + size > 0x100000000)
+    {
+        puts("MODULES: out of memory below 4GB\n");
+        file.close();
+        return false;
+    }
+
+    page_range(base, base, pages * PAGE_SIZE, MAP_WRITE);
+
+    bool ok = file.read(size, (void*)base) == size && file.verify();
+    file.close();
+    if (!ok)
+    {
+        puts("MODULES: read failed\n");
+        return false;
+    }
+
+    module->base = base;
+    module->size = size;
+
+    uint32_t i = 0;
+    for (; i < length && i < MODULES_NAME_SIZE - 1; i++)
+        module->name[i] = line[i];
+    module->name[i] = '\0';
+    return true;
+}
+
+uint8_t modules_load(fatFS* fs, loaded_module* modules)
+{
+    FAT_File* config = fs->open(MODULES_CONFIG_PATH);
+    if (config == NULL)
+        return 0;
+
+    char* text = (char*)MEMORY_SCRATCH_START;
+    uint32_t length = fs->read(config, MAX_CONFIG_SIZE, text);
+    fs->close(config);
+
+    uint8_t count = 0;
+    uint32_t position = 0;
+    while (position < length && count < MODULES_MAX)
+    {
+        // find the end of the line and trim trailing whitespace
+        uint32_t start = position;
+        while (position < length && text[position] != '\n')
+            position++;
+        uint32_t end = position++;
+        while (end > start && (text[end - 1] == '\r' || text[end - 1] == ' ' || text[end - 1] == '\t'))
+            end--;
+        while (start < end && (text[start] == ' ' || text[start] == '\t'))
+            start++;
+
+        if (start == end || text[start] == '#')
+            continue;
+
+        if (load_one(fs, text + start, end - start, &modules[count]))
+            count++;
+    }
+
+    return count;
+}
@@ -0,0 +1,47 @@
+/**
+ * @file modules.h
+ * @author Aidcraft
+ * @brief loads the extra files listed in boot/modules.cfg
+ * @version 0.0.2
+ * @date 2025-03-10
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#pragma once
+
+#include "../stdint.h"
+#include "../fs/FAT/fat.h"
+
+/// @brief Module list read from the boot partition
+#define MODULES_CONFIG_PATH "boot/modules.cfg"
+
+/// @brief Most modules the loader keeps track of
+#define MODULES_MAX 16
+/// @brief Longest line (path plus arguments) kept for a module
+#define MODULES_NAME_SIZE 48
+
+/// @brief A module placed in memory
+typedef struct
+{
+    uint64_t base;
+    uint64_t size;
+    /// @brief the line from the config, path followed by any arguments
+    char name[MODULES_NAME_SIZE];
+} loaded_module;
+
+/**
+ * @brief Loads every module listed in MODULES_CONFIG_PATH
+ * @details The config holds one module per line, the path first and
+ * anything after it passed along as the module's command line. Lines
+ * starting with '#' are ignored. Each module is placed page aligned in
+ * frames below 4GB. A missing config simply means no modules.
+ *
+ * @param[in] fs file system to load from
+ * @param[out] modules array of MODULES_MAX entries to fill
+ * @return uint8_t number of modules loaded
+ */
+uint8_t modules_load(fatFS* fs, loaded_module* modules);
@@ -0,0 +1,413 @@
+/**
+ * @file multiboot2.cpp
+ * @author Aidcraft
+ * @brief multiboot2 compatible kernel loading
+ * @version 0.0.2
+ * @date 2025-03-10
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#include "multiboot2.h"
+#include "../stdio.h"
+#include "../stddef.h"
+#include "../string.h"
+#include "../memory/memory.h"
+#include "../memory/paging.h"
+#include "../memory/frames.h"
+#include "../memory/zero.h"
+#include "../arch/x86-64/acpi.h"
+#include "../framebuffer.h"
+
+#define PAGE_SIZE 0x1000
+#define MBI_PAGES 2
+
+#define BOOT_LOADER_NAME "aidos stage2"
+
+/// @brief Information tags we know how to provide
+static const uint32_t supportedInfo[] = {
+    MULTIBOOT2_TAG_CMDLINE,
+    MULTIBOOT2_TAG_BOOT_LOADER_NAME,
+    MULTIBOOT2_TAG_MODULE,
+    MULTIBOOT2_TAG_BASIC_MEMINFO,
+    MULTIBOOT2_TAG_BOOTDEV,
+    MULTIBOOT2_TAG_MMAP,
+    MULTIBOOT2_TAG_FRAMEBUFFER,
+    MULTIBOOT2_TAG_ACPI_OLD,
+    MULTIBOOT2_TAG_ACPI_NEW,
+};
+
+static bool info_supported(uint32_t type)
+{
+    for (uint32_t i = 0; i < sizeof(supportedInfo) / sizeof(supportedInfo[0]); i++)
+        if (supportedInfo[i] == type)
+            return true;
+    return false;
+}
+
+static uint32_t align_tag(uint32_t value)
+{
+    return (value + MULTIBOOT2_TAG_ALIGN - 1) & ~(uint32_t)(MULTIBOOT2_TAG_ALIGN - 1);
+}
+
+/*
+ * Walk the header tags, recording what we honor and refusing anything
+ * required that we do not.
+ */
+static bool parse_tags(const uint8_t* header, uint32_t length, multiboot2_kernel* kernel)
+{
+    uint32_t offset = sizeof(multiboot2_header);
+
+    while (offset + sizeof(multiboot2_header_tag) <= length)
+    {
+        const multiboot2_header_tag* tag = (const multiboot2_header_tag*)(header + offset);
+        const uint32_t* body = (const uint32_t*)(tag + 1);
+        bool optional = tag->flags & MULTIBOOT2_TAG_OPTIONAL;
+
+        if (tag->size < sizeof(multiboot2_header_tag) || offset + tag->size > length)
+        {
+            puts("MB2: malformed header tag\n");
+            return false;
+        }
+
+        switch (tag->type)
+        {
+        case MULTIBOOT2_HEADER_TAG_END:
+            return true;
+
+        case MULTIBOOT2_HEADER_TAG_INFORMATION_REQUEST:
+        {
+            uint32_t count = (tag->size - sizeof(multiboot2_header_tag)) / 4;
+            for (uint32_t i = 0; i < count; i++)
+            {
+                if (!optional && !info_supported(body[i]))
+                {
+                    puts("MB2: kernel requires information we cannot provide\n");
+                    return false;
+                }
+            }
+            break;
+        }
+
+        case MULTIBOOT2_HEADER_TAG_ADDRESS:
+            kernel->hasAddress = true;
+            kernel->headerAddr = body[0];
+            kernel->loadAddr = body[1];
+            kernel->loadEndAddr = body[2];
+            kernel->bssEndAddr = body[3];
+            break;
+
+        case MULTIBOOT2_HEADER_TAG_ENTRY_ADDRESS:
+            kernel->hasEntry = true;
+            kernel->entry = body[0];
+            break;
+
+        case MULTIBOOT2_HEADER_TAG_FRAMEBUFFER:
+            // the mode is set in real mode before the kernel is read, all a
+            // kernel that requires one can get is the mode already in use
+            if (!optional && !framebuffer_active())
+            {
+                puts("MB2: unsupported required header tag\n");
+                return false;
+            }
+            break;
+
+        case MULTIBOOT2_HEADER_TAG_CONSOLE_FLAGS:
+        case MULTIBOOT2_HEADER_TAG_MODULE_ALIGN:
+            // the console is always there and modules are always page aligned
+            break;
+
+        default:
+            // EFI tags and relocation are not something a bios loader can honor
+            if (!optional)
+            {
+                puts("MB2: unsupported required header tag\n");
+                return false;
+            }
+            break;
+        }
+
+        offset += align_tag(tag->size);
+    }
+
+    return true;
+}
+
+bool multiboot2_detect(imageFile* file, multiboot2_kernel* kernel)
+{
+    uint8_t* buffer = (uint8_t*)MEMORY_SCRATCH_START;
+
+    memset(kernel, 0, sizeof(multiboot2_kernel));
+
+    if (!file->seek(0))
+        return false;
+    uint32_t length = file->read(MULTIBOOT2_SEARCH, buffer);
+
+    for (uint32_t offset = 0; offset + sizeof(multiboot2_header) <= length; offset += MULTIBOOT2_HEADER_ALIGN)
+    {
+        const multiboot2_header* header = (const multiboot2_header*)(buffer + offset);
+        if (header->magic != MULTIBOOT2_HEADER_MAGIC)
+            continue;
+
+        if (header->magic + header->architecture + header->headerLength + header->checksum != 0)
+            continue;
+
+        if (header->architecture != MULTIBOOT2_ARCHITECTURE_I386)
+        {
+            puts("MB2: unsupported architecture\n");
+            return false;
+        }
+
+        if (offset + header->headerLength > length)
+        {
+            puts("MB2: header runs past the search area\n");
+            return false;
+        }
+
+        kernel->headerOffset = offset;
+        return parse_tags(buffer + offset, header->headerLength, kernel);
+    }
+
+    return false;
+}
+
+bool multiboot2_load(imageFile* file, const multiboot2_kernel* kernel, elf_image* image)
+{
+    if (!kernel->hasAddress)
+    {
+        if (!elf_load_physical(file, image))
+            return false;
+
+        if (kernel->hasEntry)
+            image->entry = kernel->entry;
+        return true;
+    }
+
+    // a.out kludge: the header says where the file goes
+    if (!kernel->hasEntry || kernel->headerAddr < kernel->loadAddr ||
+        kernel->headerAddr - kernel->loadAddr > kernel->headerOffset)
+    {
+        puts("MB2: inconsistent address tag\n");
+        return false;
+    }
+
+    uint32_t fileOffset = kernel->headerOffset - (kernel->headerAddr - kernel->loadAddr);
+    if (!kernel->loadEndAddr && file->size() < fileOffset)
+    {
+        puts("MB2: image size unknown, set load_end_addr\n");
+        return false;
+    }
+    uint64_t loadEnd = kernel->loadEndAddr ? kernel->loadEndAddr : kernel->loadAddr + (file->size() - fileOffset);
+    uint64_t bssEnd = kernel->bssEndAddr ? kernel->bssEndAddr : loadEnd;
+
+    if (loadEnd < kernel->loadAddr || bssEnd < loadEnd || bssEnd > MEMORY_IDENTITY_END)
+    {
+        puts("MB2: bad load range\n");
+        return false;
+    }
+
+    if (!frames_reserve(kernel->loadAddr, bssEnd - kernel->loadAddr))
+    {
+        puts("MB2: load address is not in usable memory\n");
+        return false;
+    }
+
+    uint32_t loadSize = loadEnd - kernel->loadAddr;
+    if (!file->seek(fileOffset) || file->read(loadSize, (void*)(uint64_t)kernel->loadAddr) != loadSize)
+    {
+        puts("MB2: failed to read kernel\n");
+        return false;
+    }
+
+    zero_range((void*)(uint64_t)loadEnd, bssEnd - loadEnd);
+
+    image->entry = kernel->entry;
+    image->virtStart = kernel->loadAddr;
+    image->virtEnd = bssEnd;
+    return true;
+}
+
+static uint8_t* tag_begin(uint8_t* cursor, uint32_t type)
+{
+    uint32_t* tag = (uint32_t*)cursor;
+    tag[0] = type;
+    tag[1] = 8;
+    return cursor + 8;
+}
+
+/*
+ * Close a tag started at 'tag' whose contents end at 'end', returning the
+ * aligned position of the next tag.
+ */
+static uint8_t* tag_end(uint8_t* tag, uint8_t* end)
+{
+    uint32_t size = end - tag;
+    ((uint32_t*)tag)[1] = size;
+
+    uint8_t* next = tag + align_tag(size);
+    while (end < next)
+        *end++ = 0;
+    return next;
+}
+
+static uint8_t* put_string(uint8_t* cursor, const char* str)
+{
+    while (*str)
+        *cursor++ = *str++;
+    *cursor++ = '\0';
+    return cursor;
+}
+
+static uint32_t memory_type(uint32_t type)
+{
+    switch (type)
+    {
+    case BOOTINFO_MEMORY_USABLE:
+    case BOOTINFO_MEMORY_LOADER:
+    case BOOTINFO_MEMORY_LOADED:
+        // the kernel knows where it and its modules are, the rest of stage2 is dead
+        return MULTIBOOT2_MEMORY_AVAILABLE;
+    case BOOTINFO_MEMORY_ACPI_RECLAIMABLE:
+        return MULTIBOOT2_MEMORY_ACPI_RECLAIMABLE;
+    case BOOTINFO_MEMORY_ACPI_NVS:
+        return MULTIBOOT2_MEMORY_NVS;
+    case BOOTINFO_MEMORY_BAD:
+        return MULTIBOOT2_MEMORY_BADRAM;
+    default:
+        return MULTIBOOT2_MEMORY_RESERVED;
+    }
+}
+
+/*
+ * Usable memory in KB starting at 'base', stopping at the first hole.
+ */
+static uint32_t usable_from(const bootinfo* info, uint64_t base, uint64_t limit)
+{
+    uint64_t end = base;
+    for (uint32_t i = 0; i < info->memoryMapCount; i++)
+    {
+        const bootinfo_memory* entry = &info->memoryMap[i];
+        if (memory_type(entry->type) != MULTIBOOT2_MEMORY_AVAILABLE)
+            continue;
+        if (entry->base <= end && entry->base + entry->length > end)
+            end = entry->base + entry->length;
+    }
+
+    if (end > limit)
+        end = limit;
+    return (end - base) / 1024;
+}
+
+void multiboot2_boot(const elf_image* image, const bootinfo* info)
+{
+    uint64_t mbi = frames_alloc(MBI_PAGES);
+    if (mbi == 0 || mbi + MBI_PAGES * PAGE_SIZE > 0x100000000)
+    {
+        puts("MB2: no memory for the boot information\n");
+        while (1)
+            ;
+    }
+    page_range(mbi, mbi, MBI_PAGES * PAGE_SIZE, MAP_WRITE);
+
+    uint8_t* cursor = (uint8_t*)mbi + 8;
+    uint8_t* tag;
+
+    tag = cursor;
+    cursor = put_string(tag_begin(tag, MULTIBOOT2_TAG_CMDLINE), "");
+    cursor = tag_end(tag, cursor);
+
+    tag = cursor;
+    cursor = put_string(tag_begin(tag, MULTIBOOT2_TAG_BOOT_LOADER_NAME), BOOT_LOADER_NAME);
+    cursor = tag_end(tag, cursor);
+
+    for (uint32_t i = 0; i < info->moduleCount; i++)
+    {
+        tag = cursor;
+        uint32_t* body = (uint32_t*)tag_begin(tag, MULTIBOOT2_TAG_MODULE);
+        body[0] = info->modules[i].base;
+        body[1] = info->modules[i].base + info->modules[i].size;
+        cursor = put_string((uint8_t*)&body[2], info->modules[i].name);
+        cursor = tag_end(tag, cursor);
+    }
+
+    tag = cursor;
+    uint32_t* meminfo = (uint32_t*)tag_begin(tag, MULTIBOOT2_TAG_BASIC_MEMINFO);
+    meminfo[0] = usable_from(info, 0, 0xA0000);
+    meminfo[1] = usable_from(info, 0x100000, 0x100000000);
+    cursor = tag_end(tag, (uint8_t*)&meminfo[2]);
+
+    tag = cursor;
+    uint32_t* bootdev = (uint32_t*)tag_begin(tag, MULTIBOOT2_TAG_BOOTDEV);
+    bootdev[0] = info->bootDrive;
+    bootdev[1] = 0xFFFFFFFF; // partition number is not known, only its lba
+    bootdev[2] = 0xFFFFFFFF;
+    cursor = tag_end(tag, (uint8_t*)&bootdev[3]);
+
+    tag = cursor;
+    uint32_t* mmap = (uint32_t*)tag_begin(tag, MULTIBOOT2_TAG_MMAP);
+    mmap[0] = 24; // entry size
+    mmap[1] = 0;  // entry version
+    uint8_t* entries = (uint8_t*)&mmap[2];
+    for (uint32_t i = 0; i < info->memoryMapCount; i++)
+    {
+        *(uint64_t*)(entries + 0) = info->memoryMap[i].base;
+        *(uint64_t*)(entries + 8) = info->memoryMap[i].length;
+        *(uint32_t*)(entries + 16) = memory_type(info->memoryMap[i].type);
+        *(uint32_t*)(entries + 20) = 0;
+        entries += 24;
+    }
+    cursor = tag_end(tag, entries);
+
+    if (info->framebuffer.type != BOOTINFO_FRAMEBUFFER_NONE)
+    {
+        tag = cursor;
+        uint8_t* fb = tag_begin(tag, MULTIBOOT2_TAG_FRAMEBUFFER);
+        *(uint64_t*)(fb + 0) = info->framebuffer.address;
+        *(uint32_t*)(fb + 8) = info->framebuffer.pitch;
+        *(uint32_t*)(fb + 12) = info->framebuffer.width;
+        *(uint32_t*)(fb + 16) = info->framebuffer.height;
+        fb[20] = info->framebuffer.bpp;
+        fb[21] = info->framebuffer.type == BOOTINFO_FRAMEBUFFER_TEXT ? 2 : 1; // EGA text or direct RGB
+        *(uint16_t*)(fb + 22) = 0;
+        fb += 24;
+        if (info->framebuffer.type == BOOTINFO_FRAMEBUFFER_RGB)
+        {
+            *fb++ = info->framebuffer.redPosition;
+            *fb++ = info->framebuffer.redSize;
+            *fb++ = info->framebuffer.greenPosition;
+            *fb++ = info->framebuffer.greenSize;
+            *fb++ = info->framebuffer.bluePosition;
+            *fb++ = info->framebuffer.blueSize;
+        }
+        cursor = tag_end(tag, fb);
+    }
+
+    // a copy of the RSDP, the old tag only covers the 1.0 part
+    const acpi_rsdp* rsdp = (const acpi_rsdp*)info->acpiRsdp;
+    if (rsdp != NULL)
+    {
+        tag = cursor;
+        uint8_t* copy = tag_begin(tag, MULTIBOOT2_TAG_ACPI_OLD);
+        memcpy(copy, rsdp, ACPI_RSDP_V1_SIZE);
+        cursor = tag_end(tag, copy + ACPI_RSDP_V1_SIZE);
+
+        if (rsdp->revision >= 2)
+        {
+            tag = cursor;
+            copy = tag_begin(tag, MULTIBOOT2_TAG_ACPI_NEW);
+            memcpy(copy, rsdp, rsdp->length);
+            cursor = tag_end(tag, copy + rsdp->length);
+        }
+    }
+
+    tag = cursor;
+    cursor = tag_end(tag, tag_begin(tag, MULTIBOOT2_TAG_END));
+
+    ((uint32_t*)mbi)[0] = cursor - (uint8_t*)mbi;
+    ((uint32_t*)mbi)[1] = 0;
+
+    multiboot2_handoff(image->entry, mbi);
+}
@@ -0,0 +1,150 @@
+/**
+ * @file multiboot2.h
+ * @author Aidcraft
+ * @brief multiboot2 compatible kernel loading
+ * @version 0.0.2
+ * @date 2025-03-10
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#pragma once
+
+#include "../stdint.h"
+#include "image.h"
+#include "elf.h"
+#include "bootinfo.h"
+
+#define MULTIBOOT2_HEADER_MAGIC         0xE85250D6
+#define MULTIBOOT2_BOOTLOADER_MAGIC     0x36D76289
+#define MULTIBOOT2_ARCHITECTURE_I386    0
+
+/// @brief The header must be in the first 32KB of the image
+#define MULTIBOOT2_SEARCH               32768
+#define MULTIBOOT2_HEADER_ALIGN         8
+#define MULTIBOOT2_TAG_ALIGN            8
+
+/// @brief Set in a header tag's flags when the loader may ignore it
+#define MULTIBOOT2_TAG_OPTIONAL         1
+
+/// @brief Tags in the kernel's header
+enum multiboot2_header_tag_type
+{
+    MULTIBOOT2_HEADER_TAG_END                   = 0,
+    MULTIBOOT2_HEADER_TAG_INFORMATION_REQUEST   = 1,
+    MULTIBOOT2_HEADER_TAG_ADDRESS               = 2,
+    MULTIBOOT2_HEADER_TAG_ENTRY_ADDRESS         = 3,
+    MULTIBOOT2_HEADER_TAG_CONSOLE_FLAGS         = 4,
+    MULTIBOOT2_HEADER_TAG_FRAMEBUFFER           = 5,
+    MULTIBOOT2_HEADER_TAG_MODULE_ALIGN          = 6,
+    MULTIBOOT2_HEADER_TAG_EFI_BS                = 7,
+    MULTIBOOT2_HEADER_TAG_ENTRY_ADDRESS_EFI32   = 8,
+    MULTIBOOT2_HEADER_TAG_ENTRY_ADDRESS_EFI64   = 9,
+    MULTIBOOT2_HEADER_TAG_RELOCATABLE           = 10,
+};
+
+/// @brief Tags in the boot information handed to the kernel
+enum multiboot2_info_tag_type
+{
+    MULTIBOOT2_TAG_END              = 0,
+    MULTIBOOT2_TAG_CMDLINE          = 1,
+    MULTIBOOT2_TAG_BOOT_LOADER_NAME = 2,
+    MULTIBOOT2_TAG_MODULE           = 3,
+    MULTIBOOT2_TAG_BASIC_MEMINFO    = 4,
+    MULTIBOOT2_TAG_BOOTDEV          = 5,
+    MULTIBOOT2_TAG_MMAP             = 6,
+    MULTIBOOT2_TAG_FRAMEBUFFER      = 8,
+    MULTIBOOT2_TAG_ACPI_OLD         = 14,
+    MULTIBOOT2_TAG_ACPI_NEW         = 15,
+    MULTIBOOT2_TAG_LOAD_BASE_ADDR   = 21,
+};
+
+/// @brief Memory types in the MULTIBOOT2_TAG_MMAP tag
+enum multiboot2_memory_type
+{
+    MULTIBOOT2_MEMORY_AVAILABLE         = 1,
+    MULTIBOOT2_MEMORY_RESERVED          = 2,
+    MULTIBOOT2_MEMORY_ACPI_RECLAIMABLE  = 3,
+    MULTIBOOT2_MEMORY_NVS               = 4,
+    MULTIBOOT2_MEMORY_BADRAM            = 5,
+};
+
+/// @brief Fixed part of the kernel's header
+typedef struct
+{
+    uint32_t magic;
+    uint32_t architecture;
+    uint32_t headerLength;
+    uint32_t checksum;
+} __attribute__((packed)) multiboot2_header;
+
+/// @brief Common start of every tag
+typedef struct
+{
+    uint16_t type;
+    uint16_t flags;
+    uint32_t size;
+} __attribute__((packed)) multiboot2_header_tag;
+
+/// @brief What the kernel asked for in its header
+typedef struct
+{
+    /// @brief offset of the header in the file
+    uint32_t headerOffset;
+
+    bool hasAddress;
+    uint32_t headerAddr;
+    uint32_t loadAddr;
+    uint32_t loadEndAddr;
+    uint32_t bssEndAddr;
+
+    bool hasEntry;
+    uint32_t entry;
+} multiboot2_kernel;
+
+/**
+ * @brief Looks for a valid multiboot2 header in the kernel image
+ * @details Fails (and the kernel is treated as a native ELF) when there is no
+ * header, the checksum is wrong, the architecture is not i386 or the header
+ * has a required tag or information request this loader cannot satisfy.
+ *
+ * @param[in] file the opened kernel
+ * @param[out] kernel what the header asked for
+ * @return true the image is a multiboot2 kernel we can boot
+ * @return false it is not
+ */
+bool multiboot2_detect(imageFile* file, multiboot2_kernel* kernel);
+
+/**
+ * @brief Places a multiboot2 kernel at its physical load address
+ * @details Uses the address tag when present, otherwise the image is loaded
+ * as ELF at its physical addresses. An entry address tag overrides the ELF
+ * entry point.
+ *
+ * @param[in] file the opened kernel
+ * @param[in] kernel result of multiboot2_detect
+ * @param[out] image physical entry and extent
+ * @return true loaded
+ * @return false failed
+ */
+bool multiboot2_load(imageFile* file, const multiboot2_kernel* kernel, elf_image* image);
+
+/**
+ * @brief Builds the multiboot2 information structure from the bootinfo and
+ * enters the kernel
+ *
+ * @param[in] image result of multiboot2_load
+ * @param[in] info finalized bootinfo
+ */
+void __attribute__((noreturn)) multiboot2_boot(const elf_image* image, const bootinfo* info);
+
+/**
+ * @brief Leaves long mode and jumps to a multiboot2 entry point
+ *
+ * @param[in] entry physical entry point
+ * @param[in] mbi physical address of the information structure
+ */
+extern "C" void __attribute__((noreturn)) multiboot2_handoff(uint32_t entry, uint32_t mbi);
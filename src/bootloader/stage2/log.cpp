@@ -0,0 +1,66 @@
+/**
+ * @file log.cpp
+ * @author Aidcraft
+ * @brief buffered log output to debugcon and the serial port
+ * @version 0.0.2
+ * @date 2025-03-17
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#include "log.h"
+#include "arch/x86-64/io.h"
+#include "arch/x86-64/serial.h"
+
+#if defined(LOG_DEBUGCON) || defined(LOG_SERIAL)
+#define LOG_BUFFERED
+#endif
+
+#ifdef LOG_BUFFERED
+static char buffer[LOG_BUFFER_SIZE];
+static uint32_t buffered;
+#endif
+
+#ifdef LOG_SERIAL
+/// @brief output is dropped until the UART is set up, or if there is none
+static bool serialReady;
+#endif
+
+void log_init()
+{
+#ifdef LOG_SERIAL
+    serialReady = serial_init(SERIAL_COM1);
+#endif
+}
+
+void log_flush()
+{
+#ifdef LOG_BUFFERED
+    if (buffered == 0)
+        return;
+
+#ifdef LOG_DEBUGCON
+    outsb(LOG_DEBUGCON_PORT, buffer, buffered);
+#endif
+#ifdef LOG_SERIAL
+    if (serialReady)
+        serial_write(SERIAL_COM1, buffer, buffered);
+#endif
+
+    buffered = 0;
+#endif
+}
+
+void log_putc(char c)
+{
+#ifdef LOG_BUFFERED
+    buffer[buffered++] = c;
+    if (c == '\n' || buffered == LOG_BUFFER_SIZE)
+        log_flush();
+#else
+    (void)c;
+#endif
+}
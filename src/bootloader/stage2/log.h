@@ -0,0 +1,44 @@
+/**
+ * @file log.h
+ * @author Aidcraft
+ * @brief buffered log output to debugcon and the serial port
+ * @version 0.0.2
+ * @date 2025-03-17
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ * @details Sinks are chosen at build time (Kconfig "Stage2 logging"):
+ * LOG_VGA writes the text screen directly, LOG_DEBUGCON and LOG_SERIAL
+ * collect output in a buffer that goes out a line (or a full buffer) at a
+ * time. Without any of them the screen is used.
+ */
+
+#pragma once
+
+#include "stdint.h"
+
+#if !defined(LOG_VGA) && !defined(LOG_DEBUGCON) && !defined(LOG_SERIAL)
+#define LOG_VGA
+#endif
+
+/// @brief QEMU/Bochs debug console port
+#define LOG_DEBUGCON_PORT 0xE9
+
+/// @brief Bytes collected before a flush is forced
+#define LOG_BUFFER_SIZE 256
+
+/// @brief Sets up the serial port when it is a sink
+void log_init();
+
+/**
+ * @brief Adds a character to the buffered sinks
+ * @details Does nothing when only VGA is configured.
+ *
+ * @param[in] c the character
+ */
+void log_putc(char c);
+
+/// @brief Sends everything buffered so far
+void log_flush();
@@ -1,13 +1,76 @@
 #include "mbr.h"
+#include "memory/memory.h"
+#include "arch/x86-64/cpu.h"
+
+/// @brief Most sectors a single disk command can take
+#define DISK_MAX_SECTORS 255
+#define SECTOR_SIZE 512
 
 Partition::Partition(disk* Disk)
 {
     this->Disk = Disk;
+    memset(&stats, 0, sizeof(stats));
 }
 
 bool Partition::Partition_Read(void* buffer, uint32_t sectorCount, uint32_t LBA)
 {
-    return this->Disk->read(buffer, sectorCount, this->partitionAddress + LBA);
+    uint64_t start = rdtsc();
+    uint8_t* out = (uint8_t*)buffer;
+    uint32_t sector = 0;
+    bool ok = true;
+
+    // the disk takes an 8 bit count, longer reads are split
+    while (ok && sector < sectorCount)
+    {
+        uint32_t count = sectorCount - sector;
+        if (count > DISK_MAX_SECTORS)
+            count = DISK_MAX_SECTORS;
+
+        ok = this->Disk->read(out + (uint64_t)sector * SECTOR_SIZE, count, this->partitionAddress + LBA + sector);
+        sector += count;
+    }
+
+    disk_stats_record(&stats, LBA, sectorCount, start, ok);
+    return ok;
+}
+
+bool Partition::Partition_Write(const void* buffer, uint32_t sectorCount, uint32_t LBA)
+{
+    if ((uint64_t)LBA + sectorCount > this->partitionSize)
+    {
+        puts("PARTITION: write past the end of the partition\n");
+        return false;
+    }
+
+    const uint8_t* in = (const uint8_t*)buffer;
+    uint32_t sector = 0;
+    bool ok = true;
+
+    while (ok && sector < sectorCount)
+    {
+        uint32_t count = sectorCount - sector;
+        if (count > DISK_MAX_SECTORS)
+            count = DISK_MAX_SECTORS;
+
+        ok = this->Disk->write(in + (uint64_t)sector * SECTOR_SIZE, count, this->partitionAddress + LBA + sector);
+        sector += count;
+    }
+    return ok;
+}
+
+void Partition::Partition_CacheHit()
+{
+    stats.cacheHits++;
+}
+
+uint32_t Partition::Partition_Start()
+{
+    return this->partitionAddress;
+}
+
+uint32_t Partition::Partition_Size()
+{
+    return this->partitionSize;
 }
 
 void Partition::Init(void* partitionAddress)
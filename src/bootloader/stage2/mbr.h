@@ -55,6 +55,27 @@ public:
     /// @return Success or failure
     bool Partition_Read(void* buffer, uint32_t sectorCount, uint32_t LBA);
 
+    /// @brief Writes to the partition
+    /// @param buffer buffer to write from
+    /// @param sectorCount number of sectors to write
+    /// @param LBA LBA to write to
+    /// @return Success or failure, nothing is written past the end of the partition
+    bool Partition_Write(const void* buffer, uint32_t sectorCount, uint32_t LBA);
+
+    /// @brief First LBA of the partition on the disk
+    /// @return LBA of the first sector
+    uint32_t Partition_Start();
+
+    /// @brief Size of the partition
+    /// @return Number of sectors in the partition
+    uint32_t Partition_Size();
+
+    /// @brief Counts a read that a caller's buffer answered without the disk
+    void Partition_CacheHit();
+
+    /// @brief One entry per Partition_Read, which may take several disk commands
+    disk_stats stats;
+
     /// @brief Sets up the partition
     /// @param partitionAddress 
     void Init(void* partitionAddress);
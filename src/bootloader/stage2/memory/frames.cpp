@@ -0,0 +1,124 @@
+/**
+ * @file frames.cpp
+ * @author Aidcraft
+ * @brief bump allocator for physical frames
+ * @version 0.0.2
+ * @date 2025-03-08
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#include "frames.h"
+
+#define FRAME_SIZE 0x1000
+#define MAX_REGIONS 32
+
+typedef struct
+{
+    uint64_t base;
+    uint64_t end;
+    /// @brief next free address, everything from base up to here is handed out
+    uint64_t next;
+} frame_region;
+
+/// @brief usable regions, sorted by the bios (and left that way)
+static frame_region regions[MAX_REGIONS];
+static uint8_t region_count = 0;
+
+/// @brief region allocations are currently made from
+static uint8_t current = 0;
+
+static uint64_t align_up(uint64_t value)
+{
+    return (value + FRAME_SIZE - 1) & ~(uint64_t)(FRAME_SIZE - 1);
+}
+
+void frames_init(const memory_map* map, uint8_t count)
+{
+    region_count = 0;
+
+    for (uint8_t i = 0; i < count && region_count < MAX_REGIONS; i++)
+    {
+        if ((map[i].type & 0x7F) != MEMORY_TYPE_USABLE)
+            continue;
+
+        uint64_t base = align_up(map[i].base);
+        uint64_t end = (map[i].base + map[i].length) & ~(uint64_t)(FRAME_SIZE - 1);
+
+        if (base < MEMORY_STAGE2_END)
+            base = MEMORY_STAGE2_END;
+        if (end <= base)
+            continue;
+
+        regions[region_count].base = base;
+        regions[region_count].end = end;
+        regions[region_count].next = base;
+        region_count++;
+    }
+
+    current = 0;
+}
+
+uint64_t frames_alloc(uint64_t pages)
+{
+    uint64_t size = pages * FRAME_SIZE;
+
+    while (current < region_count)
+    {
+        frame_region* region = &regions[current];
+
+        if (region->end - region->next >= size)
+        {
+            uint64_t frame = region->next;
+            region->next += size;
+            return frame;
+        }
+
+        current++;
+    }
+
+    return 0;
+}
+
+bool frames_reserve(uint64_t base, uint64_t size)
+{
+    uint64_t end = align_up(base + size);
+    base &= ~(uint64_t)(FRAME_SIZE - 1);
+
+    for (uint8_t i = 0; i < region_count; i++)
+    {
+        if (base < regions[i].base || end > regions[i].end)
+            continue;
+
+        // anything below next in the active region is already handed out
+        if (i < current || base < regions[i].next)
+            return false;
+
+        // skip the allocator past the reserved range
+        current = i;
+        regions[i].next = end;
+        return true;
+    }
+
+    return false;
+}
+
+uint8_t frames_used(frame_range* ranges, uint8_t max)
+{
+    uint8_t count = 0;
+
+    for (uint8_t i = 0; i < region_count && count < max; i++)
+    {
+        if (regions[i].next == regions[i].base)
+            continue;
+
+        ranges[count].base = regions[i].base;
+        ranges[count].end = regions[i].next;
+        count++;
+    }
+
+    return count;
+}
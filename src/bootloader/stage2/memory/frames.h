@@ -0,0 +1,64 @@
+/**
+ * @file frames.h
+ * @author Aidcraft
+ * @brief physical frame allocator
+ * @version 0.0.2
+ * @date 2025-03-08
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#pragma once
+
+#include "../stdint.h"
+#include "memory.h"
+
+/// @brief E820 type for usable memory
+#define MEMORY_TYPE_USABLE 1
+
+/// @brief A physical range handed out by the allocator
+typedef struct
+{
+    uint64_t base;
+    uint64_t end;
+} frame_range;
+
+/**
+ * @brief Sets up the allocator from the bios memory map
+ * @details Nothing below MEMORY_STAGE2_END is ever handed out, since
+ * that is where stage2 and its tables live.
+ *
+ * @param[in] map the memory map from E820
+ * @param[in] count number of entries in the map
+ */
+void frames_init(const memory_map* map, uint8_t count);
+
+/**
+ * @brief Allocates physically contiguous 4KB frames
+ *
+ * @param[in] pages number of frames to allocate
+ * @return uint64_t physical address of the first frame, 0 on failure
+ */
+uint64_t frames_alloc(uint64_t pages);
+
+/**
+ * @brief Claims a fixed physical range so it is never allocated
+ *
+ * @param[in] base physical base of the range
+ * @param[in] size size of the range in bytes
+ * @return true the range lies in usable memory and was reserved
+ * @return false the range is not usable or was already handed out
+ */
+bool frames_reserve(uint64_t base, uint64_t size);
+
+/**
+ * @brief Lists the physical ranges handed out so far
+ *
+ * @param[out] ranges array to fill
+ * @param[in] max number of entries ranges can hold
+ * @return uint8_t number of entries written
+ */
+uint8_t frames_used(frame_range* ranges, uint8_t max);
@@ -12,28 +12,26 @@
  */
 #include "memory.h"
 
-void* memcpy(void* dst, const void* src, uint16_t size)
+// rep movsb/stosb are microcoded into full cache line moves on anything recent
+void* memcpy(void* dst, const void* src, uint64_t size)
 {
-    uint8_t* u8Dst = (uint8_t *)dst;
-    const uint8_t* u8Src = (const uint8_t *)src;
-    for (uint16_t i = 0; i < size; i++)
-        u8Dst[i] = u8Src[i];
+    void* d = dst;
+    asm volatile("rep movsb" : "+D"(d), "+S"(src), "+c"(size) :: "memory");
     return dst;
 }
 
-void* memset(void* dst, uint8_t val, uint16_t size)
+void* memset(void* dst, uint8_t val, uint64_t size)
 {
-    uint8_t* u8Dst = (uint8_t *)dst;
-    for (uint16_t i = 0; i < size; i++)
-        u8Dst[i] = val;
+    void* d = dst;
+    asm volatile("rep stosb" : "+D"(d), "+c"(size) : "a"(val) : "memory");
     return dst;
 }
 
-bool memcmp(const void* dst, const void* src, uint16_t size)
+bool memcmp(const void* dst, const void* src, uint64_t size)
 {
     const uint8_t* u8Dst = (const uint8_t *)dst;
     const uint8_t* u8Src = (const uint8_t *)src;
-    for (uint16_t i = 0; i < size; i++)
+    for (uint64_t i = 0; i < size; i++)
         if (u8Dst[i] != u8Src[i])
             return false;
     return true;
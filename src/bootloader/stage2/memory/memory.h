@@ -17,21 +17,68 @@ struct memory_map
     uint32_t acpi3;
 } __attribute__((packed));
 
+/*
+ * Stage2 keeps entirely to conventional memory, everything from 1MB up is
+ * left to the frame allocator so kernels can be placed at their usual
+ * load addresses (multiboot kernels almost always want 1MB).
+ */
 #define MEMORY_STAGE2_START     0x00001000
-#define MEMORY_STAGE2_END       MEMORY_FAT_END
+#define MEMORY_STAGE2_END       0x00100000
 #define MEMORY_STAGE2_SIZE      (MEMORY_STAGE2_END - MEMORY_STAGE2_START)
 
 #define MEMORY_FAT_START        0x0020000
-#define MEMORY_FAT_END          0x0100000
+#define MEMORY_FAT_END          0x0030000
 #define MEMORY_FAT_SIZE         (MEMORY_FAT_END - MEMORY_FAT_START)
 
-#define MEMORY_PAGE_TABLE_START 0x0100000
-#define MEMORY_PAGE_TABLE_END   MEMORY_PAGE_TABLE_START + (0x1000 * 16) // 16 pages
+#define MEMORY_PAGE_TABLE_START 0x0030000
+#define MEMORY_PAGE_TABLE_END   (MEMORY_PAGE_TABLE_START + (0x1000 * 48)) // 48 pages
 #define MEMORY_PAGE_TABLE_SIZE  (MEMORY_PAGE_TABLE_END - MEMORY_PAGE_TABLE_START)
 
-#define MEMORY_KERNEL_START     0x080000000
-#define MEMORY_KERNEL_END       0x100000000
-#define MEMORY_KERNEL_SIZE      (MEMORY_KERNEL_END - MEMORY_KERNEL_START)
+/// @brief general purpose buffer for staging file headers and the like
+#define MEMORY_SCRATCH_START    0x0060000
+#define MEMORY_SCRATCH_END      0x0070000
+#define MEMORY_SCRATCH_SIZE     (MEMORY_SCRATCH_END - MEMORY_SCRATCH_START)
+
+/// @brief compressed block being decoded (one LZ4 block of at most 64KB)
+#define MEMORY_LZ4_INPUT_START  0x0070000
+#define MEMORY_LZ4_INPUT_END    0x0080000
+#define MEMORY_LZ4_INPUT_SIZE   (MEMORY_LZ4_INPUT_END - MEMORY_LZ4_INPUT_START)
+
+/// @brief last decoded block, for reads that don't cover a whole block
+#define MEMORY_LZ4_WINDOW_START 0x0080000
+#define MEMORY_LZ4_WINDOW_END   0x0090000
+#define MEMORY_LZ4_WINDOW_SIZE  (MEMORY_LZ4_WINDOW_END - MEMORY_LZ4_WINDOW_START)
+
+/// @brief slicing-by-8 CRC32C tables, only built when the cpu lacks SSE4.2
+#define MEMORY_CRC_TABLE_START  0x0090000
+#define MEMORY_CRC_TABLE_END    0x0092000
+#define MEMORY_CRC_TABLE_SIZE   (MEMORY_CRC_TABLE_END - MEMORY_CRC_TABLE_START)
+
+/// @brief real mode entry page for application processors (SIPI vector 0x92)
+#define MEMORY_SMP_TRAMPOLINE_START 0x0092000
+#define MEMORY_SMP_TRAMPOLINE_END   0x0093000
+
+/// @brief stacks of the application processors while they run stage2 work
+#define MEMORY_SMP_STACKS_START 0x0093000
+#define MEMORY_SMP_STACKS_END   0x009B000
+#define MEMORY_SMP_STACKS_SIZE  (MEMORY_SMP_STACKS_END - MEMORY_SMP_STACKS_START)
+
+/// @brief ring of boot profiler events
+#define MEMORY_TRACE_START      0x009B000
+#define MEMORY_TRACE_END        0x009C000
+#define MEMORY_TRACE_SIZE       (MEMORY_TRACE_END - MEMORY_TRACE_START)
+
+/// @brief console font glyphs, the 16-bit stage leaves the ROM font here
+#define MEMORY_FONT_START       0x009C000
+#define MEMORY_FONT_END         0x009E000
+#define MEMORY_FONT_SIZE        (MEMORY_FONT_END - MEMORY_FONT_START)
+
+#define VGA_TEXT_START          0x00B8000
+#define VGA_TEXT_END            0x00C0000
+#define VGA_TEXT_SIZE           (VGA_TEXT_END - VGA_TEXT_START)
+
+/// @brief end of the region identity mapped by init_map
+#define MEMORY_IDENTITY_END     0x040000000
 
 /**
  * @brief Copies from src to dst by amount of size
@@ -41,6 +88,6 @@ struct memory_map
  * @param[in] size the amount to copy
  * @return void* a pointer to the destination
  */
-void* memcpy(void* dst, const void* src, uint16_t size);
-void* memset(void* dst, uint8_t val, uint16_t size);
-bool memcmp(const void* dst, const void* src, uint16_t size);
+void* memcpy(void* dst, const void* src, uint64_t size);
+void* memset(void* dst, uint8_t val, uint64_t size);
+bool memcmp(const void* dst, const void* src, uint64_t size);
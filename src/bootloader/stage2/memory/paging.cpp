@@ -1,16 +1,32 @@
 #include "paging.h"
+#include "../arch/x86-64/cpu.h"
 
 #define PAGE_SIZE    4096
 #define NUM_ENTRIES  512
 
 // Page table flags.
-#define PAGE_PRESENT 0x1
-#define PAGE_RW      0x2
-#define PAGE_PS      0x80  // When set in a PD entry, indicates a 2MB page.
+#define PAGE_PRESENT   0x1
+#define PAGE_RW        0x2
+#define PAGE_PWT       0x8
+#define PAGE_PCD       0x10
+#define PAGE_PS        0x80  // When set in a PD entry, indicates a 2MB page.
+#define PAGE_PAT       0x80  // In a PT entry bit 7 selects the upper half of the PAT.
+#define PAGE_GLOBAL    0x100
+#define PAGE_PAT_LARGE 0x1000 // In a 2MB PD entry the PAT bit moves to bit 12.
+#define PAGE_NX        (1ULL << 63)
+
+/*
+ * PAT layout programmed by init_map. Entries 0-3 keep their power-on
+ * values so tables written without the PAT bit behave exactly as before;
+ * entry 4 is repurposed as write-combining.
+ *
+ *   PA0 WB  PA1 WT  PA2 UC-  PA3 UC  PA4 WC  PA5 WT  PA6 UC-  PA7 UC
+ */
+#define PAT_VALUE    0x0007040100070406ULL
 
 typedef uint64_t pt_entry_t;
 
-#define MAX_PAGES 16
+#define MAX_PAGES (MEMORY_PAGE_TABLE_SIZE / PAGE_SIZE)
 static uint8_t* pt_pool = (uint8_t*)MEMORY_PAGE_TABLE_START;
 static uint32_t pt_next = 0;
 
@@ -27,13 +43,96 @@ static pt_entry_t *alloc_page_table(void) {
 // The top-level (PML4) page table.
 static pt_entry_t *pml4 = 0;
 
+// Cpu features detected by init_map.
+static bool nx_supported = false;
+static bool pat_supported = false;
+
+/*
+ * Translate MAP_* flags into the bits of a leaf entry.
+ *
+ * 'large' selects where the PAT bit lives (bit 12 for 2MB pages, bit 7 for
+ * 4KB pages). When the PAT could not be programmed, write-combining falls
+ * back to UC- which is the closest type the default PAT offers.
+ */
+static uint64_t leaf_flags(uint32_t flags, bool large) {
+    uint64_t entry = PAGE_PRESENT;
+
+    if (flags & MAP_WRITE)
+        entry |= PAGE_RW;
+    if (!(flags & MAP_EXEC) && nx_supported)
+        entry |= PAGE_NX;
+    if (flags & MAP_GLOBAL)
+        entry |= PAGE_GLOBAL;
+
+    switch (flags & MAP_CACHE_MASK) {
+    case MAP_CACHE_WT:
+        entry |= PAGE_PWT;
+        break;
+    case MAP_CACHE_UC:
+        entry |= PAGE_PCD | PAGE_PWT;
+        break;
+    case MAP_CACHE_WC:
+        if (pat_supported)
+            entry |= large ? PAGE_PAT_LARGE : PAGE_PAT;
+        else
+            entry |= PAGE_PCD;
+        break;
+    default:
+        break;
+    }
+
+    return entry;
+}
+
+/*
+ * Detect NX and the PAT, then enable them on the BSP.
+ *
+ * Must run before any mapping is created with NX or WC, since an NX bit
+ * without EFER.NXE is a reserved bit fault.
+ */
+static void init_features(void) {
+    nx_supported = cpuid_max_extended() >= 0x80000001 &&
+                   (cpuid(0x80000001).edx & CPUID_80000001_EDX_NX);
+    pat_supported = cpuid(1).edx & CPUID_01_EDX_PAT;
+
+    paging_init_cpu();
+}
+
+/*
+ * Turn on EFER.NXE and load our PAT layout on the calling cpu. Every cpu
+ * sharing these tables needs the same PAT or the caching types disagree.
+ *
+ * The PAT is changed the way the SDM asks for memory type changes: caches
+ * off (CR0.CD), write back and flush caches and TLB, write the MSR, flush
+ * again and restore CR0. The SDM also wants interrupts off, which they
+ * are for both callers: init_map runs before idt_init and the APs come
+ * straight from the trampoline's cli.
+ */
+void paging_init_cpu(void) {
+    if (nx_supported)
+        wrmsr(MSR_IA32_EFER, rdmsr(MSR_IA32_EFER) | EFER_NXE);
+
+    if (pat_supported) {
+        uint64_t cr0 = read_cr0();
+        write_cr0((cr0 | CR0_CD) & ~(uint64_t)CR0_NW);
+        wbinvd();
+        flush_tlb();
+
+        wrmsr(MSR_IA32_PAT, PAT_VALUE);
+
+        wbinvd();
+        flush_tlb();
+        write_cr0(cr0);
+    }
+}
+
 /*
  * Map a single 4KB page so that the virtual address 'virt'
  * refers to the physical (linear) address 'linear'.
  *
  * Both 'linear' and 'virt' must be 4KB aligned.
  */
-void page(uint64_t linear, uint64_t virt) {
+void page(uint64_t linear, uint64_t virt, uint32_t flags) {
     // Ensure the PML4 table exists.
     if (!pml4) {
         pml4 = alloc_page_table();
@@ -84,8 +183,11 @@ void page(uint64_t linear, uint64_t virt) {
         pd[pd_index] = (uint64_t)pt | PAGE_PRESENT | PAGE_RW;
     }
 
-    // Install the mapping in the PT.
-    pt[pt_index] = (linear & ~0xFFFULL) | PAGE_PRESENT | PAGE_RW;
+    // Install the mapping in the PT, flushing any stale translation.
+    bool remap = pt[pt_index] & PAGE_PRESENT;
+    pt[pt_index] = (linear & ~0xFFFULL) | leaf_flags(flags, false);
+    if (remap)
+        invlpg(virt);
 }
 
 /*
@@ -98,11 +200,11 @@ void page(uint64_t linear, uint64_t virt) {
  * Both 'linear' and 'virt' should be 4KB aligned. If 'size' is not a multiple
  * of 4KB, it will be rounded up to cover the entire range.
  */
-void page_range(uint64_t linear, uint64_t virt, uint64_t size) {
+void page_range(uint64_t linear, uint64_t virt, uint64_t size, uint32_t flags) {
     // Calculate the number of pages needed (round up if size isn't a multiple of PAGE_SIZE).
     uint64_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
     for (uint64_t i = 0; i < pages; i++) {
-        page(linear + i * PAGE_SIZE, virt + i * PAGE_SIZE);
+        page(linear + i * PAGE_SIZE, virt + i * PAGE_SIZE, flags);
     }
 }
 
@@ -112,7 +214,7 @@ void page_range(uint64_t linear, uint64_t virt, uint64_t size) {
  *
  * Both 'linear' and 'virt' must be 2MB aligned.
  */
-void page_large(uint64_t linear, uint64_t virt) {
+void page_large(uint64_t linear, uint64_t virt, uint32_t flags) {
     // Ensure the PML4 table exists.
     if (!pml4) {
         pml4 = alloc_page_table();
@@ -153,7 +255,49 @@ void page_large(uint64_t linear, uint64_t virt) {
         return; // Already mapped.
     
     // Ensure that the physical address is 2MB aligned.
-    pd[pd_index] = (linear & ~0x1FFFFFULL) | PAGE_PRESENT | PAGE_RW | PAGE_PS;
+    pd[pd_index] = (linear & ~0x1FFFFFULL) | leaf_flags(flags, true) | PAGE_PS;
+}
+
+/*
+ * Replace the 2MB page covering 'virt' with a page table mapping the same
+ * memory with the same attributes, so parts of it can be remapped with
+ * page(). Returns false when 'virt' isn't mapped or the pool is empty.
+ */
+bool page_split(uint64_t virt) {
+    if (!pml4)
+        return false;
+
+    pt_entry_t pml4e = pml4[(virt >> 39) & 0x1FF];
+    if (!(pml4e & PAGE_PRESENT))
+        return false;
+    pt_entry_t *pdpt = (pt_entry_t *)(pml4e & ~0xFFFULL);
+
+    pt_entry_t pdpte = pdpt[(virt >> 30) & 0x1FF];
+    if (!(pdpte & PAGE_PRESENT))
+        return false;
+    pt_entry_t *pd = (pt_entry_t *)(pdpte & ~0xFFFULL);
+
+    pt_entry_t *pde = &pd[(virt >> 21) & 0x1FF];
+    if (!(*pde & PAGE_PRESENT))
+        return false;
+    if (!(*pde & PAGE_PS))
+        return true; // Already 4KB pages.
+
+    pt_entry_t *pt = alloc_page_table();
+    if (!pt)
+        return false;
+
+    // Same attributes, with the PAT bit moved from bit 12 down to bit 7.
+    uint64_t base = *pde & 0x000FFFFFFFE00000ULL;
+    uint64_t attributes = *pde & (PAGE_NX | 0xFFFULL) & ~(uint64_t)PAGE_PS;
+    if (*pde & PAGE_PAT_LARGE)
+        attributes |= PAGE_PAT;
+    for (int i = 0; i < NUM_ENTRIES; i++)
+        pt[i] = (base + i * (uint64_t)PAGE_SIZE) | attributes;
+
+    *pde = (uint64_t)pt | PAGE_PRESENT | PAGE_RW;
+    invlpg(virt);
+    return true;
 }
 
 /*
@@ -166,11 +310,39 @@ void page_large(uint64_t linear, uint64_t virt) {
  * Both 'linear' and 'virt' should be 2MB aligned. If 'size' is not a multiple
  * of 2MB, it will be rounded up to cover the entire range.
  */
-void page_range_large(uint64_t linear, uint64_t virt, uint64_t size) {
+void page_range_large(uint64_t linear, uint64_t virt, uint64_t size, uint32_t flags) {
     const uint64_t LARGE_PAGE_SIZE = 2 * 1024 * 1024;  // 2MB per page.
     uint64_t pages = (size + LARGE_PAGE_SIZE - 1) / LARGE_PAGE_SIZE;
     for (uint64_t i = 0; i < pages; i++) {
-        page_large(linear + i * LARGE_PAGE_SIZE, virt + i * LARGE_PAGE_SIZE);
+        page_large(linear + i * LARGE_PAGE_SIZE, virt + i * LARGE_PAGE_SIZE, flags);
+    }
+}
+
+/*
+ * Identity map device memory uncached.
+ *
+ * Whole 2MB blocks inside the range take a single PD entry each, so even
+ * a large BAR or a full ECAM window only costs a few page tables. The
+ * ragged ends are mapped with 4KB pages. Device memory is expected above
+ * the identity map, ranges below it keep the write-back mapping.
+ */
+void page_mmio(uint64_t base, uint64_t size) {
+    const uint64_t LARGE_PAGE_SIZE = 2 * 1024 * 1024;
+    const uint32_t flags = MAP_WRITE | MAP_CACHE_UC;
+
+    uint64_t address = base & ~(uint64_t)(PAGE_SIZE - 1);
+    uint64_t end = base + size;
+    if (address < MEMORY_IDENTITY_END)
+        address = MEMORY_IDENTITY_END;
+
+    while (address < end) {
+        if (address % LARGE_PAGE_SIZE == 0 && end - address >= LARGE_PAGE_SIZE) {
+            page_large(address, address, flags);
+            address += LARGE_PAGE_SIZE;
+        } else {
+            page(address, address, flags);
+            address += PAGE_SIZE;
+        }
     }
 }
 
@@ -178,9 +350,14 @@ void page_range_large(uint64_t linear, uint64_t virt, uint64_t size) {
  * Initialize the page tables so that the first 1GB of memory is
  * identity-mapped using large (2MB) pages.
  *
+ * The first 2MB is split into 4KB pages so the VGA text buffer can be
+ * mapped write-combining without affecting the memory around it.
+ *
  * This function also loads the new PML4 table into CR3.
  */
 void init_map(void) {
+    init_features();
+
     // Allocate the top-level PML4.
     pml4 = alloc_page_table();
     if (!pml4)
@@ -203,6 +380,16 @@ void init_map(void) {
         uint64_t addr = i * (2ULL * 1024 * 1024); // 2MB per entry.
         pd[i] = addr | PAGE_PRESENT | PAGE_RW | PAGE_PS;
     }
+
+    // Replace the first 2MB page with a 4KB page table.
+    pt_entry_t *pt = alloc_page_table();
+    if (!pt)
+        return;
+    for (int i = 0; i < NUM_ENTRIES; i++)
+        pt[i] = (i * (uint64_t)PAGE_SIZE) | PAGE_PRESENT | PAGE_RW;
+    pd[0] = (uint64_t)pt | PAGE_PRESENT | PAGE_RW;
+
+    page_range(VGA_TEXT_START, VGA_TEXT_START, VGA_TEXT_SIZE, MAP_WRITE | MAP_CACHE_WC);
     
     // Load the new PML4 table into CR3.
     asm volatile("mov %0, %%cr3" :: "r"(pml4) : "memory");
@@ -4,18 +4,105 @@
  * @brief paging functions
  * @version 0.0.2
  * @date 2025-02-18
- * 
+ *
  * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
  * @par License:
  * This project is released under the Artistic License 2.0
- * 
+ *
  */
 
+#pragma once
+
 #include "../stdint.h"
 #include "memory.h"
 
+/// @brief Mapping can be written to
+#define MAP_WRITE       (1 << 0)
+/// @brief Mapping can be executed (NX is set when clear and the cpu supports it)
+#define MAP_EXEC        (1 << 1)
+/// @brief Mapping is global and survives CR3 reloads
+#define MAP_GLOBAL      (1 << 2)
+
+/// @brief Write-back caching (normal memory)
+#define MAP_CACHE_WB    (0 << 3)
+/// @brief Write-through caching
+#define MAP_CACHE_WT    (1 << 3)
+/// @brief Uncacheable (MMIO registers)
+#define MAP_CACHE_UC    (2 << 3)
+/// @brief Write-combining (framebuffers, prefetchable BARs)
+#define MAP_CACHE_WC    (3 << 3)
+/// @brief Mask of the caching type bits
+#define MAP_CACHE_MASK  (3 << 3)
+
+/// @brief What every mapping used before flags existed
+#define MAP_DEFAULT     (MAP_WRITE | MAP_EXEC)
+
+/**
+ * @brief Builds the initial identity map, enables NX and programs the PAT
+ */
 void init_map(void);
-void page(uint64_t linear, uint64_t virt);
-void page_range(uint64_t linear, uint64_t virt, uint64_t size);
-void page_large(uint64_t linear, uint64_t virt);
-void page_range_large(uint64_t linear, uint64_t virt, uint64_t size);
\ No newline at end of file
+
+/**
+ * @brief Enables NX and loads the PAT on the calling cpu
+ * @details init_map does this for the BSP, application processors must call
+ * it before touching mappings that use the PAT.
+ */
+void paging_init_cpu(void);
+
+/**
+ * @brief Maps a single 4KB page
+ *
+ * @param[in] linear physical address (4KB aligned)
+ * @param[in] virt virtual address (4KB aligned)
+ * @param[in] flags MAP_* flags for the mapping
+ */
+void page(uint64_t linear, uint64_t virt, uint32_t flags = MAP_DEFAULT);
+
+/**
+ * @brief Maps a range using 4KB pages, size is rounded up to a whole page
+ *
+ * @param[in] linear starting physical address
+ * @param[in] virt starting virtual address
+ * @param[in] size number of bytes to map
+ * @param[in] flags MAP_* flags for the mapping
+ */
+void page_range(uint64_t linear, uint64_t virt, uint64_t size, uint32_t flags = MAP_DEFAULT);
+
+/**
+ * @brief Maps a single 2MB page
+ *
+ * @param[in] linear physical address (2MB aligned)
+ * @param[in] virt virtual address (2MB aligned)
+ * @param[in] flags MAP_* flags for the mapping
+ */
+void page_large(uint64_t linear, uint64_t virt, uint32_t flags = MAP_DEFAULT);
+
+/**
+ * @brief Turns the 2MB page covering virt into 4KB pages with the same attributes
+ * @details Afterwards page() can change parts of it.
+ *
+ * @param[in] virt any virtual address inside the 2MB page
+ * @return true virt is now mapped with 4KB pages
+ * @return false virt isn't mapped, or no page table was left
+ */
+bool page_split(uint64_t virt);
+
+/**
+ * @brief Maps a range using 2MB pages, size is rounded up to a whole page
+ *
+ * @param[in] linear starting physical address
+ * @param[in] virt starting virtual address
+ * @param[in] size number of bytes to map
+ * @param[in] flags MAP_* flags for the mapping
+ */
+void page_range_large(uint64_t linear, uint64_t virt, uint64_t size, uint32_t flags = MAP_DEFAULT);
+
+/**
+ * @brief Identity maps device memory writable and uncached
+ * @details Uses 2MB pages for the aligned middle of the range. Addresses
+ * below MEMORY_IDENTITY_END are left alone.
+ *
+ * @param[in] base physical address of the registers
+ * @param[in] size number of bytes to map
+ */
+void page_mmio(uint64_t base, uint64_t size);
@@ -0,0 +1,89 @@
+/**
+ * @file zero.cpp
+ * @author Aidcraft
+ * @brief clears large ranges of memory on every cpu
+ * @version 0.0.2
+ * @date 2025-03-15
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#include "zero.h"
+#include "memory.h"
+
+/*
+ * movnti only needs SSE2, which every x86-64 cpu has, and works on general
+ * purpose registers so no SSE state has to be enabled. The stores bypass
+ * the cache and are weakly ordered, hence the sfence before the part is
+ * reported finished.
+ */
+static void zero_streaming(uint8_t* dst, uint64_t size)
+{
+    while (size != 0 && ((uint64_t)dst & 7))
+    {
+        *dst++ = 0;
+        size--;
+    }
+
+    uint64_t zero = 0;
+    for (; size >= 32; size -= 32, dst += 32)
+    {
+        asm volatile("movnti %1, 0(%0)\n\t"
+                     "movnti %1, 8(%0)\n\t"
+                     "movnti %1, 16(%0)\n\t"
+                     "movnti %1, 24(%0)"
+                     :: "r"(dst), "r"(zero) : "memory");
+    }
+    asm volatile("sfence" ::: "memory");
+
+    memset(dst, 0, size);
+}
+
+static void zero_task(void* arg, uint32_t part)
+{
+    zero_request* job = (zero_request*)arg;
+
+    uint64_t start = job->base + (uint64_t)part * ZERO_CHUNK_SIZE;
+    uint64_t end = start + ZERO_CHUNK_SIZE;
+    if (start < job->start)
+        start = job->start;
+    if (end > job->end)
+        end = job->end;
+
+    zero_streaming((uint8_t*)start, end - start);
+}
+
+void zero_range_start(zero_request* request, void* dst, uint64_t size)
+{
+    request->start = (uint64_t)dst;
+    request->end = request->start + size;
+    request->base = request->start & ~(uint64_t)(ZERO_CHUNK_SIZE - 1);
+
+    if (size < ZERO_PARALLEL_MIN)
+    {
+        memset(dst, 0, size);
+        request->job.parts = 0;
+        return;
+    }
+
+    request->job.task = zero_task;
+    request->job.arg = request;
+    request->job.parts = (request->end - request->base + ZERO_CHUNK_SIZE - 1) / ZERO_CHUNK_SIZE;
+    smp_submit(&request->job);
+}
+
+void zero_range_wait(zero_request* request)
+{
+    if (request->job.parts != 0)
+        smp_wait(&request->job);
+}
+
+void zero_range(void* dst, uint64_t size)
+{
+    zero_request request;
+    zero_range_start(&request, dst, size);
+    zero_range_wait(&request);
+}
@@ -0,0 +1,61 @@
+/**
+ * @file zero.h
+ * @author Aidcraft
+ * @brief clears large ranges of memory on every cpu
+ * @version 0.0.2
+ * @date 2025-03-15
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#pragma once
+
+#include "../stdint.h"
+#include "../arch/x86-64/smp.h"
+
+/// @brief Ranges are split into parts on these boundaries
+#define ZERO_CHUNK_SIZE     0x200000
+/// @brief Below this a single cached rep stos beats waking other cpus
+#define ZERO_PARALLEL_MIN   0x40000
+
+/// @brief A clear that may still be running on other cpus
+typedef struct
+{
+    smp_job job;
+    uint64_t start;
+    uint64_t end;
+    /// @brief start rounded down to ZERO_CHUNK_SIZE, where part 0 begins
+    uint64_t base;
+} zero_request;
+
+/**
+ * @brief Starts zeroing a range and returns while other cpus work on it
+ * @details Small ranges are cleared before returning. The request must stay
+ * alive until zero_range_wait returns for it.
+ *
+ * @param[out] request filled in and queued
+ * @param[out] dst start of the range
+ * @param[in] size bytes to clear
+ */
+void zero_range_start(zero_request* request, void* dst, uint64_t size);
+
+/**
+ * @brief Waits for (and helps with) a clear started by zero_range_start
+ *
+ * @param[in] request the started request
+ */
+void zero_range_wait(zero_request* request);
+
+/**
+ * @brief Zeroes a range of mapped memory
+ * @details Large ranges are split on ZERO_CHUNK_SIZE boundaries and cleared
+ * by every cpu with non-temporal stores, so gigabytes of BSS don't flush
+ * the caches. Small ones use rep stos on the calling cpu.
+ *
+ * @param[out] dst start of the range
+ * @param[in] size bytes to clear
+ */
+void zero_range(void* dst, uint64_t size);
@@ -12,68 +12,23 @@
  */
 
 #include "stdio.h"
-
-/// @brief Width of the screen
-#define SCREEN_WIDTH 80
-/// @brief Height of the screen
-#define SCREEN_HEIGHT 25
-/// @brief pointer to the screen
-uint8_t* screen_buffer = (uint8_t*)0xB8000;
-/// @brief x cursor
-int screen_x = 0;
-/// @brief y cursor
-int screen_y = 0;
+#include "console.h"
+#include "log.h"
+#include "format.h"
 
 void clear_screen() {
-    for (int i = 0; i < SCREEN_HEIGHT; i++) {
-        for (int j = 0; j < SCREEN_WIDTH; j++) {
-            putchr(j, i, ' ');
-        }
-    }
+    console_clear();
 }
 
 void putchr(int x, int y, char c) {
-    screen_buffer[2 * (y * SCREEN_WIDTH + x)] = c;
+    console_putchr(x, y, c);
 }
 
 void putc(char c) {
-    if (c == '\n') {
-        // Move to the next line
-        screen_x = 0;
-        screen_y++;
-    } else if (c == '\r') {
-        // Carriage return (move to the start of the current line)
-        screen_x = 0;
-    } else {
-        // Write the character to the screen buffer
-        if (screen_x < SCREEN_WIDTH && screen_y < SCREEN_HEIGHT) {
-            putchr(screen_x, screen_y, c);
-            screen_x++; // Move cursor to the right
-        }
-    }
-
-    // Handle line wrapping
-    if (screen_x >= SCREEN_WIDTH) {
-        screen_x = 0;
-        screen_y++;
-    }
-
-    // Handle scrolling (if cursor moves beyond the screen height)
-    if (screen_y >= SCREEN_HEIGHT) {
-        // Scroll the screen up by 1 line
-        for (int i = 1; i < SCREEN_HEIGHT; i++) {
-            for (int j = 0; j < SCREEN_WIDTH; j++) {
-                putchr(j, i - 1, screen_buffer[2 * (i * SCREEN_WIDTH + j)]);
-            }
-        }
-
-        // Clear the last line
-        for (int j = 0; j < SCREEN_WIDTH; j++) {
-            putchr(j, SCREEN_HEIGHT - 1, ' ');
-        }
-
-        screen_y = SCREEN_HEIGHT - 1; // Keep cursor on the last line
-    }
+#ifdef LOG_VGA
+    console_putc(c);
+#endif
+    log_putc(c);
 }
 
 void puts(const char* str) {
@@ -84,10 +39,43 @@ void puts(const char* str) {
     }
 }
 
-void printf(const char* fmt, ...) {
+void put_dec(uint64_t value, uint8_t width) {
+    char digits[20];
+    uint8_t length = 0;
+    do {
+        digits[length++] = '0' + value % 10;
+        value /= 10;
+    } while (value != 0);
+
+    while (width-- > length)
+        putc(' ');
+    while (length != 0)
+        putc(digits[--length]);
+}
 
+void putn(const char* str, uint32_t length) {
+    for (uint32_t i = 0; i < length; i++)
+        putc(str[i]);
+}
+
+void printf(const char* fmt, ...) {
+    char line[FORMAT_LINE_SIZE];
+    va_list args;
+    va_start(args, fmt);
+    uint32_t length = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    putn(line, length);
 }
 
 void print_buffer(const char* msg, const void* buffer, uint32_t length) {
+    const uint8_t* bytes = (const uint8_t*)buffer;
+    puts(msg);
 
+    for (uint32_t offset = 0; offset < length; offset += 16) {
+        uint32_t count = length - offset < 16 ? length - offset : 16;
+        PRINTF("\n%04x:", offset);
+        for (uint32_t i = 0; i < count; i++)
+            PRINTF(" %02x", bytes[offset + i]);
+    }
+    putc('\n');
 }
@@ -28,22 +28,36 @@ void putc(char c);
 void puts(const char* str);
 
 /**
- * @brief 
+ * @brief puts length charecters to the screen
  * 
- * @todo Implement function
+ * @param[in] str charecters to print
+ * @param[in] length number of charecters
+ */
+void putn(const char* str, uint32_t length);
+
+/**
+ * @brief puts an unsigned decimal number to the screen
  * 
- * @param[in] fmt 
- * @param[in] ... 
+ * @param[in] value number to print
+ * @param[in] width minimum width, padded with spaces on the left
  */
-void printf(const char* fmt, ...);
+void put_dec(uint64_t value, uint8_t width);
 
 /**
- * @brief 
+ * @brief prints a formatted string, see format.h for the conversions
+ * @details Lines longer than FORMAT_LINE_SIZE are cut. PRINTF checks the
+ * format at compile time and skips va_arg.
  * 
- * @todo Implement function
+ * @param[in] fmt the format
+ * @param[in] ... arguments for the conversions
+ */
+void printf(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+
+/**
+ * @brief prints msg followed by a hex dump of buffer, 16 bytes a line
  * 
- * @param[in] msg 
- * @param[in] buffer 
- * @param[in] length 
+ * @param[in] msg heading printed first
+ * @param[in] buffer bytes to dump
+ * @param[in] length number of bytes
  */
 void print_buffer(const char* msg, const void* buffer, uint32_t length);
\ No newline at end of file
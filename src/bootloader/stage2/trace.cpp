@@ -0,0 +1,175 @@
+/**
+ * @file trace.cpp
+ * @author Aidcraft
+ * @brief boot phase profiler based on the time stamp counter
+ * @version 0.0.2
+ * @date 2025-03-16
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#include "trace.h"
+#include "stdio.h"
+#include "string.h"
+#include "arch/x86-64/cpu.h"
+#include "arch/x86-64/pit.h"
+#include "arch/x86-64/io.h"
+#include "log.h"
+
+#define CALIBRATION_US 10000
+#define NAME_COLUMN 20
+
+static trace_event* const ring = (trace_event*)MEMORY_TRACE_START;
+/// @brief events ever recorded, the ring keeps the last TRACE_RING_SIZE
+static uint32_t recorded;
+static uint64_t lastMark;
+/// @brief bytes reported by spans since the last mark
+static uint64_t pendingBytes;
+static uint64_t frequency;
+
+static void record(const char* name, uint64_t start, uint64_t end, uint64_t bytes, uint32_t kind)
+{
+    trace_event* event = &ring[recorded % TRACE_RING_SIZE];
+    event->start = start;
+    event->end = end;
+    event->name = name;
+    event->bytes = bytes;
+    event->kind = kind;
+    recorded++;
+}
+
+static uint64_t calibrate()
+{
+    cpuid_regs leaf0 = cpuid(0);
+    if (leaf0.eax >= 0x15)
+    {
+        // TSC = crystal * ebx / eax, only usable when the crystal clock is reported
+        cpuid_regs tsc = cpuid(0x15);
+        if (tsc.eax != 0 && tsc.ebx != 0 && tsc.ecx != 0)
+            return (uint64_t)tsc.ecx * tsc.ebx / tsc.eax;
+    }
+
+    uint64_t start = rdtsc();
+    pit_wait(CALIBRATION_US);
+    return (rdtsc() - start) * (1000000 / CALIBRATION_US);
+}
+
+void trace_init()
+{
+    recorded = 0;
+    pendingBytes = 0;
+
+    record("e820", boot_tsc[BOOT_TSC_ENTRY], boot_tsc[BOOT_TSC_E820], 0, TRACE_PHASE);
+    record("to protected mode", boot_tsc[BOOT_TSC_E820], boot_tsc[BOOT_TSC_PROTECTED], 0, TRACE_PHASE);
+    record("to long mode", boot_tsc[BOOT_TSC_PROTECTED], boot_tsc[BOOT_TSC_LONG], 0, TRACE_PHASE);
+    lastMark = boot_tsc[BOOT_TSC_LONG];
+
+    frequency = calibrate();
+    trace_mark("tsc calibration");
+}
+
+void trace_mark(const char* name)
+{
+    uint64_t now = rdtsc();
+    record(name, lastMark, now, pendingBytes, TRACE_PHASE);
+    lastMark = now;
+    pendingBytes = 0;
+}
+
+void trace_span(const char* name, uint64_t start, uint32_t bytes)
+{
+    record(name, start, rdtsc(), bytes, TRACE_SPAN);
+    pendingBytes += bytes;
+}
+
+uint64_t trace_tsc_frequency()
+{
+    return frequency;
+}
+
+uint64_t trace_ticks_to_us(uint64_t ticks)
+{
+    if (frequency == 0)
+        return 0;
+    // split to keep ticks * 1000000 from overflowing on long intervals
+    return ticks / frequency * 1000000 + ticks % frequency * 1000000 / frequency;
+}
+
+uint32_t trace_events(trace_event* events, uint32_t max)
+{
+    uint32_t kept = recorded < TRACE_RING_SIZE ? recorded : TRACE_RING_SIZE;
+    uint32_t first = recorded - kept;
+    uint32_t count = kept < max ? kept : max;
+
+    for (uint32_t i = 0; i < count; i++)
+        events[i] = ring[(first + i) % TRACE_RING_SIZE];
+    return count;
+}
+
+uint32_t trace_recorded()
+{
+    return recorded;
+}
+
+void trace_dump()
+{
+    uint32_t kept = recorded < TRACE_RING_SIZE ? recorded : TRACE_RING_SIZE;
+    uint32_t first = recorded - kept;
+
+    uint64_t spanBytes = 0;
+    uint64_t spanTicks = 0;
+
+    puts("TRACE: phase                    us      KB/s\n");
+    for (uint32_t i = 0; i < kept; i++)
+    {
+        const trace_event* event = &ring[(first + i) % TRACE_RING_SIZE];
+        uint64_t ticks = event->end - event->start;
+
+        if (event->kind == TRACE_SPAN)
+        {
+            spanBytes += event->bytes;
+            spanTicks += ticks;
+            continue;
+        }
+
+        puts("  ");
+        puts(event->name);
+        for (uint8_t column = strlen(event->name); column < NAME_COLUMN; column++)
+            putc(' ');
+        put_dec(trace_ticks_to_us(ticks), 10);
+
+        if (event->bytes != 0 && ticks != 0)
+            put_dec(event->bytes * frequency / ticks / 1024, 10);
+        putc('\n');
+    }
+
+    puts("  total");
+    for (uint8_t column = 5; column < NAME_COLUMN; column++)
+        putc(' ');
+    put_dec(trace_ticks_to_us(lastMark - boot_tsc[BOOT_TSC_ENTRY]), 10);
+    putc('\n');
+
+    if (spanTicks != 0)
+    {
+        puts("  reads only");
+        for (uint8_t column = 10; column < NAME_COLUMN; column++)
+            putc(' ');
+        put_dec(trace_ticks_to_us(spanTicks), 10);
+        put_dec(spanBytes * frequency / spanTicks / 1024, 10);
+        putc('\n');
+    }
+
+    if (recorded > kept)
+        puts("  (older events dropped from the ring)\n");
+}
+
+void trace_exit()
+{
+#ifdef BENCH_EXIT
+    log_flush();
+    outb(TRACE_EXIT_PORT, TRACE_EXIT_CODE);
+#endif
+}
@@ -0,0 +1,118 @@
+/**
+ * @file trace.h
+ * @author Aidcraft
+ * @brief boot phase profiler based on the time stamp counter
+ * @version 0.0.2
+ * @date 2025-03-16
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#pragma once
+
+#include "stdint.h"
+#include "memory/memory.h"
+
+/// @brief Indices into boot_tsc, written by the assembly stages
+enum boot_tsc_point
+{
+    BOOT_TSC_ENTRY      = 0,
+    BOOT_TSC_E820       = 1,
+    BOOT_TSC_PROTECTED  = 2,
+    BOOT_TSC_LONG       = 3,
+    BOOT_TSC_COUNT
+};
+
+extern "C" uint64_t boot_tsc[BOOT_TSC_COUNT];
+
+/// @brief One recorded interval
+typedef struct
+{
+    uint64_t start;
+    uint64_t end;
+    /// @brief static string naming the phase or transfer
+    const char* name;
+    /// @brief bytes moved during the interval, 0 when it isn't a transfer
+    uint32_t bytes;
+    /// @brief TRACE_PHASE or TRACE_SPAN
+    uint32_t kind;
+} trace_event;
+
+/// @brief Phases follow each other and together cover the whole boot
+#define TRACE_PHASE 0
+/// @brief Spans are single transfers inside a phase
+#define TRACE_SPAN  1
+
+#define TRACE_RING_SIZE (MEMORY_TRACE_SIZE / sizeof(trace_event))
+
+/**
+ * @brief Calibrates the TSC and records the phases of the assembly stages
+ * @details Uses CPUID leaf 15h when it reports the crystal clock, otherwise
+ * counts TSC ticks across 10ms of PIT channel 2.
+ */
+void trace_init();
+
+/**
+ * @brief Ends the current phase
+ * @details The phase runs from the previous mark to now and is credited
+ * with every byte reported by spans in between.
+ *
+ * @param[in] name static string naming the phase that just ended
+ */
+void trace_mark(const char* name);
+
+/**
+ * @brief Records a single transfer
+ *
+ * @param[in] name static string naming the transfer
+ * @param[in] start rdtsc taken when the transfer began
+ * @param[in] bytes bytes moved
+ */
+void trace_span(const char* name, uint64_t start, uint32_t bytes);
+
+/// @brief TSC ticks per second
+uint64_t trace_tsc_frequency();
+
+/**
+ * @brief Converts TSC ticks to microseconds
+ *
+ * @param[in] ticks a TSC difference
+ * @return uint64_t microseconds
+ */
+uint64_t trace_ticks_to_us(uint64_t ticks);
+
+/**
+ * @brief The recorded events, oldest first
+ *
+ * @param[out] events where to copy them
+ * @param[in] max room in events
+ * @return uint32_t number copied
+ */
+uint32_t trace_events(trace_event* events, uint32_t max);
+
+/**
+ * @brief Number of events recorded since trace_init
+ * @details The ring only keeps the last TRACE_RING_SIZE of them.
+ *
+ * @return uint32_t count
+ */
+uint32_t trace_recorded();
+
+/// @brief Prints every phase with its duration and throughput
+void trace_dump();
+
+/// @brief QEMU isa-debug-exit port used by benchmark builds
+#define TRACE_EXIT_PORT 0xF4
+/// @brief Value written to it, QEMU exits with (TRACE_EXIT_CODE << 1) | 1
+#define TRACE_EXIT_CODE 0x10
+
+/**
+ * @brief Ends a benchmark run once loading has finished
+ * @details Only built with BENCH_EXIT. Flushes the log and leaves QEMU
+ * through isa-debug-exit, so the kernel is never started. Returns when
+ * there is no such device.
+ */
+void trace_exit();
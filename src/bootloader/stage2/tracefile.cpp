@@ -0,0 +1,111 @@
+/**
+ * @file tracefile.cpp
+ * @author Aidcraft
+ * @brief boot trace saved to the boot volume
+ * @version 0.0.2
+ * @date 2025-03-24
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#include "tracefile.h"
+#include "stdio.h"
+#include "stddef.h"
+#include "string.h"
+#include "memory/memory.h"
+#include "loader/integrity.h"
+
+#define SECTOR_SIZE 512
+
+/// @brief The file is put together in the first half of the scratch buffer
+#define TRACE_FILE_BUFFER_SIZE (MEMORY_SCRATCH_SIZE / 2)
+
+static_assert(TRACE_RING_SIZE * sizeof(trace_event) <= MEMORY_SCRATCH_SIZE - TRACE_FILE_BUFFER_SIZE,
+              "the ring copy doesn't fit behind the file buffer");
+
+/*
+ * Only a file that already holds a trace, or the empty one build_disk.py
+ * made, is overwritten.
+ */
+static bool is_trace_file(fatFS* fs, FAT_File* file)
+{
+    uint32_t magic;
+    return file->Size >= SECTOR_SIZE && fs->read(file, sizeof(magic), &magic) == sizeof(magic) &&
+           magic == TRACE_FILE_MAGIC && fs->seek(file, 0);
+}
+
+bool trace_save(fatFS* fs, const bootinfo_io_stats* io, uint16_t ioCount)
+{
+    // exFAT is mounted read only, there is nothing to complain about every boot
+    if (fs->type() == FAT_TYPE_EXFAT)
+        return false;
+
+    FAT_File* file = fs->open(TRACE_FILE_PATH);
+    if (file == NULL)
+        return false;
+
+    if (!is_trace_file(fs, file))
+    {
+        puts("TRACE: " TRACE_FILE_PATH " is not a trace file\n");
+        fs->close(file);
+        return false;
+    }
+
+    uint8_t* out = (uint8_t*)MEMORY_SCRATCH_START;
+    trace_event* events = (trace_event*)(MEMORY_SCRATCH_START + TRACE_FILE_BUFFER_SIZE);
+
+    // as many events as fit between the header and the counters
+    uint32_t capacity = file->Size < TRACE_FILE_BUFFER_SIZE ? file->Size : TRACE_FILE_BUFFER_SIZE;
+    capacity -= capacity % SECTOR_SIZE;
+    uint32_t fixed = sizeof(trace_file_header) + ioCount * sizeof(bootinfo_io_stats);
+    uint32_t room = capacity > fixed ? (capacity - fixed) / sizeof(trace_file_event) : 0;
+    uint32_t eventCount = trace_events(events, room < TRACE_RING_SIZE ? room : TRACE_RING_SIZE);
+
+    trace_file_header* header = (trace_file_header*)out;
+    memset(header, 0, sizeof(*header));
+    header->magic = TRACE_FILE_MAGIC;
+    header->version = TRACE_FILE_VERSION;
+    header->headerSize = sizeof(trace_file_header);
+    header->tscFrequency = trace_tsc_frequency();
+    memcpy(header->bootTsc, boot_tsc, sizeof(header->bootTsc));
+    header->eventCount = eventCount;
+    header->eventsDropped = trace_recorded() - eventCount;
+    header->eventSize = sizeof(trace_file_event);
+    header->ioCount = ioCount;
+    header->ioSize = sizeof(bootinfo_io_stats);
+
+    trace_file_event* saved = (trace_file_event*)(out + sizeof(trace_file_header));
+    for (uint32_t i = 0; i < eventCount; i++)
+    {
+        saved[i].start = events[i].start;
+        saved[i].end = events[i].end;
+        saved[i].bytes = events[i].bytes;
+        saved[i].kind = events[i].kind;
+
+        uint32_t length = strlen(events[i].name);
+        if (length > TRACE_FILE_NAME_SIZE - 1)
+            length = TRACE_FILE_NAME_SIZE - 1;
+        memset(saved[i].name, 0, TRACE_FILE_NAME_SIZE);
+        memcpy(saved[i].name, events[i].name, length);
+    }
+
+    uint8_t* counters = (uint8_t*)&saved[eventCount];
+    memcpy(counters, io, ioCount * sizeof(bootinfo_io_stats));
+
+    uint32_t size = counters + ioCount * sizeof(bootinfo_io_stats) - out;
+    uint32_t written = (size + SECTOR_SIZE - 1) / SECTOR_SIZE * SECTOR_SIZE;
+    memset(out + size, 0, written - size);
+
+    header->size = size;
+    header->crc32c = ~crc32c_update(CRC32C_INIT, out + sizeof(trace_file_header), size - sizeof(trace_file_header));
+
+    bool ok = fs->write(file, written, out) == written;
+    fs->close(file);
+
+    if (!ok)
+        puts("TRACE: failed to write " TRACE_FILE_PATH "\n");
+    return ok;
+}
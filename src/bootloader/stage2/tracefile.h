@@ -0,0 +1,80 @@
+/**
+ * @file tracefile.h
+ * @author Aidcraft
+ * @brief boot trace saved to the boot volume
+ * @version 0.0.2
+ * @date 2025-03-24
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ * @details build_disk.py preallocates TRACE_FILE_PATH with TRACE_FILE_MAGIC
+ * in its first bytes. Every boot overwrites it in place with the trace
+ * ring and the I/O counters, so timings can be collected from machines
+ * without a console; scripts/read_trace.py decodes it.
+ *
+ * Layout, little endian: a trace_file_header, eventCount trace_file_events
+ * and ioCount bootinfo_io_stats. Bytes past size are left over from older
+ * boots.
+ */
+
+#pragma once
+
+#include "stdint.h"
+#include "trace.h"
+#include "fs/FAT/fat.h"
+#include "loader/bootinfo.h"
+
+#define TRACE_FILE_PATH     "boot/trace.bin"
+/// @brief "BTRC"
+#define TRACE_FILE_MAGIC    0x43525442
+#define TRACE_FILE_VERSION  1
+/// @brief Event names are cut to this many bytes, the last one is always 0
+#define TRACE_FILE_NAME_SIZE 24
+
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize;
+    /// @brief bytes written by this boot, header included
+    uint32_t size;
+    /// @brief CRC32C of the bytes from the end of the header to size
+    uint32_t crc32c;
+    uint64_t tscFrequency;
+    /// @brief boot_tsc as the assembly stages left it
+    uint64_t bootTsc[BOOT_TSC_COUNT];
+    uint32_t eventCount;
+    /// @brief events recorded but dropped from the ring or the file
+    uint32_t eventsDropped;
+    uint16_t eventSize;
+    uint16_t ioCount;
+    uint16_t ioSize;
+    uint16_t _reserved;
+} __attribute__((packed)) trace_file_header;
+
+/// @brief A trace_event with its name copied in
+typedef struct
+{
+    uint64_t start;
+    uint64_t end;
+    uint32_t bytes;
+    /// @brief TRACE_PHASE or TRACE_SPAN
+    uint32_t kind;
+    char name[TRACE_FILE_NAME_SIZE];
+} __attribute__((packed)) trace_file_event;
+
+/**
+ * @brief Overwrites TRACE_FILE_PATH with the trace recorded so far
+ * @details Needs crc32c_init. The file is written with a single
+ * fatFS::write and never grows; a missing file, or one that doesn't start
+ * with TRACE_FILE_MAGIC, is left alone. exFAT volumes are read only and
+ * skipped without a message.
+ *
+ * @param[in] fs boot volume
+ * @param[in] io counters to include, disk first, then partition
+ * @param[in] ioCount number of entries in io
+ * @return true the file was written
+ */
+bool trace_save(fatFS* fs, const bootinfo_io_stats* io, uint16_t ioCount);
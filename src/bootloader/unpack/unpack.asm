@@ -0,0 +1,153 @@
+bits 16
+
+;-------------------------------------------------------------------------
+; Stage2 unpacker
+; Description: Loaded by stage1 in place of stage2 when the image is built
+;              with COMPRESS_STAGE2. It expands the LZ4 blocks appended to
+;              it to their load addresses and enters stage2 the way stage1
+;              would have (DL = drive, ES:DI = partition entry, DS = entry
+;              segment).
+;
+; Payload, one record per block, written by build_disk.py:
+;   dd  destination (linear address)
+;   dw  size on disk, bit 15 set when the block is stored uncompressed
+;   db  data
+; Blocks are independent LZ4 blocks of at most 16KB (UNPACK_BLOCK_SIZE in
+; build_disk.py, the size field only has 15 bits), so once a block's
+; source and destination have been normalized to an offset below 16 none
+; of its offsets can wrap around inside a segment.
+;-------------------------------------------------------------------------
+
+global start
+
+extern __payload
+
+BLOCK_STORED    equ 0x8000
+BLOCK_SIZE_MASK equ 0x7FFF
+
+section .text
+
+start:
+    jmp short main
+    nop
+    nop
+
+;-------------------------------------------------------------------------
+; Header patched by build_disk.py
+;-------------------------------------------------------------------------
+header:
+    .entry:     dd 0        ; stage2 entry point, segment:offset as in the boot table
+    .blocks:    dw 0        ; number of blocks in the payload
+
+main:
+    cld
+    push es
+    push di
+    push dx
+
+    ; --- Linear address of the first record ---
+    xor eax, eax
+    mov ax, cs
+    shl eax, 4
+    add eax, __payload
+    mov [cs:source], eax
+
+    mov cx, [cs:header.blocks]
+
+.next_block:
+    push cx
+
+    ; --- DS:SI = record, normalized ---
+    mov eax, [cs:source]
+    mov si, ax
+    and si, 0Fh
+    shr eax, 4
+    mov ds, ax
+
+    lodsd                   ; destination
+    mov di, ax
+    and di, 0Fh
+    shr eax, 4
+    mov es, ax
+
+    lodsw                   ; size on disk
+    mov cx, ax
+    and cx, BLOCK_SIZE_MASK
+    movzx edx, cx
+    add edx, 6
+    add [cs:source], edx
+
+    test ax, BLOCK_STORED
+    jz .compressed
+    rep movsb
+    jmp .block_done
+
+.compressed:
+    mov dx, si
+    add dx, cx              ; end of the block's input
+
+.sequence:
+    ; --- Literals ---
+    lodsb                   ; token
+    mov bl, al
+    shr al, 4
+    call read_length
+    rep movsb
+
+    ; the last sequence of a block has no match
+    cmp si, dx
+    jae .block_done
+
+    ; --- Match, copied forwards a byte at a time so overlaps repeat ---
+    lodsw                   ; offset back from the output
+    xchg ax, bx
+    and al, 0Fh
+    call read_length
+    add cx, 4
+
+    push ds
+    push si
+    push es
+    pop ds
+    mov si, di
+    sub si, bx
+    rep movsb
+    pop si
+    pop ds
+    jmp .sequence
+
+.block_done:
+    pop cx
+    dec cx                  ; loop can't reach back this far
+    jnz .next_block
+
+    ; --- Enter stage2 ---
+    pop dx
+    pop di
+    pop es
+    mov ax, [cs:header.entry + 2]
+    mov ds, ax
+    jmp far [cs:header.entry]
+
+;-------------------------------------------------------------------------
+; Function: read_length
+; Description: Completes an LZ4 length. 15 in the token nibble means more
+;              bytes follow, each added on until one is below 255.
+; Input:  AL = token nibble, DS:SI = input
+; Output: CX = length, SI past the extra bytes
+;-------------------------------------------------------------------------
+read_length:
+    xor ah, ah
+    mov cx, ax
+    cmp al, 15
+    jne .done
+.more:
+    lodsb
+    add cx, ax
+    inc al
+    jz .more                ; 255 wraps to 0, another byte follows
+.done:
+    ret
+
+section .data
+    source: dd 0
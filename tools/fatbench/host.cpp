@@ -0,0 +1,72 @@
+/**
+ * @file host.cpp
+ * @author Aidcraft
+ * @brief stage2 services the FAT layers expect, backed by the host
+ * @version 0.0.2
+ * @date 2025-03-20
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#include "../../src/bootloader/stage2/stdio.h"
+#include "../../src/bootloader/stage2/format.h"
+#include "../../src/bootloader/stage2/trace.h"
+#include "host_io.h"
+
+void putc(char c)
+{
+    host_write(&c, 1);
+}
+
+void putn(const char* str, uint32_t length)
+{
+    host_write(str, length);
+}
+
+void puts(const char* str)
+{
+    uint32_t length = 0;
+    while (str[length])
+        length++;
+    host_write(str, length);
+}
+
+void printf(const char* fmt, ...)
+{
+    char line[FORMAT_LINE_SIZE];
+    va_list args;
+    va_start(args, fmt);
+    uint32_t length = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    host_write(line, length);
+}
+
+void put_dec(uint64_t value, uint8_t width)
+{
+    char digits[20];
+    uint8_t length = 0;
+    do
+    {
+        digits[length++] = '0' + value % 10;
+        value /= 10;
+    } while (value != 0);
+
+    while (width-- > length)
+        putc(' ');
+    while (length != 0)
+        putc(digits[--length]);
+}
+
+uint64_t trace_tsc_frequency()
+{
+    return host_tsc_frequency();
+}
+
+uint64_t trace_ticks_to_us(uint64_t ticks)
+{
+    uint64_t frequency = host_tsc_frequency();
+    return ticks / frequency * 1000000 + ticks % frequency * 1000000 / frequency;
+}
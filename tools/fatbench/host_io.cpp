@@ -0,0 +1,89 @@
+/**
+ * @file host_io.cpp
+ * @author Aidcraft
+ * @brief the few host services fatbench needs, kept apart from the stage2 headers
+ * @version 0.0.2
+ * @date 2025-03-20
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ */
+
+#include "host_io.h"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include <x86intrin.h>
+
+#define SECTOR_SIZE 512
+
+static int image = -1;
+
+bool host_open_image(const char* path)
+{
+    image = open(path, O_RDONLY);
+    return image >= 0;
+}
+
+void host_close_image()
+{
+    if (image >= 0)
+        close(image);
+    image = -1;
+}
+
+bool host_read_sectors(void* buffer, unsigned char count, unsigned int lba)
+{
+    size_t size = (count == 0 ? 256 : count) * (size_t)SECTOR_SIZE;
+    return pread(image, buffer, size, (off_t)lba * SECTOR_SIZE) == (ssize_t)size;
+}
+
+bool host_map_fixed(unsigned long address, unsigned long size)
+{
+    void* mapped = mmap((void*)address, size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    return mapped == (void*)address;
+}
+
+void host_write(const char* data, unsigned long length)
+{
+    while (length != 0)
+    {
+        ssize_t written = write(STDOUT_FILENO, data, length);
+        if (written <= 0)
+            return;
+        data += written;
+        length -= written;
+    }
+}
+
+unsigned long long host_now_ns()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+unsigned long long host_tsc_frequency()
+{
+    static unsigned long long frequency;
+    if (frequency != 0)
+        return frequency;
+
+    unsigned long long start = host_now_ns();
+    unsigned long long tsc = __rdtsc();
+    while (host_now_ns() - start < 20000000)
+        ;
+    frequency = (__rdtsc() - tsc) * 1000000000ULL / (host_now_ns() - start);
+    return frequency;
+}
+
+void host_sort(unsigned long long* values, unsigned int count)
+{
+    std::sort(values, values + count);
+}
@@ -0,0 +1,40 @@
+/**
+ * @file host_io.h
+ * @author Aidcraft
+ * @brief the few host services fatbench needs, kept apart from the stage2 headers
+ * @version 0.0.2
+ * @date 2025-03-20
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ * @details Only builtin types appear here, the stage2 stdint.h and the host
+ * one must never meet in one file.
+ */
+
+#pragma once
+
+/// @brief Opens the disk image read-only, false if it can't be opened
+bool host_open_image(const char* path);
+
+/// @brief Closes the disk image
+void host_close_image();
+
+/// @brief A DiskReadFunc reading 512 byte sectors from the image, count 0 means 256
+bool host_read_sectors(void* buffer, unsigned char count, unsigned int lba);
+
+/// @brief Maps size bytes of zeroed memory at a fixed address
+bool host_map_fixed(unsigned long address, unsigned long size);
+
+/// @brief Writes to stdout
+void host_write(const char* data, unsigned long length);
+
+/// @brief Monotonic time in nanoseconds
+unsigned long long host_now_ns();
+
+/// @brief TSC ticks per second, measured against the monotonic clock
+unsigned long long host_tsc_frequency();
+
+/// @brief Sorts values ascending
+void host_sort(unsigned long long* values, unsigned int count);
@@ -0,0 +1,303 @@
+/**
+ * @file main.cpp
+ * @author Aidcraft
+ * @brief times opening and reading files through the stage2 FAT driver on the host
+ * @version 0.0.2
+ * @date 2025-03-20
+ *
+ * @copyright Copyright (c) 2025 Aiden Gursky. All Rights Reserved
+ * @par License:
+ * This project is released under the Artistic License 2.0
+ *
+ * @details Usage: fatbench [--repeat N] [--file PATH]... IMAGE...
+ * Every image is booted the way stage2 sees it: the first MBR partition,
+ * FAT state at MEMORY_FAT_START and sectors through a DiskReadFunc.
+ * Without --file, boot/kernel.elf and boot/file00.bin .. file15.bin are
+ * read, which is what make_images.py puts on its images. Every file is
+ * checked against its CRC32C in boot/crc32c.txt, a file that is missing
+ * there or reads back different fails the image.
+ */
+
+#include "../../src/bootloader/stage2/stdint.h"
+#include "../../src/bootloader/stage2/stddef.h"
+#include "../../src/bootloader/stage2/format.h"
+#include "../../src/bootloader/stage2/disk.h"
+#include "../../src/bootloader/stage2/mbr.h"
+#include "../../src/bootloader/stage2/fs/FAT/fat.h"
+#include "../../src/bootloader/stage2/loader/integrity.h"
+#include "host_io.h"
+
+#define MAX_FILES 32
+#define MAX_REPEAT 101
+#define READ_CHUNK 0x10000
+#define MBR_PARTITION_TABLE 0x1BE
+
+/// @brief Results of one file over every run
+typedef struct
+{
+    const char* path;
+    uint32_t size;
+    /// @brief expected CRC32C from the manifest
+    uint32_t crc;
+    uint64_t openNs[MAX_REPEAT];
+    uint64_t readNs[MAX_REPEAT];
+    /// @brief counters of the last run, every run issues the same commands
+    uint64_t commands;
+    uint64_t sectors;
+    uint64_t seeks;
+    uint64_t cacheHits;
+} file_result;
+
+static const char* defaultFiles[] = {
+    "boot/kernel.elf",
+    "boot/file00.bin", "boot/file01.bin", "boot/file02.bin", "boot/file03.bin",
+    "boot/file04.bin", "boot/file05.bin", "boot/file06.bin", "boot/file07.bin",
+    "boot/file08.bin", "boot/file09.bin", "boot/file10.bin", "boot/file11.bin",
+    "boot/file12.bin", "boot/file13.bin", "boot/file14.bin", "boot/file15.bin",
+};
+
+static uint8_t readBuffer[READ_CHUNK];
+static uint8_t mbr[512];
+
+static uint64_t median(uint64_t* values, uint32_t count)
+{
+    host_sort((unsigned long long*)values, count);
+    return values[count / 2];
+}
+
+/*
+ * One pass over the files of an image with fresh driver state, so the
+ * counters start at zero and nothing is cached from the previous run.
+ * Only the read calls are timed, not checksumming what they returned.
+ */
+static bool run(file_result* results, uint32_t fileCount, uint32_t round, uint8_t* fatType)
+{
+    disk Disk(&host_read_sectors);
+    Partition part(&Disk);
+    fatFS fs(&part);
+
+    Disk.Init(0x80);
+    part.Init(mbr + MBR_PARTITION_TABLE);
+    if (!fs.Init())
+        return false;
+    *fatType = fs.type();
+
+    for (uint32_t i = 0; i < fileCount; i++)
+    {
+        file_result* result = &results[i];
+        disk_stats diskBefore = Disk.stats;
+        disk_stats partBefore = part.stats;
+
+        uint64_t start = host_now_ns();
+        FAT_File* file = fs.open(result->path);
+        uint64_t opened = host_now_ns();
+        if (file == NULL)
+        {
+            PRINTF("fatbench: %s not found\n", result->path);
+            return false;
+        }
+
+        uint32_t total = 0;
+        uint32_t crc = CRC32C_INIT;
+        uint64_t readNs = 0;
+        for (;;)
+        {
+            uint64_t readStart = host_now_ns();
+            uint32_t length = fs.read(file, sizeof(readBuffer), readBuffer);
+            readNs += host_now_ns() - readStart;
+            if (length == 0)
+                break;
+            crc = crc32c_update(crc, readBuffer, length);
+            total += length;
+        }
+        fs.close(file);
+
+        crc ^= CRC32C_INIT;
+        if (crc != result->crc)
+        {
+            PRINTF("fatbench: %s read back with crc32c %08x, expected %08x\n", result->path, crc, result->crc);
+            return false;
+        }
+
+        result->size = total;
+        result->openNs[round] = opened - start;
+        result->readNs[round] = readNs;
+        result->commands = Disk.stats.commands - diskBefore.commands;
+        result->sectors = Disk.stats.sectors - diskBefore.sectors;
+        result->seeks = Disk.stats.seeks - diskBefore.seeks;
+        result->cacheHits = part.stats.cacheHits - partBefore.cacheHits;
+    }
+    return true;
+}
+
+/*
+ * Looks every file up in the image's manifest. The driver state used for
+ * it is thrown away, so the timed runs still start cold.
+ */
+static bool load_checksums(const char* image, file_result* results, uint32_t fileCount)
+{
+    disk Disk(&host_read_sectors);
+    Partition part(&Disk);
+    fatFS fs(&part);
+
+    Disk.Init(0x80);
+    part.Init(mbr + MBR_PARTITION_TABLE);
+    if (!fs.Init())
+        return false;
+
+    if (integrity_load(&fs) == 0)
+    {
+        PRINTF("fatbench: %s has no %s\n", image, INTEGRITY_MANIFEST_PATH);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < fileCount; i++)
+    {
+        if (!integrity_lookup(results[i].path, &results[i].crc))
+        {
+            PRINTF("fatbench: %s isn't in %s\n", results[i].path, INTEGRITY_MANIFEST_PATH);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool bench_image(const char* image, const char** files, uint32_t fileCount, uint32_t repeat)
+{
+    if (!host_open_image(image) || !host_read_sectors(mbr, 1, 0))
+    {
+        PRINTF("fatbench: can't read %s\n", image);
+        return false;
+    }
+
+    static file_result results[MAX_FILES];
+    for (uint32_t i = 0; i < fileCount; i++)
+        results[i].path = files[i];
+
+    uint8_t fatType = 0;
+    bool ok = load_checksums(image, results, fileCount);
+    for (uint32_t round = 0; round < repeat && ok; round++)
+        ok = run(results, fileCount, round, &fatType);
+    host_close_image();
+    if (!ok)
+        return false;
+
+    if (fatType == FAT_TYPE_EXFAT)
+        PRINTF("%s (exFAT, median of %u runs)\n", image, repeat);
+    else
+        PRINTF("%s (FAT%u, median of %u runs)\n", image, fatType, repeat);
+    PRINTF("  %-20s %10s %9s %9s %8s %6s %8s %6s %6s\n", "file", "bytes", "open us", "read us", "MB/s",
+           "cmds", "sectors", "seeks", "hits");
+
+    uint64_t totalBytes = 0, totalNs = 0, totalCommands = 0, totalSectors = 0;
+    for (uint32_t i = 0; i < fileCount; i++)
+    {
+        file_result* result = &results[i];
+        uint64_t openNs = median(result->openNs, repeat);
+        uint64_t readNs = median(result->readNs, repeat);
+        uint64_t mbPerS = readNs != 0 ? (uint64_t)result->size * 1000 / readNs : 0;
+
+        PRINTF("  %-20s %10u %9llu %9llu %8llu %6llu %8llu %6llu %6llu\n", result->path, result->size,
+               openNs / 1000, readNs / 1000, mbPerS, result->commands, result->sectors, result->seeks,
+               result->cacheHits);
+
+        totalBytes += result->size;
+        totalNs += openNs + readNs;
+        totalCommands += result->commands;
+        totalSectors += result->sectors;
+    }
+
+    PRINTF("  %-20s %10llu %19llu %8llu %6llu %8llu\n\n", "total", totalBytes, totalNs / 1000,
+           totalNs != 0 ? totalBytes * 1000 / totalNs : 0, totalCommands, totalSectors);
+    return true;
+}
+
+static bool parse_number(const char* text, uint32_t* value)
+{
+    *value = 0;
+    if (*text == '\0')
+        return false;
+    for (; *text; text++)
+    {
+        if (*text < '0' || *text > '9')
+            return false;
+        *value = *value * 10 + (*text - '0');
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    const char* files[MAX_FILES];
+    uint32_t fileCount = 0;
+    uint32_t repeat = 5;
+    int first = argc;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--repeat") && i + 1 < argc)
+        {
+            if (!parse_number(argv[++i], &repeat) || repeat == 0 || repeat > MAX_REPEAT)
+            {
+                PRINTF("fatbench: --repeat takes 1 to %u\n", MAX_REPEAT);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "--file") && i + 1 < argc)
+        {
+            if (fileCount == MAX_FILES)
+            {
+                PRINTF("fatbench: at most %u files\n", MAX_FILES);
+                return 1;
+            }
+            files[fileCount++] = argv[++i];
+        }
+        else
+        {
+            first = i;
+            break;
+        }
+    }
+
+    if (first == argc)
+    {
+        puts("usage: fatbench [--repeat N] [--file PATH]... IMAGE...\n");
+        return 1;
+    }
+
+    if (fileCount == 0)
+    {
+        for (const char* path : defaultFiles)
+            files[fileCount++] = path;
+    }
+
+    // the driver keeps its state at a fixed address, just like in stage2
+    if (!host_map_fixed(MEMORY_FAT_START, MEMORY_FAT_SIZE))
+    {
+        puts("fatbench: can't map the FAT state at MEMORY_FAT_START\n");
+        return 1;
+    }
+
+    // exFAT reads its boot region and up-case table through the scratch buffer
+    if (!host_map_fixed(MEMORY_SCRATCH_START, MEMORY_SCRATCH_SIZE))
+    {
+        puts("fatbench: can't map the scratch buffer at MEMORY_SCRATCH_START\n");
+        return 1;
+    }
+
+    // crc32c_init builds its tables there when the cpu lacks SSE4.2
+    if (!host_map_fixed(MEMORY_CRC_TABLE_START, MEMORY_CRC_TABLE_SIZE))
+    {
+        puts("fatbench: can't map the CRC tables at MEMORY_CRC_TABLE_START\n");
+        return 1;
+    }
+    crc32c_init();
+
+    int status = 0;
+    for (int i = first; i < argc; i++)
+    {
+        if (!bench_image(argv[i], files, fileCount, repeat))
+            status = 1;
+    }
+    return status;
+}
@@ -0,0 +1,403 @@
+#!/usr/bin/env python3
+"""
+Writes the disk images fatbench reads: FAT12, FAT16, FAT32 and exFAT
+partitions, each with the files laid out contiguously and fragmented.
+
+Usage: make_images.py <output directory>
+
+Every image has an MBR with one partition holding /boot/kernel.elf,
+/boot/file00.bin .. file15.bin and /boot/crc32c.txt, the checksums of the
+others in build_disk.py's manifest format. In the fragmented layout the clusters of
+every file are interleaved with a filler file in runs of 1 to 4 clusters,
+picked by a fixed seed so the images are the same on every run. The
+contiguous exFAT files are flagged NoFatChain, the fragmented ones are
+chained through the FAT.
+"""
+import os
+import random
+import struct
+import sys
+
+SECTOR_SIZE = 512
+PARTITION_LBA = 2048
+SMALL_FILES = 16
+SMALL_FILE_SIZE = 4096
+SEED = 0xA1D05
+MANIFEST_NAME = "crc32c.txt"
+
+# name: (fat bits, partition sectors, sectors per cluster, kernel size, MBR type)
+LAYOUTS = {
+    "fat12": (12, 4096, 1, 768 << 10, 0x01),
+    "fat16": (16, 131072, 4, 8 << 20, 0x06),
+    "fat32": (32, 262144, 1, 8 << 20, 0x0C),
+}
+
+END_OF_CHAIN = {12: 0xFFF, 16: 0xFFFF, 32: 0x0FFFFFFF}
+
+# partition sectors, sectors per cluster (as a shift), kernel size, MBR type
+EXFAT_LAYOUT = (262144, 3, 8 << 20, 0x07)
+EXFAT_FAT_OFFSET = 32
+EXFAT_END_OF_CHAIN = 0xFFFFFFFF
+
+
+class FatImage:
+    def __init__(self, bits, sectors, per_cluster):
+        self.bits = bits
+        self.per_cluster = per_cluster
+        self.cluster_size = per_cluster * SECTOR_SIZE
+        self.reserved = 32 if bits == 32 else 1
+        self.root_entries = 0 if bits == 32 else 512
+        self.root_sectors = self.root_entries * 32 // SECTOR_SIZE
+        self.total = sectors
+
+        # sectors per FAT depend on the cluster count and the other way round
+        self.fat_sectors = 1
+        while True:
+            data = sectors - self.reserved - self.root_sectors - 2 * self.fat_sectors
+            self.clusters = data // per_cluster
+            needed = -(-((self.clusters + 2) * bits // 8 + 1) // SECTOR_SIZE)
+            if needed <= self.fat_sectors:
+                break
+            self.fat_sectors = needed
+
+        self.fat = [0] * (self.clusters + 2)
+        self.fat[0] = 0x0FFFFFF8 & END_OF_CHAIN[bits]
+        self.fat[1] = END_OF_CHAIN[bits]
+        self.next_free = 2
+        self.data_lba = self.reserved + 2 * self.fat_sectors + self.root_sectors
+        self.writes = []  # (sector within the partition, bytes)
+
+    def allocate(self, count):
+        clusters = list(range(self.next_free, self.next_free + count))
+        if clusters and clusters[-1] >= self.clusters + 2:
+            raise SystemExit("image too small for its files")
+        self.next_free += count
+        return clusters
+
+    def chain(self, clusters):
+        for current, following in zip(clusters, clusters[1:]):
+            self.fat[current] = following
+        if clusters:
+            self.fat[clusters[-1]] = END_OF_CHAIN[self.bits]
+
+    def cluster_lba(self, cluster):
+        return self.data_lba + (cluster - 2) * self.per_cluster
+
+    def write_clusters(self, clusters, data):
+        for i, cluster in enumerate(clusters):
+            chunk = data[i * self.cluster_size:(i + 1) * self.cluster_size]
+            if chunk:
+                self.writes.append((self.cluster_lba(cluster), chunk))
+
+    def clusters_for(self, size):
+        return max(1, -(-size // self.cluster_size))
+
+    def fat_bytes(self):
+        if self.bits == 12:
+            out = bytearray(self.fat_sectors * SECTOR_SIZE)
+            for cluster, value in enumerate(self.fat):
+                offset = cluster * 3 // 2
+                if cluster & 1:
+                    out[offset] = (out[offset] & 0x0F) | ((value << 4) & 0xF0)
+                    out[offset + 1] = (value >> 4) & 0xFF
+                else:
+                    out[offset] = value & 0xFF
+                    out[offset + 1] = (out[offset + 1] & 0xF0) | ((value >> 8) & 0x0F)
+            return bytes(out)
+        fmt = "<H" if self.bits == 16 else "<I"
+        data = b"".join(struct.pack(fmt, value) for value in self.fat)
+        return data.ljust(self.fat_sectors * SECTOR_SIZE, b"\0")
+
+    def boot_sector(self):
+        sector = bytearray(SECTOR_SIZE)
+        sector[0:3] = b"\xEB\x58\x90" if self.bits == 32 else b"\xEB\x3C\x90"
+        sector[3:11] = b"AIDBENCH"
+        struct.pack_into("<HBHBHHBHHHII", sector, 11,
+                         SECTOR_SIZE, self.per_cluster, self.reserved, 2, self.root_entries,
+                         self.total if self.total < 0x10000 else 0, 0xF8,
+                         0 if self.bits == 32 else self.fat_sectors, 63, 255, PARTITION_LBA,
+                         self.total if self.total >= 0x10000 else 0)
+        if self.bits == 32:
+            struct.pack_into("<IHHIHH", sector, 36, self.fat_sectors, 0, 0, 2, 1, 6)
+            ebr = 64
+        else:
+            ebr = 36
+        struct.pack_into("<BBBI", sector, ebr, 0x80, 0, 0x29, 0x12345678)
+        sector[ebr + 7:ebr + 18] = b"AIDBENCH   "
+        sector[ebr + 18:ebr + 26] = (b"FAT%d" % self.bits).ljust(8)
+        sector[510:512] = b"\x55\xAA"
+        return bytes(sector)
+
+
+class ExfatImage:
+    def __init__(self, sectors, cluster_shift):
+        self.per_cluster = 1 << cluster_shift
+        self.cluster_shift = cluster_shift
+        self.cluster_size = self.per_cluster * SECTOR_SIZE
+        self.total = sectors
+
+        # FAT right after the boot regions, the cluster heap on a cluster boundary behind it
+        self.clusters = (sectors - EXFAT_FAT_OFFSET) // self.per_cluster
+        self.fat_sectors = -(-(self.clusters + 2) * 4 // SECTOR_SIZE)
+        heap = EXFAT_FAT_OFFSET + self.fat_sectors
+        self.data_lba = -(-heap // self.per_cluster) * self.per_cluster
+        self.clusters = (sectors - self.data_lba) // self.per_cluster
+
+        self.fat = {0: 0xFFFFFFF8, 1: EXFAT_END_OF_CHAIN}
+        self.next_free = 2
+        self.writes = []
+
+    allocate = FatImage.allocate
+    cluster_lba = FatImage.cluster_lba
+    write_clusters = FatImage.write_clusters
+    clusters_for = FatImage.clusters_for
+
+    def chain(self, clusters):
+        for current, following in zip(clusters, clusters[1:]):
+            self.fat[current] = following
+        if clusters:
+            self.fat[clusters[-1]] = EXFAT_END_OF_CHAIN
+
+    def fat_bytes(self):
+        out = bytearray(self.fat_sectors * SECTOR_SIZE)
+        for cluster, value in self.fat.items():
+            struct.pack_into("<I", out, cluster * 4, value)
+        return bytes(out)
+
+    def bitmap_bytes(self):
+        # everything below next_free is in use
+        used = self.next_free - 2
+        out = bytearray(-(-self.clusters // 8))
+        out[:used // 8] = b"\xFF" * (used // 8)
+        if used % 8:
+            out[used // 8] = (1 << (used % 8)) - 1
+        return bytes(out)
+
+    def boot_region(self):
+        sector = bytearray(SECTOR_SIZE)
+        sector[0:3] = b"\xEB\x76\x90"
+        sector[3:11] = b"EXFAT   "
+        struct.pack_into("<QQIIIIIIHHBBBBB", sector, 64,
+                         PARTITION_LBA, self.total, EXFAT_FAT_OFFSET, self.fat_sectors,
+                         self.data_lba, self.clusters, self.root_cluster, 0x12345678,
+                         0x0100, 0, 9, self.cluster_shift, 1, 0x80, 0)
+        sector[510:512] = b"\x55\xAA"
+
+        region = bytearray(sector)
+        for _ in range(8):
+            region += bytes(SECTOR_SIZE - 4) + b"\x00\x00\x55\xAA"
+        region += bytes(2 * SECTOR_SIZE)
+
+        checksum = 0
+        for i, byte in enumerate(region):
+            if i not in (106, 107, 112):
+                checksum = ((checksum >> 1) | ((checksum & 1) << 31)) + byte & 0xFFFFFFFF
+        return bytes(region + struct.pack("<I", checksum) * (SECTOR_SIZE // 4))
+
+
+def exfat_upcase():
+    """Compressed up-case table that only folds a-z, the rest maps to itself."""
+    values = [0xFFFF, ord("a")] + list(range(ord("A"), ord("Z") + 1)) + [0xFFFF, 0x10000 - ord("z") - 1]
+    data = struct.pack("<%dH" % len(values), *values)
+    checksum = 0
+    for byte in data:
+        checksum = ((checksum >> 1) | ((checksum & 1) << 31)) + byte & 0xFFFFFFFF
+    return data, checksum
+
+
+def exfat_entry_set(name, attributes, cluster, size, contiguous):
+    """File, stream extension and name entries with the set checksum filled in."""
+    units = name.encode("utf-16-le")
+    upper = name.upper().encode("utf-16-le")
+    name_hash = 0
+    for byte in upper:
+        name_hash = ((name_hash >> 1) | ((name_hash & 1) << 15)) + byte & 0xFFFF
+
+    names = [units[i:i + 30].ljust(30, b"\0") for i in range(0, len(units), 30)]
+    flags = 0x01 | (0x02 if contiguous else 0)
+    entries = bytearray(struct.pack("<BBHH26x", 0x85, 1 + len(names), 0, attributes))
+    entries += struct.pack("<BBxBHxxQxxxxIQ", 0xC0, flags, len(name), name_hash, size, cluster, size)
+    for chunk in names:
+        entries += struct.pack("<BB", 0xC1, 0) + chunk
+
+    checksum = 0
+    for i, byte in enumerate(entries):
+        if i not in (2, 3):
+            checksum = ((checksum >> 1) | ((checksum & 1) << 15)) + byte & 0xFFFF
+    struct.pack_into("<H", entries, 2, checksum)
+    return bytes(entries)
+
+
+def dir_entry(name, ext, attributes, cluster, size):
+    return struct.pack("<8s3sBBBHHHHHHHI", name.ljust(8).encode(), ext.ljust(3).encode(),
+                       attributes, 0, 0, 0, 0, 0, cluster >> 16, 0, 0, cluster & 0xFFFF, size)
+
+
+def layout_files(image, files, fragmented):
+    """Give every file its clusters, returns {name: clusters}."""
+    placed = {name: [] for name, _ in files}
+    if not fragmented:
+        for name, data in files:
+            placed[name] = image.allocate(image.clusters_for(len(data)))
+        return placed
+
+    rng = random.Random(SEED)
+    filler = []
+    for name, data in files:
+        needed = image.clusters_for(len(data))
+        while len(placed[name]) < needed:
+            run = min(rng.randint(1, 4), needed - len(placed[name]))
+            placed[name] += image.allocate(run)
+            filler += image.allocate(rng.randint(1, 4))
+    placed["filler.bin"] = filler
+    return placed
+
+
+def _crc32c_table():
+    table = []
+    for i in range(256):
+        crc = i
+        for _ in range(8):
+            crc = (crc >> 1) ^ (0x82F63B78 if crc & 1 else 0)
+        table.append(crc)
+    return table
+
+
+_CRC32C_TABLE = _crc32c_table()
+
+
+def crc32c(data):
+    """CRC32C (Castagnoli), what fatbench checks the files it read against."""
+    try:
+        import crc32c as fast
+        return fast.crc32c(data)
+    except ImportError:
+        pass
+    crc = 0xFFFFFFFF
+    for byte in data:
+        crc = (crc >> 8) ^ _CRC32C_TABLE[(crc ^ byte) & 0xFF]
+    return crc ^ 0xFFFFFFFF
+
+
+def make_files(kernel_size):
+    rng = random.Random(SEED)
+    files = [("kernel.elf", bytes(rng.getrandbits(8) for _ in range(kernel_size)))]
+    for i in range(SMALL_FILES):
+        files.append(("file%02d.bin" % i, bytes(rng.getrandbits(8) for _ in range(SMALL_FILE_SIZE))))
+
+    manifest = "".join("%08x boot/%s\n" % (crc32c(data), name) for name, data in files)
+    files.append((MANIFEST_NAME, manifest.encode("ascii")))
+    return files
+
+
+def write_image(path, image, mbr_type, volume):
+    """The MBR, then every (sector within the partition, bytes) in volume and the image's writes."""
+    with open(path, "wb") as out:
+        out.truncate((PARTITION_LBA + image.total) * SECTOR_SIZE)
+
+        mbr = bytearray(SECTOR_SIZE)
+        struct.pack_into("<B3sB3sII", mbr, 0x1BE, 0x80, b"\xFE\xFF\xFF", mbr_type, b"\xFE\xFF\xFF",
+                         PARTITION_LBA, image.total)
+        mbr[510:512] = b"\x55\xAA"
+        out.write(mbr)
+
+        base = PARTITION_LBA * SECTOR_SIZE
+        for lba, data in volume + image.writes:
+            out.seek(base + lba * SECTOR_SIZE)
+            out.write(data)
+
+
+def build_exfat(path, sectors, cluster_shift, kernel_size, mbr_type, fragmented):
+    image = ExfatImage(sectors, cluster_shift)
+    files = make_files(kernel_size)
+    upcase, upcase_checksum = exfat_upcase()
+
+    # bitmap, up-case table and the root directory, all chained like the spec asks
+    bitmap = image.allocate(image.clusters_for(-(-image.clusters // 8)))
+    table = image.allocate(image.clusters_for(len(upcase)))
+    root = image.allocate(1)
+    image.root_cluster = root[0]
+    boot_dir = image.allocate(image.clusters_for((len(files) + 1) * 96))
+
+    placed = layout_files(image, files, fragmented)
+    if "filler.bin" in placed:
+        files.append(("filler.bin", bytes(len(placed["filler.bin"]) * image.cluster_size)))
+
+    entries = b""
+    for name, data in files:
+        clusters = placed[name]
+        if fragmented:
+            image.chain(clusters)
+        image.write_clusters(clusters, data)
+        entries += exfat_entry_set(name, 0x20, clusters[0], len(data), not fragmented)
+    image.write_clusters(boot_dir, entries)
+
+    for clusters in (bitmap, table, root):
+        image.chain(clusters)
+    image.write_clusters(table, upcase)
+    image.write_clusters(root, struct.pack("<BBxxIxxxxxxxxxxxxIQ", 0x81, 0, 0, bitmap[0], -(-image.clusters // 8)) +
+                         struct.pack("<BxxxIxxxxxxxxxxxxIQ", 0x82, upcase_checksum, table[0], len(upcase)) +
+                         exfat_entry_set("boot", 0x10, boot_dir[0], len(boot_dir) * image.cluster_size, True))
+    image.write_clusters(bitmap, image.bitmap_bytes())
+
+    region = image.boot_region()
+    volume = [(0, region), (len(region) // SECTOR_SIZE, region), (EXFAT_FAT_OFFSET, image.fat_bytes())]
+    write_image(path, image, mbr_type, volume)
+
+
+def build(path, bits, sectors, per_cluster, kernel_size, mbr_type, fragmented):
+    image = FatImage(bits, sectors, per_cluster)
+    files = make_files(kernel_size)
+
+    # the FAT32 root directory is cluster 2, then /boot with ".", "..", the files and the filler
+    if bits == 32:
+        root_cluster = image.allocate(1)[0]
+        image.fat[root_cluster] = END_OF_CHAIN[bits]
+    boot_dir = image.allocate(image.clusters_for((len(files) + 3) * 32))
+
+    placed = layout_files(image, files, fragmented)
+    if "filler.bin" in placed:
+        files.append(("filler.bin", bytes(len(placed["filler.bin"]) * image.cluster_size)))
+
+    entries = [dir_entry(".", "", 0x10, boot_dir[0], 0), dir_entry("..", "", 0x10, 0, 0)]
+    for name, data in files:
+        clusters = placed[name]
+        image.chain(clusters)
+        image.write_clusters(clusters, data)
+        stem, ext = name.upper().split(".")
+        entries.append(dir_entry(stem, ext, 0x20, clusters[0], len(data)))
+    image.chain(boot_dir)
+    image.write_clusters(boot_dir, b"".join(entries))
+
+    root = dir_entry("AIDBENCH", "", 0x08, 0, 0) + dir_entry("BOOT", "", 0x10, boot_dir[0], 0)
+    if bits == 32:
+        image.write_clusters([root_cluster], root)
+    else:
+        image.writes.append((image.reserved + 2 * image.fat_sectors, root))
+
+    fat = image.fat_bytes()
+    volume = [(0, image.boot_sector())]
+    volume += [(image.reserved + copy * image.fat_sectors, fat) for copy in range(2)]
+    write_image(path, image, mbr_type, volume)
+
+
+def main():
+    if len(sys.argv) != 2:
+        print(__doc__.strip())
+        sys.exit(1)
+
+    os.makedirs(sys.argv[1], exist_ok=True)
+    for name, (bits, sectors, per_cluster, kernel_size, mbr_type) in LAYOUTS.items():
+        for fragmented in (False, True):
+            path = os.path.join(sys.argv[1], "%s-%s.img" % (name, "fragmented" if fragmented else "contiguous"))
+            print("> %s" % path)
+            build(path, bits, sectors, per_cluster, kernel_size, mbr_type, fragmented)
+
+    for fragmented in (False, True):
+        path = os.path.join(sys.argv[1], "exfat-%s.img" % ("fragmented" if fragmented else "contiguous"))
+        print("> %s" % path)
+        build_exfat(path, *EXFAT_LAYOUT, fragmented)
+
+
+if __name__ == "__main__":
+    main()